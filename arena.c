@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+#define ARENA_ALIGNMENT    8
+
+struct arena_block {
+   struct arena_block *next;
+   size_t size;
+   size_t used;
+   char data[];
+};
+
+void
+arena_init(struct arena *arena, size_t block_size)
+{
+   memset(arena, 0, sizeof(struct arena));
+   arena->block_size = block_size;
+}
+
+static struct arena_block *
+arena_new_block(struct arena *arena, size_t size)
+{
+   struct arena_block *block;
+
+   /* recycle the most recently released block when it is big enough */
+   block = arena->free_blocks;
+   if (block != NULL && block->size >= size) {
+      arena->free_blocks = block->next;
+   } else {
+      if (size < arena->block_size)
+         size = arena->block_size;
+
+      block = malloc(sizeof(struct arena_block) + size);
+      if (block == NULL) {
+         fprintf(stderr, "Memory allocation request failed.\n");
+         exit(EXIT_FAILURE);
+      }
+      block->size = size;
+   }
+
+   block->used = 0;
+   block->next = arena->blocks;
+   if (arena->blocks == NULL)
+      arena->last = block;
+   arena->blocks = block;
+   arena->bytes_reserved += block->size;
+
+   return block;
+}
+
+void *
+arena_alloc(struct arena *arena, size_t size)
+{
+   struct arena_block *block;
+   void *ptr;
+
+   size = (size + ARENA_ALIGNMENT - 1) & ~(size_t) (ARENA_ALIGNMENT - 1);
+
+   if (arena->block_size == 0)
+      arena->block_size = ARENA_DEFAULT_BLOCK_SIZE;
+
+   block = arena->blocks;
+   if (block == NULL || block->size - block->used < size)
+      block = arena_new_block(arena, size);
+
+   ptr = block->data + block->used;
+   block->used += size;
+
+   arena->number_of_allocations++;
+   arena->bytes_allocated += size;
+
+   return memset(ptr, 0, size);
+}
+
+void
+arena_reset(struct arena *arena)
+{
+   if (arena->blocks != NULL) {
+      arena->last->next = arena->free_blocks;
+      arena->free_blocks = arena->blocks;
+   }
+
+   arena->blocks = NULL;
+   arena->last = NULL;
+   arena->number_of_allocations = 0;
+   arena->bytes_allocated = 0;
+   arena->bytes_reserved = 0;
+}
+
+void
+arena_destroy(struct arena *arena)
+{
+   struct arena_block *block, *next;
+
+   arena_reset(arena);
+
+   for (block = arena->free_blocks; block != NULL; block = next) {
+      next = block->next;
+      free(block);
+   }
+
+   arena->free_blocks = NULL;
+}
@@ -0,0 +1,37 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+struct arena_block;
+
+/*
+ * Region allocator: allocations are bump-allocated out of large blocks
+ * and can only be released all at once.
+ */
+struct arena {
+   struct arena_block *blocks;      /* blocks in use, newest first */
+   struct arena_block *last;        /* oldest block in use */
+   struct arena_block *free_blocks; /* blocks kept around for reuse */
+   size_t block_size;
+
+   /* counters, reset together with the arena */
+   size_t number_of_allocations;
+   size_t bytes_allocated;          /* bytes handed out to callers */
+   size_t bytes_reserved;           /* bytes in blocks currently in use */
+};
+
+#define ARENA_DEFAULT_BLOCK_SIZE    (1 << 20)
+
+void arena_init(struct arena *arena, size_t block_size);
+
+/* returns 'size' zeroed bytes */
+void *arena_alloc(struct arena *arena, size_t size);
+
+/* releases every allocation in O(1), keeping the blocks for reuse */
+void arena_reset(struct arena *arena);
+
+/* gives all memory back to the system */
+void arena_destroy(struct arena *arena);
+
+#endif /* ARENA_H */
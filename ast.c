@@ -1,168 +1,280 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "ast.h"
 
-static void *
-alloc_node(int tag)
-{
-   struct ast_node *node;
-   size_t size = 0;
-
-   switch (tag) {
-      case AST_NODE:
-         size = sizeof(struct ast_node);
-         break;
-      case AST_DECLARATION:
-         size = sizeof(struct ast_declaration);
-         break;
-      case AST_EXPRESSION:
-         size = sizeof(struct ast_expression);
-         break;
-      case AST_STATEMENT_LIST:
-         size = sizeof(struct ast_statement_list);
-         break;
-      case AST_COMPOUND_STATEMENT:
-         size = sizeof(struct ast_compound_statement);
-         break;
-      case AST_SELECTION_STATEMENT:
-         size = sizeof(struct ast_selection_statement);
-         break;
-      case AST_WHILE_STATEMENT:
-         size = sizeof(struct ast_while_statement);
-         break;
-      case AST_TRANSLATION_UNIT:
-         size = sizeof(struct ast_translation_unit);
-         break;
-      default:
-         fprintf(stderr, "Unknown node type: %d\n", tag);
-         exit(EXIT_FAILURE);
-   }
+/*
+ * Grows one of the typed node arrays by 'count' elements, returning the
+ * index of the first one.
+ */
+static uint32_t
+ast_append(void **array, uint32_t *number, uint32_t *capacity,
+           size_t element_size, uint32_t count)
+{
+   uint32_t first = *number;
 
-   node = calloc(1, size);
-   if (node == NULL) {
-      fprintf(stderr, "Memory allocation request failed.!\n");
+   if (count > AST_REF_MAX_INDEX - first) {
+      fprintf(stderr, "Too many AST nodes of one kind: %u\n", first);
       exit(EXIT_FAILURE);
    }
 
-   node->tag = tag;
-   return node;
+   if (first + count > *capacity) {
+      if (*capacity == 0)
+         *capacity = 1024;
+      while (*capacity < first + count)
+         *capacity *= 2;
+
+      *array = realloc(*array, (size_t) *capacity * element_size);
+      if (*array == NULL) {
+         fprintf(stderr, "Memory reallocation request failed.\n");
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   *number += count;
+   return first;
 }
 
-struct ast_expression *
-create_expression(int operator, struct ast_expression *lhs,
-                                 struct ast_expression *rhs)
+#define AST_APPEND_N(ast, kind, count)                               \
+   ast_append((void **) &(ast)->kind, &(ast)->number_of_##kind,      \
+              &(ast)->kind##_capacity, sizeof(*(ast)->kind), (count))
+
+#define AST_APPEND(ast, kind)    AST_APPEND_N(ast, kind, 1)
+
+void
+ast_init(struct ast *ast)
+{
+   memset(ast, 0, sizeof(struct ast));
+}
+
+void
+ast_destroy(struct ast *ast)
+{
+   free(ast->declarations);
+   free(ast->expressions);
+   free(ast->compound_statements);
+   free(ast->selection_statements);
+   free(ast->while_statements);
+   free(ast->for_statements);
+   free(ast->function_definitions);
+   free(ast->statements);
+   free(ast->pending);
+}
+
+void
+ast_release(struct ast *ast)
+{
+   ast->number_of_declarations = 0;
+   ast->number_of_expressions = 0;
+   ast->number_of_compound_statements = 0;
+   ast->number_of_selection_statements = 0;
+   ast->number_of_while_statements = 0;
+   ast->number_of_for_statements = 0;
+   ast->number_of_function_definitions = 0;
+   ast->number_of_statements = 0;
+   ast->number_of_pending = 0;
+}
+
+size_t
+ast_number_of_nodes(struct ast *ast)
+{
+   return (size_t) ast->number_of_declarations +
+                   ast->number_of_expressions +
+                   ast->number_of_compound_statements +
+                   ast->number_of_selection_statements +
+                   ast->number_of_while_statements +
+                   ast->number_of_for_statements +
+                   ast->number_of_function_definitions;
+}
+
+size_t
+ast_reserved_bytes(struct ast *ast)
+{
+   return ast->declarations_capacity * sizeof(struct ast_declaration) +
+          ast->expressions_capacity * sizeof(struct ast_expression) +
+          ast->compound_statements_capacity *
+             sizeof(struct ast_compound_statement) +
+          ast->selection_statements_capacity *
+             sizeof(struct ast_selection_statement) +
+          ast->while_statements_capacity *
+             sizeof(struct ast_while_statement) +
+          ast->for_statements_capacity * sizeof(struct ast_for_statement) +
+          ast->function_definitions_capacity *
+             sizeof(struct ast_function_definition) +
+          ast->statements_capacity * sizeof(ast_ref) +
+          ast->pending_capacity * sizeof(ast_ref);
+}
+
+size_t
+ast_used_bytes(struct ast *ast)
+{
+   return ast->number_of_declarations * sizeof(struct ast_declaration) +
+          ast->number_of_expressions * sizeof(struct ast_expression) +
+          ast->number_of_compound_statements *
+             sizeof(struct ast_compound_statement) +
+          ast->number_of_selection_statements *
+             sizeof(struct ast_selection_statement) +
+          ast->number_of_while_statements *
+             sizeof(struct ast_while_statement) +
+          ast->number_of_for_statements * sizeof(struct ast_for_statement) +
+          ast->number_of_function_definitions *
+             sizeof(struct ast_function_definition) +
+          ast->number_of_statements * sizeof(ast_ref);
+}
+
+ast_index
+create_expression(struct ast *ast, int operator, ast_index lhs,
+                                                 ast_index rhs)
 {
    struct ast_expression *expression;
+   ast_index index;
+
+   index = AST_APPEND(ast, expressions);
 
-   expression = alloc_node(AST_EXPRESSION);
+   expression = &ast->expressions[index];
    expression->operator = operator;
+   expression->type = 0;
    expression->subexpr[0] = lhs;
    expression->subexpr[1] = rhs;
+   expression->primary_expr.symbol = 0;
 
-   return expression;
+   return index;
 }
 
-struct ast_declaration *
-create_declaration(int type_specifier, const char *identifier)
+ast_index
+create_declaration(struct ast *ast, int type_specifier, int symbol,
+                   ast_index size)
 {
    struct ast_declaration *declaration;
+   ast_index index;
 
-   declaration = alloc_node(AST_DECLARATION);
+   index = AST_APPEND(ast, declarations);
+
+   declaration = &ast->declarations[index];
    declaration->type_specifier = type_specifier;
-   declaration->identifier = identifier;
+   declaration->symbol = symbol;
+   declaration->size = size;
 
-   return declaration;
+   return index;
 }
 
-struct ast_statement_list *
-create_statement_list(struct ast_node *statement)
+void
+statement_list_add_statement(struct ast *ast, ast_ref statement)
 {
-   struct ast_statement_list *statement_list;
-
-   statement_list = alloc_node(AST_STATEMENT_LIST);
-
-   statement_list->statement = calloc(1, sizeof(struct ast_node *));
-   if (statement_list->statement == NULL) {
-      fprintf(stderr, "Memory allocation request failed.\n");
-      exit(EXIT_FAILURE);
-   }
-
-   statement_list->statement[0] = statement;
-   statement_list->number_of_statements = 1;
+   ast_index index;
 
-   return statement_list;
+   index = AST_APPEND(ast, pending);
+   ast->pending[index] = statement;
 }
 
-struct ast_statement_list *
-statement_list_add_statement(struct ast_statement_list *statement_list,
-                             struct ast_node *statement)
+/* moves the innermost list off the pending stack into a contiguous range */
+static struct ast_statement_list
+ast_pop_statement_list(struct ast *ast, uint32_t number_of_statements)
 {
-   int nstmts;
-   size_t size;
-
-   nstmts = statement_list->number_of_statements + 1;
-   size = nstmts * sizeof(struct ast_statement *);
+   struct ast_statement_list statement_list;
 
-   statement_list->statement = realloc(statement_list->statement, size);
-   if (statement_list->statement == NULL) {
-      fprintf(stderr, "Memory reallocation request failed.\n");
-      exit(EXIT_FAILURE);
-   }
+   statement_list.first = AST_APPEND_N(ast, statements, number_of_statements);
+   statement_list.number_of_statements = number_of_statements;
 
-   statement_list->statement[nstmts - 1] = statement;
-   statement_list->number_of_statements++;
+   ast->number_of_pending -= number_of_statements;
+   memcpy(&ast->statements[statement_list.first],
+          &ast->pending[ast->number_of_pending],
+          number_of_statements * sizeof(ast_ref));
 
    return statement_list;
 }
 
-struct ast_compound_statement *
-create_compound_statement(struct ast_statement_list *statement_list)
+ast_index
+create_compound_statement(struct ast *ast, uint32_t number_of_statements)
 {
-   struct ast_compound_statement *compound_statement;
+   struct ast_statement_list statement_list;
+   ast_index index;
+
+   statement_list = ast_pop_statement_list(ast, number_of_statements);
 
-   compound_statement = alloc_node(AST_COMPOUND_STATEMENT);
-   compound_statement->statement_list = statement_list;
+   index = AST_APPEND(ast, compound_statements);
+   ast->compound_statements[index].statement_list = statement_list;
 
-   return compound_statement;
+   return index;
 }
 
-struct ast_selection_statement *
-create_selection_statement(struct ast_expression *condition,
-                           struct ast_compound_statement *then_body,
-                           struct ast_compound_statement *else_body)
+ast_index
+create_selection_statement(struct ast *ast, ast_index condition,
+                           ast_index then_body, ast_index else_body)
 {
    struct ast_selection_statement *selection_statement;
+   ast_index index;
 
-   selection_statement = alloc_node(AST_SELECTION_STATEMENT);
+   index = AST_APPEND(ast, selection_statements);
 
+   selection_statement = &ast->selection_statements[index];
    selection_statement->condition = condition;
    selection_statement->then_body = then_body;
    selection_statement->else_body = else_body;
 
-   return selection_statement;
+   return index;
 }
 
-struct ast_while_statement *
-create_while_statement(struct ast_expression *condition,
-                       struct ast_compound_statement *body)
+ast_index
+create_while_statement(struct ast *ast, ast_index condition,
+                       ast_index body)
 {
    struct ast_while_statement *while_statement;
+   ast_index index;
 
-   while_statement = alloc_node(AST_WHILE_STATEMENT);
+   index = AST_APPEND(ast, while_statements);
 
+   while_statement = &ast->while_statements[index];
    while_statement->condition = condition;
    while_statement->body = body;
 
-   return while_statement;
+   return index;
+}
+
+ast_index
+create_for_statement(struct ast *ast, int parallel, int index_symbol,
+                     ast_index lower, ast_index upper, ast_index body)
+{
+   struct ast_for_statement *for_statement;
+   ast_index index, declaration;
+
+   declaration = create_declaration(ast, TYPE_INT, index_symbol, AST_NONE);
+   index = AST_APPEND(ast, for_statements);
+
+   for_statement = &ast->for_statements[index];
+   for_statement->parallel = parallel;
+   for_statement->index = declaration;
+   for_statement->lower = lower;
+   for_statement->upper = upper;
+   for_statement->body = body;
+   for_statement->captures = AST_NONE;
+
+   return index;
 }
 
-struct ast_translation_unit *
-create_translation_unit(struct ast_statement_list *statement_list)
+ast_index
+create_function_definition(struct ast *ast, int type_specifier, int symbol,
+                           uint32_t number_of_parameters)
 {
-   struct ast_translation_unit *translation_unit;
+   struct ast_function_definition *function_definition;
+   ast_index index;
+
+   index = AST_APPEND(ast, function_definitions);
 
-   translation_unit = alloc_node(AST_TRANSLATION_UNIT);
-   translation_unit->statement_list = statement_list;
+   function_definition = &ast->function_definitions[index];
+   function_definition->type_specifier = type_specifier;
+   function_definition->symbol = symbol;
+   function_definition->first_parameter = ast->number_of_declarations -
+                                          number_of_parameters;
+   function_definition->number_of_parameters = number_of_parameters;
+   function_definition->body = AST_NONE;
 
-   return translation_unit;
+   return index;
+}
+
+void
+create_translation_unit(struct ast *ast, uint32_t number_of_statements)
+{
+   ast->translation_unit.statement_list =
+      ast_pop_statement_list(ast, number_of_statements);
 }
@@ -1,40 +1,57 @@
 #ifndef AST_H
 #define AST_H
 
-struct ast_node;
-struct ast_declaration;
-struct ast_expression;
-struct ast_statement_list;
-struct ast_compound_statement;
-struct ast_selection_statement;
-struct ast_while_statement;
-struct ast_translation_unit;
-
-#define AST_NODE                    1
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Flat AST: the nodes of each kind live in their own contiguous array
+ * and refer to each other by 32-bit index instead of by pointer.
+ *
+ * Statements are referenced through an ast_ref, which packs the kind of
+ * the statement in its top bits. A statement list is a contiguous range
+ * of the 'statements' array: while a list is being parsed its statements
+ * sit on the 'pending' stack, and they are moved into place in one go
+ * when the enclosing compound statement (or translation unit) completes.
+ */
+typedef uint32_t ast_index;
+typedef uint32_t ast_ref;
+
+#define AST_NONE                    UINT32_MAX
+#define AST_UNSIZED                 (UINT32_MAX - 1)
+
 #define AST_DECLARATION             2
 #define AST_EXPRESSION              3
-#define AST_STATEMENT_LIST          4
 #define AST_COMPOUND_STATEMENT      5
 #define AST_SELECTION_STATEMENT     6
 #define AST_WHILE_STATEMENT         7
-#define AST_TRANSLATION_UNIT        8
+#define AST_FUNCTION_DEFINITION     8     /* at the top level only */
+#define AST_RETURN_STATEMENT        9     /* indexes its expression */
+#define AST_FOR_STATEMENT           10
 
-struct ast_node {
-   int tag;
-};
+#define AST_REF_SHIFT               28
+#define AST_REF_MAX_INDEX           ((1u << AST_REF_SHIFT) - 1)
+
+#define AST_REF(tag, index)   (((ast_ref) (tag) << AST_REF_SHIFT) | (index))
+#define AST_REF_TAG(ref)      ((ref) >> AST_REF_SHIFT)
+#define AST_REF_INDEX(ref)    ((ref) & AST_REF_MAX_INDEX)
 
 struct ast_declaration {
-   int tag;
 
 #define TYPE_INT     1
 #define TYPE_FLOAT   2
+#define TYPE_BOOL    3     /* of a comparison; nothing is declared bool */
 
    int type_specifier;
-   const char *identifier;
+   int symbol;    /* interned identifier, see intern.h */
+   /*
+    * Element count of an array, AST_NONE for a scalar; an array
+    * parameter is AST_UNSIZED, taking its length from the argument.
+    */
+   ast_index size;
 };
 
 struct ast_expression {
-   int tag;
 
 #define AST_ADD            1     /* '+'   */
 #define AST_SUB            2     /* '-'   */
@@ -54,81 +71,198 @@ struct ast_expression {
 #define AST_FLOAT_CONSTANT 13
 #define AST_IDENTIFIER     14
 
-   int operator;
-   struct ast_expression *subexpr[2];
+/* symbol[subexpr[0]], and symbol[subexpr[1]] = subexpr[0] */
+#define AST_INDEX          15
+#define AST_ASSIGN_INDEX   16
+
+/*
+ * symbol(arguments): subexpr[0] is the first AST_ARGUMENT, or AST_NONE.
+ * An argument holds its value in subexpr[0] and the next one in
+ * subexpr[1].
+ */
+#define AST_CALL           17
+#define AST_ARGUMENT       18
+
+/* subexpr[0] converted to 'type', inserted by the type checker */
+#define AST_CONVERT        19
+
+/*
+ * The outer variables the body of a parallel for refers to, listed by
+ * the type checker: one it passes on as it is, or one it only ever
+ * reduces into, by 'symbol = symbol + e' or 'symbol = symbol * e'.
+ * 'type' is that of the variable, or of its elements; subexpr[0] is the
+ * next one, or AST_NONE.
+ */
+#define AST_CAPTURE        20
+#define AST_REDUCE_ADD     21
+#define AST_REDUCE_MUL     22
+
+   uint16_t operator;
+   uint16_t type;       /* TYPE_*, 0 until the tree is type checked */
+   ast_index subexpr[2];
    union {
       int int_constant;
       float float_constant;
-      const char *identifier;
+      int symbol;
    } primary_expr;
 };
 
+/* range [first, first + number_of_statements) of ast->statements */
 struct ast_statement_list {
-   int tag;
-
-   struct ast_node **statement;
-   int number_of_statements;
+   uint32_t first;
+   uint32_t number_of_statements;
 };
 
 struct ast_compound_statement {
-   int tag;
-
-   struct ast_statement_list *statement_list;
+   struct ast_statement_list statement_list;
 };
 
 struct ast_selection_statement {
-   int tag;
-
    /* if (condition) { then_body } else { else_body } */
-   struct ast_expression *condition;
-   struct ast_compound_statement *then_body;
-   struct ast_compound_statement *else_body;
+   ast_index condition;
+   ast_index then_body;    /* compound statements */
+   ast_index else_body;    /* AST_NONE without an else arm */
 };
 
 struct ast_while_statement {
-   int tag;
-
    /* while (condition) { body } */
-   struct ast_expression *condition;
-   struct ast_compound_statement *body;
+   ast_index condition;
+   ast_index body;
+};
+
+struct ast_for_statement {
+   /*
+    * for (int index = lower, upper) { body }, which runs the body with
+    * index from lower up to upper - 1; the bounds are evaluated once.
+    * A parallel for spreads the iterations over threads, see parallel.h.
+    */
+   int parallel;
+   ast_index index;        /* the declaration of the index */
+   ast_index lower;
+   ast_index upper;
+   ast_index body;         /* compound statement */
+   ast_index captures;     /* of a parallel for, see AST_CAPTURE */
+};
+
+struct ast_function_definition {
+   /* type_specifier symbol(parameters) { body } */
+   int type_specifier;     /* of the value returned */
+   int symbol;
+   uint32_t first_parameter;     /* range of ast->declarations */
+   uint32_t number_of_parameters;
+   ast_index body;         /* compound statement */
 };
 
 struct ast_translation_unit {
-   int tag;
+   struct ast_statement_list statement_list;
+};
+
+struct ast {
+   struct ast_declaration *declarations;
+   uint32_t number_of_declarations;
+   uint32_t declarations_capacity;
+
+   struct ast_expression *expressions;
+   uint32_t number_of_expressions;
+   uint32_t expressions_capacity;
+
+   struct ast_compound_statement *compound_statements;
+   uint32_t number_of_compound_statements;
+   uint32_t compound_statements_capacity;
+
+   struct ast_selection_statement *selection_statements;
+   uint32_t number_of_selection_statements;
+   uint32_t selection_statements_capacity;
 
-   struct ast_statement_list *statement_list;
+   struct ast_while_statement *while_statements;
+   uint32_t number_of_while_statements;
+   uint32_t while_statements_capacity;
+
+   struct ast_for_statement *for_statements;
+   uint32_t number_of_for_statements;
+   uint32_t for_statements_capacity;
+
+   struct ast_function_definition *function_definitions;
+   uint32_t number_of_function_definitions;
+   uint32_t function_definitions_capacity;
+
+   ast_ref *statements;
+   uint32_t number_of_statements;
+   uint32_t statements_capacity;
+
+   ast_ref *pending;
+   uint32_t number_of_pending;
+   uint32_t pending_capacity;
+
+   struct ast_translation_unit translation_unit;
 };
 
-struct ast_declaration *
-create_declaration(int type_specifier, const char *identifier);
+void ast_init(struct ast *ast);
+void ast_destroy(struct ast *ast);
+
+/* drops every node at once, keeping the arrays for reuse */
+void ast_release(struct ast *ast);
+
+size_t ast_number_of_nodes(struct ast *ast);
+
+/* what the nodes take up of the arrays */
+size_t ast_used_bytes(struct ast *ast);
 
-struct ast_expression *
-create_expression(int operation, struct ast_expression *lhs,
-                                 struct ast_expression *rhs);
+/* capacity of the node arrays, which is never given back before destroy */
+size_t ast_reserved_bytes(struct ast *ast);
 
-struct ast_statement_list *
-create_statement_list(struct ast_node *statement);
+ast_index
+create_declaration(struct ast *ast, int type_specifier, int symbol,
+                   ast_index size);
 
-struct ast_statement_list *
-statement_list_add_statement(struct ast_statement_list *statement_list,
-                             struct ast_node *statement);
+ast_index
+create_expression(struct ast *ast, int operation, ast_index lhs,
+                                                  ast_index rhs);
 
-struct ast_compound_statement *
-create_compound_statement(struct ast_statement_list *statement_list);
+/*
+ * Statement lists are built on the pending stack; the value of a list
+ * while it is being parsed is just the number of statements pushed.
+ */
+void
+statement_list_add_statement(struct ast *ast, ast_ref statement);
+
+ast_index
+create_compound_statement(struct ast *ast, uint32_t number_of_statements);
+
+ast_index
+create_selection_statement(struct ast *ast, ast_index condition,
+                           ast_index then_body, ast_index else_body);
+
+ast_index
+create_while_statement(struct ast *ast, ast_index condition,
+                       ast_index body);
 
-struct ast_selection_statement *
-create_selection_statement(struct ast_expression *condition,
-                           struct ast_compound_statement *then_body,
-                           struct ast_compound_statement *else_body);
+/* declares the index, an int */
+ast_index
+create_for_statement(struct ast *ast, int parallel, int index_symbol,
+                     ast_index lower, ast_index upper, ast_index body);
 
-struct ast_while_statement *
-create_while_statement(struct ast_expression *condition,
-                       struct ast_compound_statement *body);
+/*
+ * The parameters are the last 'number_of_parameters' declarations
+ * created; the body is filled in once it is parsed.
+ */
+ast_index
+create_function_definition(struct ast *ast, int type_specifier, int symbol,
+                           uint32_t number_of_parameters);
 
-struct ast_translation_unit *
-create_translation_unit(struct ast_statement_list *statement_list);
+void
+create_translation_unit(struct ast *ast, uint32_t number_of_statements);
+
+static inline struct ast_expression *
+ast_expression(struct ast *ast, ast_index index)
+{
+   return &ast->expressions[index];
+}
+
+void
+print_statement(struct ast *ast, ast_ref statement);
 
 void
-print_node(struct ast_node *node);
+print_translation_unit(struct ast *ast);
 
 #endif /* AST_H */
@@ -0,0 +1,278 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <llvm-c/BitReader.h>
+#include <llvm-c/Linker.h>
+
+#include "batch.h"
+#include "driver.h"
+#include "emit.h"
+#include "source.h"
+#include "target.h"
+#include "timer.h"
+
+struct batch_job {
+   const char *filename;
+   int status;
+
+   /* what is left of the module, see driver_artifact_kind() */
+   LLVMMemoryBufferRef artifact;
+};
+
+struct batch {
+   struct driver_options *options;
+   int link;
+
+   struct batch_job *jobs;
+   int number_of_jobs;
+   atomic_int next_job;
+};
+
+/* "dir/name.toy" becomes "dir/name.o" and so on */
+static char *
+batch_output_name(const char *filename, int kind)
+{
+   const char *extension, *slash, *dot;
+   char *output_name;
+   size_t length;
+
+   extension = emit_extension(kind);
+   slash = strrchr(filename, '/');
+   dot = strrchr(filename, '.');
+
+   length = strlen(filename);
+   if (dot != NULL && (slash == NULL || dot > slash))
+      length = dot - filename;
+
+   output_name = malloc(length + strlen(extension) + 1);
+   if (output_name == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   memcpy(output_name, filename, length);
+   strcpy(output_name + length, extension);
+
+   return output_name;
+}
+
+static void
+batch_compile_job(struct batch *batch, struct batch_job *job)
+{
+   struct driver_options *options = batch->options;
+   struct source source;
+   char *output_name;
+
+   if (source_open(&source, job->filename) != 0) {
+      fprintf(stderr, "%s: %s\n", job->filename, strerror(errno));
+      job->status = 1;
+      return;
+   }
+
+   job->artifact = driver_compile_artifact(options, job->filename, &source,
+                                           driver_artifact_kind(options));
+   source_close(&source);
+
+   if (job->artifact == NULL) {
+      job->status = 1;
+      return;
+   }
+
+   /* unless linking, objects and the like are written by the worker */
+   if (!batch->link && options->emit != 0) {
+      output_name = batch_output_name(job->filename, options->emit);
+      emit_write(output_name, LLVMGetBufferStart(job->artifact),
+                 LLVMGetBufferSize(job->artifact));
+      LLVMDisposeMemoryBuffer(job->artifact);
+      job->artifact = NULL;
+      free(output_name);
+   }
+}
+
+static void *
+batch_worker(void *arg)
+{
+   struct batch *batch = arg;
+   int i;
+
+   while ((i = atomic_fetch_add(&batch->next_job, 1)) < batch->number_of_jobs)
+      batch_compile_job(batch, &batch->jobs[i]);
+
+   return NULL;
+}
+
+static LLVMModuleRef
+batch_parse_bitcode(LLVMContextRef context, struct batch_job *job)
+{
+   LLVMModuleRef module;
+
+   if (LLVMParseBitcodeInContext2(context, job->artifact, &module)) {
+      fprintf(stderr, "%s: unable to read back bitcode\n", job->filename);
+      exit(EXIT_FAILURE);
+   }
+
+   LLVMDisposeMemoryBuffer(job->artifact);
+   job->artifact = NULL;
+
+   return module;
+}
+
+/*
+ * Links the modules of all jobs into one. The main function of job i is
+ * renamed to "main.<i>"; a new main calls them all in input order.
+ */
+static LLVMModuleRef
+batch_link(struct batch *batch, LLVMContextRef context)
+{
+   LLVMModuleRef linked, module;
+   LLVMTypeRef function_type;
+   LLVMValueRef function_value, callee;
+   LLVMBuilderRef builder;
+   char name[32], *error;
+   int i;
+
+   linked = LLVMModuleCreateWithNameInContext("Toy", context);
+   function_type = LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                    NULL, 0, 0);
+
+   for (i = 0; i < batch->number_of_jobs; i++) {
+      module = batch_parse_bitcode(context, &batch->jobs[i]);
+
+      /* optimized modules carry the host's triple and data layout */
+      if (i == 0) {
+         LLVMSetTarget(linked, LLVMGetTarget(module));
+         LLVMSetDataLayout(linked, LLVMGetDataLayoutStr(module));
+      }
+
+      snprintf(name, sizeof(name), "main.%d", i);
+      function_value = LLVMGetNamedFunction(module, "main");
+      LLVMSetValueName2(function_value, name, strlen(name));
+
+      /* destroys 'module' */
+      if (LLVMLinkModules2(linked, module)) {
+         fprintf(stderr, "%s: failed to link\n", batch->jobs[i].filename);
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   function_value = LLVMAddFunction(linked, "main", function_type);
+   builder = LLVMCreateBuilderInContext(context);
+   LLVMPositionBuilderAtEnd(builder,
+                            LLVMAppendBasicBlockInContext(context,
+                                                          function_value,
+                                                          "entry"));
+   for (i = 0; i < batch->number_of_jobs; i++) {
+      snprintf(name, sizeof(name), "main.%d", i);
+      callee = LLVMGetNamedFunction(linked, name);
+
+      /* only now: the linker drops internal functions nobody calls */
+      LLVMSetLinkage(callee, LLVMInternalLinkage);
+      LLVMBuildCall2(builder, function_type, callee, NULL, 0, "");
+   }
+   LLVMBuildRetVoid(builder);
+   LLVMDisposeBuilder(builder);
+
+   error = NULL;
+   LLVMVerifyModule(linked, LLVMAbortProcessAction, &error);
+   LLVMDisposeMessage(error);
+
+   return linked;
+}
+
+int
+batch_compile(struct driver_options *options, char **filenames,
+              int number_of_files)
+{
+   struct batch batch;
+   pthread_t *threads;
+   LLVMContextRef context;
+   int i, number_of_threads, failures;
+   double start;
+
+   start = timer_now();
+
+   batch.options = options;
+   batch.link = options->link || options->run;
+   batch.number_of_jobs = number_of_files;
+   atomic_init(&batch.next_job, 0);
+
+   batch.jobs = calloc(number_of_files, sizeof(struct batch_job));
+   if (batch.jobs == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+   for (i = 0; i < number_of_files; i++)
+      batch.jobs[i].filename = filenames[i];
+
+   number_of_threads = options->number_of_threads;
+   if (number_of_threads <= 0)
+      number_of_threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+   if (number_of_threads <= 0)
+      number_of_threads = 1;
+   if (number_of_threads > number_of_files)
+      number_of_threads = number_of_files;
+
+   threads = calloc(number_of_threads, sizeof(pthread_t));
+   if (threads == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   /* target registration is global, get it out of the way first */
+   target_initialize();
+
+   for (i = 0; i < number_of_threads; i++) {
+      if (pthread_create(&threads[i], NULL, batch_worker, &batch) != 0) {
+         fprintf(stderr, "Unable to create worker thread.\n");
+         exit(EXIT_FAILURE);
+      }
+   }
+   for (i = 0; i < number_of_threads; i++)
+      pthread_join(threads[i], NULL);
+   free(threads);
+
+   if (options->time_report)
+      fprintf(stderr, "batch: %d files on %d threads in %.3f ms\n",
+                      number_of_files, number_of_threads,
+                      timer_elapsed_ms(start));
+
+   failures = 0;
+   for (i = 0; i < number_of_files; i++) {
+      if (batch.jobs[i].status != 0)
+         failures++;
+   }
+
+   if (batch.link && failures == 0) {
+      context = LLVMContextCreate();
+      driver_output_module(options, batch_link(&batch, context),
+                           options->output_name, NULL);
+      LLVMContextDispose(context);
+   } else if (!batch.link) {
+      /* what is left is IR text to dump, in input order */
+      for (i = 0; i < number_of_files; i++) {
+         if (batch.jobs[i].artifact == NULL)
+            continue;
+         fwrite(LLVMGetBufferStart(batch.jobs[i].artifact), 1,
+                LLVMGetBufferSize(batch.jobs[i].artifact), stderr);
+      }
+   }
+
+   for (i = 0; i < number_of_files; i++) {
+      if (batch.jobs[i].artifact != NULL)
+         LLVMDisposeMemoryBuffer(batch.jobs[i].artifact);
+   }
+   free(batch.jobs);
+
+   if (failures != 0) {
+      fprintf(stderr, "batch: %d of %d files failed\n",
+                      failures, number_of_files);
+      return EXIT_FAILURE;
+   }
+
+   return 0;
+}
@@ -0,0 +1,20 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+struct driver_options;
+
+/*
+ * Compiles several sources in one process, on options->number_of_threads
+ * worker threads (one per CPU by default). Every file gets its own
+ * scanner, parser and LLVM context, so the workers share nothing but the
+ * queue of files.
+ *
+ * With options->link (implied by options->run) the modules are linked
+ * into one whose main calls the main of every file in turn. Otherwise
+ * each file's module is written next to it as requested by --emit, or
+ * dumped in input order. Returns 0 if every file compiled.
+ */
+int batch_compile(struct driver_options *options, char **filenames,
+                  int number_of_files);
+
+#endif /* BATCH_H */
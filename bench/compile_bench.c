@@ -0,0 +1,853 @@
+/*
+ * Compiler throughput benchmark. Generates synthetic programs of the
+ * shapes that stress the front end (long flat statement lists, deep
+ * left- and right-leaning expressions, deeply nested blocks, huge
+ * numbers of declarations) and times lexing, parsing, lowering and
+ * optimization of each one separately, best of BENCH_RUNS.
+ *
+ *    bench_compile [-o results.tsv] [baseline.tsv]
+ *    bench_compile --generate=<shape> [scale]
+ *    bench_compile --input=<file>
+ *    bench_compile --startup
+ *
+ * Results are written as tab-separated lines of shape, phase, ms, bytes/s
+ * and nodes/s. Given a baseline in the same format, every phase whose
+ * throughput dropped by more than BENCH_TOLERANCE is flagged, and the
+ * exit status is 1.
+ *
+ * Every program is also scanned by the hand-written scanner (fastlex.h),
+ * which has to produce the very tokens flex did.
+ *
+ * --input scans a file, as large as you like, the way standard input is
+ * read, mapped in place (see source.h) and mapped with the hand-written
+ * scanner, and prints the throughput of each. The two scanners are first
+ * compared token by token; on a mismatch the exit status is 1.
+ *
+ * --startup times a script from source to result, the way the scanner
+ * runs one, on each engine: the bytecode interpreter, the jit at -O0
+ * and -O2, and the interpreter tiering up to -O2 (see tier.h). The
+ * script's main loop runs from 1 to 10^7 times, which shows where
+ * compiling to native code starts to pay off, and how close tiering
+ * stays to the best of both.
+ */
+#include <sys/stat.h>
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "driver.h"
+#include "fastlex.h"
+#include "interp.h"
+#include "parser.tab.h"
+#include "source.h"
+#include "timer.h"
+
+#define BENCH_RUNS         5
+#define BENCH_OPT_LEVEL    2
+#define BENCH_TOLERANCE    0.20     /* relative drop in bytes/s */
+#define BENCH_INPUT_RUNS   3        /* of --input, per path */
+#define BENCH_STARTUP_RUNS 3        /* of --startup, per engine and size */
+
+/* from the reentrant scanner, see lexer.l */
+typedef void *yyscan_t;
+
+int yylex_init(yyscan_t *scanner);
+int yylex_destroy(yyscan_t scanner);
+void yyset_in(FILE *input, yyscan_t scanner);
+struct yy_buffer_state *yy_scan_buffer(char *base, size_t size,
+                                       yyscan_t scanner);
+char *yyget_text(yyscan_t scanner);
+int yylex(YYSTYPE *value, yyscan_t scanner);
+
+/* declares the variables every shape may use */
+static void
+generate_prologue(FILE *out)
+{
+   fprintf(out, "int a;\nint b;\nint c;\nfloat f;\n");
+   fprintf(out, "a = 1;\nb = 2;\nc = 3;\nf = 0.5;\n");
+}
+
+static void
+generate_flat(FILE *out, int scale)
+{
+   int i;
+
+   generate_prologue(out);
+   for (i = 0; i < 40000 * scale; i++) {
+      switch (i % 4) {
+         case 0: fprintf(out, "a = b * %d + c;\n", i); break;
+         case 1: fprintf(out, "b = a - c / %d;\n", i % 7 + 1); break;
+         case 2: fprintf(out, "c = (a + b) * (c - %d);\n", i); break;
+         case 3: fprintf(out, "f = f * 1.5 + 2.0;\n"); break;
+      }
+   }
+}
+
+/* a + 1 + 2 + ...: the parser reduces as it goes */
+static void
+generate_left(FILE *out, int scale)
+{
+   int i, j;
+
+   generate_prologue(out);
+   for (i = 0; i < 80 * scale; i++) {
+      fprintf(out, "a = a");
+      for (j = 0; j < 2000; j++)
+         fprintf(out, " + %d", j);
+      fprintf(out, ";\n");
+   }
+}
+
+/* 1 + (2 + (3 + ...)): the parser stack grows with the depth */
+static void
+generate_right(FILE *out, int scale)
+{
+   int i, j;
+
+   generate_prologue(out);
+   for (i = 0; i < 80 * scale; i++) {
+      fprintf(out, "a = ");
+      for (j = 0; j < 2000; j++)
+         fprintf(out, "b + (");
+      fprintf(out, "c");
+      for (j = 0; j < 2000; j++)
+         fprintf(out, ")");
+      fprintf(out, ";\n");
+   }
+}
+
+/* if and while blocks nested 256 deep */
+static void
+generate_nested(FILE *out, int scale)
+{
+   int i, j;
+
+   generate_prologue(out);
+   for (i = 0; i < 64 * scale; i++) {
+      for (j = 0; j < 256; j++) {
+         if (j % 2 == 0)
+            fprintf(out, "if (a < %d) {\n", j);
+         else
+            fprintf(out, "while (b > %d) {\n", j);
+         fprintf(out, "b = b - 1;\n");
+      }
+      fprintf(out, "c = c + 1;\n");
+      for (j = 0; j < 256; j++)
+         fprintf(out, "}\n");
+   }
+}
+
+static void
+generate_declarations(FILE *out, int scale)
+{
+   int i;
+
+   generate_prologue(out);
+   for (i = 0; i < 100000 * scale; i++)
+      fprintf(out, "%s v%d;\n", i % 3 == 0 ? "float" : "int", i);
+}
+
+static const struct shape {
+   const char *name;
+   void (*generate)(FILE *out, int scale);
+} shapes[] = {
+   { "flat",         generate_flat },
+   { "left",         generate_left },
+   { "right",        generate_right },
+   { "nested",       generate_nested },
+   { "declarations", generate_declarations },
+};
+
+#define NUMBER_OF_SHAPES   (sizeof(shapes) / sizeof(shapes[0]))
+
+struct result {
+   size_t bytes;
+   size_t tokens;
+   size_t nodes;
+
+   double lex_ms;
+   double fastlex_ms;
+   double parse_ms;
+   double lower_ms;
+   double optimize_ms;
+};
+
+static char *
+generate(const struct shape *shape, int scale, size_t *size)
+{
+   char *source;
+   FILE *out;
+
+   out = open_memstream(&source, size);
+   if (out == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+   shape->generate(out, scale);
+   fclose(out);
+
+   return source;
+}
+
+static FILE *
+open_source(char *source, size_t size)
+{
+   FILE *input;
+
+   input = fmemopen(source, size, "r");
+   if (input == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   return input;
+}
+
+struct tokens {
+   int *tokens;
+   YYSTYPE *values;
+   size_t number_of_tokens;
+   size_t capacity;
+};
+
+/* lexes all of 'source' up front, so that parsing can be timed alone */
+static double
+bench_lexer(char *source, size_t size, struct tokens *tokens)
+{
+   yyscan_t scanner;
+   FILE *input;
+   double start, ms;
+   int token;
+
+   input = open_source(source, size);
+   if (yylex_init(&scanner) != 0) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+   yyset_in(input, scanner);
+
+   tokens->number_of_tokens = 0;
+   start = timer_now();
+   do {
+      if (tokens->number_of_tokens == tokens->capacity) {
+         tokens->capacity = tokens->capacity ? 2 * tokens->capacity : 4096;
+         tokens->tokens = realloc(tokens->tokens,
+                                  tokens->capacity * sizeof(int));
+         tokens->values = realloc(tokens->values,
+                                  tokens->capacity * sizeof(YYSTYPE));
+         if (tokens->tokens == NULL || tokens->values == NULL) {
+            fprintf(stderr, "Memory allocation request failed.\n");
+            exit(EXIT_FAILURE);
+         }
+      }
+
+      token = yylex(&tokens->values[tokens->number_of_tokens], scanner);
+      tokens->tokens[tokens->number_of_tokens++] = token;
+   } while (token != 0);
+   ms = timer_elapsed_ms(start);
+
+   yylex_destroy(scanner);
+   fclose(input);
+
+   return ms;
+}
+
+static int
+same_token(int token, YYSTYPE *value, int other_token, YYSTYPE *other_value)
+{
+   if (token != other_token)
+      return 0;
+
+   switch (token) {
+      case IDENTIFIER:
+         return value->symbol == other_value->symbol;
+      case INT_CONSTANT:
+         return value->int_const == other_value->int_const;
+      case FLOAT_CONSTANT:
+         return memcmp(&value->float_const, &other_value->float_const,
+                       sizeof(float)) == 0;
+      default:
+         return 1;
+   }
+}
+
+/*
+ * Times the hand-written scanner on 'source', then checks that it makes
+ * the same tokens of it as flex did; a difference is fatal.
+ */
+static double
+bench_fastlex(const char *name, char *source, size_t size,
+              struct tokens *tokens)
+{
+   struct fastlex lexer;
+   YYSTYPE value;
+   double start, ms;
+   size_t i;
+   int token;
+
+   fastlex_init(&lexer, source, size);
+   start = timer_now();
+   while (fastlex_next(&lexer, &value) != 0)
+      ;
+   ms = timer_elapsed_ms(start);
+
+   fastlex_init(&lexer, source, size);
+   for (i = 0; i < tokens->number_of_tokens; i++) {
+      token = fastlex_next(&lexer, &value);
+      if (!same_token(tokens->tokens[i], &tokens->values[i], token, &value)) {
+         fprintf(stderr, "%s: token %zu at byte %td: flex %d, fastlex %d\n",
+                 name, i, lexer.text - source, tokens->tokens[i], token);
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   return ms;
+}
+
+/*
+ * Feeds the tokens to the parser, which lowers and optimizes the program
+ * once it reduces the translation unit; see driver_finish().
+ */
+static int
+bench_parser(struct driver *driver, struct tokens *tokens)
+{
+   yypstate *parser;
+   size_t i;
+   int status = YYPUSH_MORE;
+
+   driver->start = timer_now();
+   parser = yypstate_new();
+   for (i = 0; i < tokens->number_of_tokens && status == YYPUSH_MORE; i++)
+      status = yypush_parse(parser, tokens->tokens[i], &tokens->values[i],
+                            driver, driver->ast);
+   yypstate_delete(parser);
+
+   return status;
+}
+
+/* the compiler reports on stderr as it goes; keep that out of the table */
+static int
+silence_stderr(void)
+{
+   int saved, null;
+
+   fflush(stderr);
+   saved = dup(STDERR_FILENO);
+   null = open("/dev/null", O_WRONLY);
+   dup2(null, STDERR_FILENO);
+   close(null);
+
+   return saved;
+}
+
+static void
+restore_stderr(int saved)
+{
+   fflush(stderr);
+   dup2(saved, STDERR_FILENO);
+   close(saved);
+}
+
+static void
+bench_shape(const struct shape *shape, struct result *result)
+{
+   struct driver_options options = { 0 };
+   struct tokens tokens = { 0 };
+   struct driver *driver;
+   double lex_ms, fastlex_ms, lower_ms, *phase;
+   char *source;
+   int run, saved, status;
+
+   source = generate(shape, 1, &result->bytes);
+   options.opt_level = BENCH_OPT_LEVEL;
+
+   for (run = 0; run < BENCH_RUNS; run++) {
+      lex_ms = bench_lexer(source, result->bytes, &tokens);
+      fastlex_ms = bench_fastlex(shape->name, source, result->bytes, &tokens);
+
+      saved = silence_stderr();
+      driver = driver_create(&options, shape->name);
+      status = bench_parser(driver, &tokens);
+      restore_stderr(saved);
+
+      if (status != 0) {
+         fprintf(stderr, "%s: generated program does not compile\n",
+                         shape->name);
+         exit(EXIT_FAILURE);
+      }
+
+      result->tokens = tokens.number_of_tokens;
+      result->nodes = driver->number_of_nodes;
+      if (run == 0 || lex_ms < result->lex_ms)
+         result->lex_ms = lex_ms;
+      if (run == 0 || fastlex_ms < result->fastlex_ms)
+         result->fastlex_ms = fastlex_ms;
+      phase = driver->report.phase_ms;
+      lower_ms = phase[PHASE_TYPECHECK] + phase[PHASE_SIMPLIFY] +
+                 phase[PHASE_CODEGEN] + phase[PHASE_VERIFY];
+      if (run == 0 || phase[PHASE_PARSE] < result->parse_ms)
+         result->parse_ms = phase[PHASE_PARSE];
+      if (run == 0 || lower_ms < result->lower_ms)
+         result->lower_ms = lower_ms;
+      if (run == 0 || phase[PHASE_OPTIMIZE] < result->optimize_ms)
+         result->optimize_ms = phase[PHASE_OPTIMIZE];
+
+      driver_destroy(driver);
+   }
+
+   free(tokens.tokens);
+   free(tokens.values);
+   free(source);
+}
+
+static const char *bench_phases[] = {
+   "lex", "fastlex", "parse", "lower", "optimize"
+};
+
+#define NUMBER_OF_BENCH_PHASES \
+   (sizeof(bench_phases) / sizeof(bench_phases[0]))
+
+static double
+phase_ms(const struct result *result, int phase)
+{
+   switch (phase) {
+      case 0: return result->lex_ms;
+      case 1: return result->fastlex_ms;
+      case 2: return result->parse_ms;
+      case 3: return result->lower_ms;
+      default: return result->optimize_ms;
+   }
+}
+
+static void
+write_results(FILE *out, const struct result *results)
+{
+   size_t i, phase;
+   double ms;
+
+   fprintf(out, "# shape\tphase\tms\tbytes_per_s\tnodes_per_s\n");
+   for (i = 0; i < NUMBER_OF_SHAPES; i++) {
+      for (phase = 0; phase < NUMBER_OF_BENCH_PHASES; phase++) {
+         ms = phase_ms(&results[i], phase);
+         fprintf(out, "%s\t%s\t%.3f\t%.0f\t%.0f\n",
+                 shapes[i].name, bench_phases[phase], ms,
+                 results[i].bytes / ms * 1000.0,
+                 results[i].nodes / ms * 1000.0);
+      }
+   }
+}
+
+static void
+print_table(const struct result *results)
+{
+   size_t i;
+
+   printf("%-13s %9s %9s %8s %8s %9s %9s %9s\n",
+          "shape", "KB", "nodes", "lex", "fastlex", "parse", "lower",
+          "optimize");
+   printf("%-13s %9s %9s %8s %8s %9s %9s %9s\n",
+          "", "", "", "MB/s", "MB/s", "Mnodes/s", "Mnodes/s", "Mnodes/s");
+   for (i = 0; i < NUMBER_OF_SHAPES; i++) {
+      const struct result *r = &results[i];
+
+      printf("%-13s %9zu %9zu %8.1f %8.1f %9.2f %9.2f %9.2f\n",
+             shapes[i].name, r->bytes / 1024, r->nodes,
+             r->bytes / r->lex_ms / 1000.0,
+             r->bytes / r->fastlex_ms / 1000.0,
+             r->nodes / r->parse_ms / 1000.0,
+             r->nodes / r->lower_ms / 1000.0,
+             r->nodes / r->optimize_ms / 1000.0);
+   }
+}
+
+/* returns the number of phases that regressed against 'filename' */
+static int
+compare_baseline(const char *filename, const struct result *results)
+{
+   char line[256], shape[64], phase[32];
+   double ms, bytes_per_s, nodes_per_s, current;
+   int regressions = 0;
+   size_t i, j;
+   FILE *in;
+
+   in = fopen(filename, "r");
+   if (in == NULL) {
+      perror(filename);
+      exit(EXIT_FAILURE);
+   }
+
+   while (fgets(line, sizeof(line), in) != NULL) {
+      if (line[0] == '#' ||
+          sscanf(line, "%63s %31s %lf %lf %lf", shape, phase,
+                 &ms, &bytes_per_s, &nodes_per_s) != 5)
+         continue;
+
+      for (i = 0; i < NUMBER_OF_SHAPES; i++) {
+         if (strcmp(shapes[i].name, shape) != 0)
+            continue;
+         for (j = 0; j < NUMBER_OF_BENCH_PHASES; j++) {
+            if (strcmp(bench_phases[j], phase) != 0)
+               continue;
+
+            current = results[i].bytes / phase_ms(&results[i], j) * 1000.0;
+            if (current < bytes_per_s * (1.0 - BENCH_TOLERANCE)) {
+               printf("REGRESSION %s %s: %.0f bytes/s, baseline %.0f "
+                      "(%+.0f%%)\n", shape, phase, current, bytes_per_s,
+                      (current / bytes_per_s - 1.0) * 100.0);
+               regressions++;
+            }
+         }
+      }
+   }
+
+   fclose(in);
+   return regressions;
+}
+
+#define INPUT_READ         0     /* through stdio, as standard input */
+#define INPUT_MAPPED       1     /* flex on the mapping */
+#define INPUT_FAST         2     /* the hand-written scanner on the mapping */
+#define NUMBER_OF_INPUTS   3
+
+/* scans 'filename' once, the INPUT_* way */
+static double
+bench_input_path(const char *filename, int path, uint64_t *number_of_tokens)
+{
+   struct fastlex fastlex;
+   struct source source;
+   yyscan_t scanner;
+   YYSTYPE value;
+   FILE *input = NULL;
+   double start, ms;
+   int token;
+
+   if (yylex_init(&scanner) != 0) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   start = timer_now();
+   if (path == INPUT_READ) {
+      input = fopen(filename, "r");
+      if (input == NULL) {
+         perror(filename);
+         exit(EXIT_FAILURE);
+      }
+      yyset_in(input, scanner);
+   } else {
+      if (source_open(&source, filename) != 0) {
+         perror(filename);
+         exit(EXIT_FAILURE);
+      }
+      if (path == INPUT_FAST)
+         fastlex_init(&fastlex, source.data, source.size);
+      else if (yy_scan_buffer(source.data, source.size + SOURCE_PADDING,
+                              scanner) == NULL) {
+         fprintf(stderr, "Memory allocation request failed.\n");
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   *number_of_tokens = 0;
+   for (;;) {
+      if (path == INPUT_FAST)
+         token = fastlex_next(&fastlex, &value);
+      else
+         token = yylex(&value, scanner);
+      if (token == 0)
+         break;
+
+      (*number_of_tokens)++;
+      if (path != INPUT_READ && (*number_of_tokens & 0xfff) == 0)
+         source_release(&source, path == INPUT_FAST ? fastlex.text :
+                                                      yyget_text(scanner));
+   }
+
+   if (path == INPUT_READ)
+      fclose(input);
+   else
+      source_close(&source);
+   ms = timer_elapsed_ms(start);
+
+   yylex_destroy(scanner);
+
+   return ms;
+}
+
+/*
+ * Runs flex (reading 'filename') and the hand-written scanner (on its
+ * mapping) side by side; returns 0 if they agree on every token.
+ */
+static int
+diff_input(const char *filename)
+{
+   struct fastlex fastlex;
+   struct source source;
+   yyscan_t scanner;
+   YYSTYPE value, fast_value;
+   uint64_t i;
+   FILE *input;
+   int token, fast_token;
+
+   input = fopen(filename, "r");
+   if (input == NULL || source_open(&source, filename) != 0) {
+      perror(filename);
+      exit(EXIT_FAILURE);
+   }
+   if (yylex_init(&scanner) != 0) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+   yyset_in(input, scanner);
+   fastlex_init(&fastlex, source.data, source.size);
+
+   for (i = 0; ; i++) {
+      token = yylex(&value, scanner);
+      fast_token = fastlex_next(&fastlex, &fast_value);
+      if (!same_token(token, &value, fast_token, &fast_value)) {
+         printf("MISMATCH %s: token %" PRIu64 " at byte %td: flex %d, "
+                "fastlex %d\n", filename, i, fastlex.text - source.data,
+                token, fast_token);
+         break;
+      }
+      if (token == 0)
+         break;
+   }
+
+   yylex_destroy(scanner);
+   source_close(&source);
+   fclose(input);
+
+   return token != 0 || fast_token != 0;
+}
+
+static int
+bench_input(const char *filename)
+{
+   static const char *paths[NUMBER_OF_INPUTS] = { "read", "mapped", "fast" };
+   uint64_t number_of_tokens;
+   double best[NUMBER_OF_INPUTS] = { 0 }, ms;
+   struct stat st;
+   int run, path;
+
+   if (stat(filename, &st) != 0) {
+      perror(filename);
+      exit(EXIT_FAILURE);
+   }
+
+   if (diff_input(filename) != 0)
+      return 1;
+
+   /* alternating, so that every path sees the same page cache */
+   for (run = 0; run < BENCH_INPUT_RUNS; run++) {
+      for (path = 0; path < NUMBER_OF_INPUTS; path++) {
+         ms = bench_input_path(filename, path, &number_of_tokens);
+         if (run == 0 || ms < best[path])
+            best[path] = ms;
+      }
+   }
+
+   printf("%s: %lld bytes, %" PRIu64 " tokens, best of %d runs\n",
+          filename, (long long) st.st_size, number_of_tokens,
+          BENCH_INPUT_RUNS);
+   for (path = 0; path < NUMBER_OF_INPUTS; path++)
+      printf("   %-8s %10.1f ms %10.1f MB/s\n", paths[path], best[path],
+             st.st_size / 1e6 / (best[path] / 1000.0));
+
+   return 0;
+}
+
+/* a loop of 'iterations' with a call, an array and float math in it */
+static void
+generate_startup(FILE *out, int iterations)
+{
+   fprintf(out, "int step(int k) { return k * 3 / 2; }\n");
+   fprintf(out, "int i;\nint s;\nfloat x;\nint a[64];\n");
+   fprintf(out, "i = 0;\ns = 0;\nx = 0.0;\n");
+   fprintf(out, "while (i < %d) {\n", iterations);
+   fprintf(out, "   a[i - i / 64 * 64] = s;\n");
+   fprintf(out, "   s = s + step(i) - a[i / 2 - i / 128 * 64];\n");
+   fprintf(out, "   x = x * 0.5 + i;\n");
+   fprintf(out, "   i = i + 1;\n");
+   fprintf(out, "}\n");
+}
+
+#define ENGINE_INTERP      0
+#define ENGINE_JIT_O0      1
+#define ENGINE_JIT_O2      2
+#define ENGINE_TIERED      3
+#define NUMBER_OF_ENGINES  4
+
+/*
+ * From the start of the parse until the driver is gone, which for
+ * tiered includes winding down a compile the script outran.
+ */
+static double
+bench_startup_engine(char *source, size_t size, int engine)
+{
+   struct driver_options options = { 0 };
+   struct driver *driver;
+   FILE *input;
+   double start, ms;
+   int saved, status;
+
+   options.interp = engine == ENGINE_INTERP || engine == ENGINE_TIERED;
+   options.tiered = engine == ENGINE_TIERED;
+   options.run = !options.interp;
+   options.opt_level = engine == ENGINE_JIT_O2 ? 2 : 0;
+
+   input = open_source(source, size);
+   saved = silence_stderr();
+   start = timer_now();
+   driver = driver_create(&options, "startup");
+   status = parse_input(driver, input);
+   if (status == 0 && options.interp) {
+      interp_run(driver->bytecode, driver->tier);
+   } else if (status == 0) {
+      driver_output_module(&options, driver->vm->module, NULL,
+                           &driver->report);
+      driver->vm->module = NULL;
+   }
+   driver_destroy(driver);
+   ms = timer_elapsed_ms(start);
+   restore_stderr(saved);
+   fclose(input);
+
+   if (status != 0) {
+      fprintf(stderr, "startup: generated program does not compile\n");
+      exit(EXIT_FAILURE);
+   }
+
+   return ms;
+}
+
+static int
+bench_startup(void)
+{
+   static const char *engines[NUMBER_OF_ENGINES] = {
+      "interp", "jit -O0", "jit -O2", "tiered"
+   };
+   double best[NUMBER_OF_ENGINES], ms;
+   int iterations, run, engine, fastest, crossover = 0;
+   char *source;
+   size_t size;
+   FILE *out;
+
+   printf("source to result, best of %d runs\n", BENCH_STARTUP_RUNS);
+   printf("%10s %12s %12s %12s %12s   %s\n", "iterations", engines[0],
+          engines[1], engines[2], engines[3], "fastest");
+
+   for (iterations = 1; iterations <= 10000000; iterations *= 10) {
+      out = open_memstream(&source, &size);
+      if (out == NULL) {
+         fprintf(stderr, "Memory allocation request failed.\n");
+         exit(EXIT_FAILURE);
+      }
+      generate_startup(out, iterations);
+      fclose(out);
+
+      for (run = 0; run < BENCH_STARTUP_RUNS; run++) {
+         for (engine = 0; engine < NUMBER_OF_ENGINES; engine++) {
+            ms = bench_startup_engine(source, size, engine);
+            if (run == 0 || ms < best[engine])
+               best[engine] = ms;
+         }
+      }
+      free(source);
+
+      /* of the engines that stick to one tier */
+      fastest = 0;
+      for (engine = 1; engine < ENGINE_TIERED; engine++)
+         if (best[engine] < best[fastest])
+            fastest = engine;
+      if (fastest != ENGINE_INTERP && crossover == 0)
+         crossover = iterations;
+
+      printf("%10d %9.3f ms %9.3f ms %9.3f ms %9.3f ms   %s\n", iterations,
+             best[0], best[1], best[2], best[3], engines[fastest]);
+   }
+
+   if (crossover != 0)
+      printf("the jit wins from %d iterations on\n", crossover);
+   else
+      printf("the interpreter wins throughout\n");
+
+   return 0;
+}
+
+static void
+usage(const char *program)
+{
+   size_t i;
+
+   fprintf(stderr, "Usage: %s [-o results.tsv] [baseline.tsv]\n", program);
+   fprintf(stderr, "       %s --generate=<shape> [scale]\n", program);
+   fprintf(stderr, "       %s --input=<file>\n", program);
+   fprintf(stderr, "       %s --startup\n", program);
+   fprintf(stderr, "Shapes:");
+   for (i = 0; i < NUMBER_OF_SHAPES; i++)
+      fprintf(stderr, " %s", shapes[i].name);
+   fprintf(stderr, "\n");
+   exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[])
+{
+   struct result results[NUMBER_OF_SHAPES] = { { 0 } };
+   const char *output_name = NULL, *baseline_name = NULL;
+   FILE *out;
+   size_t i;
+   int arg;
+
+   if (argc >= 2 && strncmp(argv[1], "--generate=", 11) == 0) {
+      for (i = 0; i < NUMBER_OF_SHAPES; i++) {
+         if (strcmp(shapes[i].name, argv[1] + 11) == 0) {
+            shapes[i].generate(stdout, argc >= 3 ? atoi(argv[2]) : 1);
+            return 0;
+         }
+      }
+      usage(argv[0]);
+   }
+
+   if (argc == 2 && strncmp(argv[1], "--input=", 8) == 0)
+      return bench_input(argv[1] + 8);
+
+   if (argc == 2 && strcmp(argv[1], "--startup") == 0)
+      return bench_startup();
+
+   for (arg = 1; arg < argc; arg++) {
+      if (strcmp(argv[arg], "-o") == 0 && arg + 1 < argc)
+         output_name = argv[++arg];
+      else if (argv[arg][0] == '-' || baseline_name != NULL)
+         usage(argv[0]);
+      else
+         baseline_name = argv[arg];
+   }
+
+   printf("-O%d, best of %d runs\n", BENCH_OPT_LEVEL, BENCH_RUNS);
+   for (i = 0; i < NUMBER_OF_SHAPES; i++)
+      bench_shape(&shapes[i], &results[i]);
+   print_table(results);
+
+   if (output_name != NULL) {
+      out = fopen(output_name, "w");
+      if (out == NULL) {
+         perror(output_name);
+         exit(EXIT_FAILURE);
+      }
+      write_results(out, results);
+      fclose(out);
+   } else {
+      write_results(stdout, results);
+   }
+
+   if (baseline_name != NULL && compare_baseline(baseline_name, results) > 0)
+      return 1;
+
+   return 0;
+}
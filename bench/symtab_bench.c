@@ -0,0 +1,133 @@
+/*
+ * Symbol table benchmark: 1M distinct variables, each referenced many
+ * times in a shuffled order. Compares the old GHashTable path (strdup the
+ * lexeme, hash the full string on every reference) against interning the
+ * lexeme and indexing the flat symbol table by symbol id.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "intern.h"
+#include "symtab.h"
+#include "timer.h"
+#include "vm_value.h"
+
+#define NUMBER_OF_VARIABLES      1000000
+#define REFERENCES_PER_VARIABLE  16
+
+static char (*names)[16];
+static int *references;
+
+static void
+generate(void)
+{
+   int i, j, n, tmp;
+
+   names = malloc(NUMBER_OF_VARIABLES * sizeof(*names));
+   references = malloc(NUMBER_OF_VARIABLES * REFERENCES_PER_VARIABLE *
+                       sizeof(int));
+   if (names == NULL || references == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   for (i = 0; i < NUMBER_OF_VARIABLES; i++)
+      snprintf(names[i], sizeof(names[i]), "var_%d", i);
+
+   n = NUMBER_OF_VARIABLES * REFERENCES_PER_VARIABLE;
+   for (i = 0; i < n; i++)
+      references[i] = i % NUMBER_OF_VARIABLES;
+
+   srand(42);
+   for (i = n - 1; i > 0; i--) {
+      j = rand() % (i + 1);
+      tmp = references[i];
+      references[i] = references[j];
+      references[j] = tmp;
+   }
+}
+
+static void
+bench_ghashtable(struct vm_value *values)
+{
+   GHashTable *ht;
+   double start, declare_ms, reference_ms;
+   long checksum = 0;
+   int i;
+
+   start = timer_now();
+   ht = g_hash_table_new(g_str_hash, g_str_equal);
+   for (i = 0; i < NUMBER_OF_VARIABLES; i++)
+      g_hash_table_insert(ht, strdup(names[i]), &values[i]);
+   declare_ms = timer_elapsed_ms(start);
+
+   start = timer_now();
+   for (i = 0; i < NUMBER_OF_VARIABLES * REFERENCES_PER_VARIABLE; i++) {
+      char *lexeme = strdup(names[references[i]]);
+      struct vm_value *vmval = g_hash_table_lookup(ht, lexeme);
+      checksum += vmval->type_specifier;
+      free(lexeme);
+   }
+   reference_ms = timer_elapsed_ms(start);
+
+   printf("GHashTable     declare %9.1f ms   reference %9.1f ms   (%ld)\n",
+          declare_ms, reference_ms, checksum);
+   g_hash_table_destroy(ht);
+}
+
+static void
+bench_interned(struct vm_value *values)
+{
+   struct symbol_table *symtab;
+   double start, declare_ms, reference_ms;
+   long checksum = 0;
+   int i;
+
+   start = timer_now();
+   symtab = symbol_table_create();
+   for (i = 0; i < NUMBER_OF_VARIABLES; i++) {
+      values[i].symbol = intern_identifier(names[i], strlen(names[i]));
+      symbol_table_put_value(symtab, &values[i]);
+   }
+   declare_ms = timer_elapsed_ms(start);
+
+   start = timer_now();
+   for (i = 0; i < NUMBER_OF_VARIABLES * REFERENCES_PER_VARIABLE; i++) {
+      const char *lexeme = names[references[i]];
+      int symbol = intern_identifier(lexeme, strlen(lexeme));
+      struct vm_value *vmval = symbol_table_get_value(symtab, symbol);
+      checksum += vmval->type_specifier;
+   }
+   reference_ms = timer_elapsed_ms(start);
+
+   printf("interned+flat  declare %9.1f ms   reference %9.1f ms   (%ld)\n",
+          declare_ms, reference_ms, checksum);
+   symbol_table_destroy(symtab);
+}
+
+int
+main(void)
+{
+   struct vm_value *values;
+   int i;
+
+   generate();
+
+   values = calloc(NUMBER_OF_VARIABLES, sizeof(struct vm_value));
+   if (values == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+   for (i = 0; i < NUMBER_OF_VARIABLES; i++)
+      values[i].type_specifier = 1;
+
+   printf("%d variables, %d references each\n",
+          NUMBER_OF_VARIABLES, REFERENCES_PER_VARIABLE);
+   bench_ghashtable(values);
+   bench_interned(values);
+
+   return 0;
+}
@@ -0,0 +1,768 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "bytecode.h"
+#include "intern.h"
+#include "tier.h"
+
+#define BC_MAX_REGISTERS   UINT16_MAX
+
+#define BINDING_NONE       0
+#define BINDING_REGISTER   1
+#define BINDING_ARRAY      2     /* a register pointing to the array */
+#define BINDING_FUNCTION   3
+
+#define BC_NO_LOOP         UINT32_MAX
+
+struct bc_binding {
+   int kind;
+   uint32_t index;         /* register or function */
+   uint32_t function;      /* the variable belongs to */
+};
+
+/*
+ * Bindings follow the block scoping of codegen. Those of main's top
+ * level stay for good, which is what lets a program be compiled one
+ * top-level statement at a time.
+ */
+struct bc_compiler {
+   struct bc_binding *bindings;     /* indexed by symbol */
+   int bindings_capacity;
+
+   struct {
+      int symbol;
+      struct bc_binding shadowed;
+   } *undo_log;
+   int undo_log_size;
+   int undo_log_capacity;
+   int depth;
+
+   uint32_t function;         /* being compiled, 0 for main */
+   uint32_t next_register;    /* the first free one */
+   uint32_t max_registers;    /* of the function being compiled, so far */
+
+   /* for tiering, see new_loop() */
+   int tiering;
+   uint32_t loop_depth;
+   struct tier_symbols symbols;
+
+   /* nodes are only read, so pointers into the tree stay valid */
+   struct ast *ast;
+};
+
+static void compile_statement(struct bytecode *, ast_ref);
+
+static void *
+xrealloc(void *ptr, size_t size)
+{
+   ptr = realloc(ptr, size);
+   if (ptr == NULL) {
+      fprintf(stderr, "Memory reallocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   return ptr;
+}
+
+static uint32_t
+emit(struct bytecode *bytecode, int opcode, uint32_t a, uint32_t b,
+     uint32_t c, int32_t k)
+{
+   struct bc_instruction *instruction;
+
+   if (bytecode->number_of_instructions == bytecode->code_capacity) {
+      bytecode->code_capacity = bytecode->code_capacity ?
+                                2 * bytecode->code_capacity : 1024;
+      bytecode->code = xrealloc(bytecode->code, bytecode->code_capacity *
+                                sizeof(struct bc_instruction));
+   }
+
+   instruction = &bytecode->code[bytecode->number_of_instructions];
+   instruction->opcode = opcode;
+   instruction->a = a;
+   instruction->b = b;
+   instruction->c = c;
+   instruction->k = k;
+
+   return bytecode->number_of_instructions++;
+}
+
+/* points the jump at 'instruction' to the next instruction emitted */
+static void
+patch_jump(struct bytecode *bytecode, uint32_t instruction)
+{
+   bytecode->code[instruction].k = bytecode->number_of_instructions;
+}
+
+static uint32_t
+new_function(struct bytecode *bytecode)
+{
+   if (bytecode->number_of_functions == bytecode->functions_capacity) {
+      bytecode->functions_capacity = bytecode->functions_capacity ?
+                                     2 * bytecode->functions_capacity : 16;
+      bytecode->functions = xrealloc(bytecode->functions,
+                                     bytecode->functions_capacity *
+                                     sizeof(struct bc_function));
+   }
+
+   memset(&bytecode->functions[bytecode->number_of_functions], 0,
+          sizeof(struct bc_function));
+   return bytecode->number_of_functions++;
+}
+
+static uint32_t
+new_register(struct bc_compiler *compiler)
+{
+   if (compiler->next_register >= BC_MAX_REGISTERS) {
+      fprintf(stderr, "bytecode: more than %d registers in a function\n",
+                      BC_MAX_REGISTERS);
+      exit(EXIT_FAILURE);
+   }
+
+   if (compiler->next_register + 1 > compiler->max_registers)
+      compiler->max_registers = compiler->next_register + 1;
+
+   return compiler->next_register++;
+}
+
+static void
+bind_symbol(struct bc_compiler *compiler, int symbol, int kind,
+            uint32_t index)
+{
+   int capacity;
+
+   if (symbol >= compiler->bindings_capacity) {
+      capacity = compiler->bindings_capacity ? compiler->bindings_capacity
+                                             : 256;
+      while (capacity <= symbol)
+         capacity *= 2;
+
+      compiler->bindings = xrealloc(compiler->bindings,
+                                    capacity * sizeof(struct bc_binding));
+      memset(compiler->bindings + compiler->bindings_capacity, 0,
+             (capacity - compiler->bindings_capacity) *
+             sizeof(struct bc_binding));
+      compiler->bindings_capacity = capacity;
+   }
+
+   if (compiler->depth > 0) {
+      if (compiler->undo_log_size == compiler->undo_log_capacity) {
+         compiler->undo_log_capacity = compiler->undo_log_capacity ?
+                                       2 * compiler->undo_log_capacity : 64;
+         compiler->undo_log = xrealloc(compiler->undo_log,
+                                       compiler->undo_log_capacity *
+                                       sizeof(*compiler->undo_log));
+      }
+
+      compiler->undo_log[compiler->undo_log_size].symbol = symbol;
+      compiler->undo_log[compiler->undo_log_size].shadowed =
+         compiler->bindings[symbol];
+      compiler->undo_log_size++;
+   }
+
+   compiler->bindings[symbol].kind = kind;
+   compiler->bindings[symbol].index = index;
+   compiler->bindings[symbol].function = compiler->function;
+}
+
+/* the type checker has seen to it that the symbol is bound */
+static uint32_t
+get_binding(struct bc_compiler *compiler, int symbol)
+{
+   return compiler->bindings[symbol].index;
+}
+
+/* undoes the bindings made since the undo log was 'mark' long */
+static void
+exit_scope(struct bc_compiler *compiler, int mark)
+{
+   while (compiler->undo_log_size > mark) {
+      int i = --compiler->undo_log_size;
+
+      compiler->bindings[compiler->undo_log[i].symbol] =
+         compiler->undo_log[i].shadowed;
+   }
+}
+
+/* indexed by AST operator, then the type of the operands */
+static const uint16_t math_opcodes[AST_DIV + 1][TYPE_FLOAT + 1] = {
+   [AST_ADD] = { [TYPE_INT] = BC_ADD_INT, [TYPE_FLOAT] = BC_ADD_FLOAT },
+   [AST_SUB] = { [TYPE_INT] = BC_SUB_INT, [TYPE_FLOAT] = BC_SUB_FLOAT },
+   [AST_MUL] = { [TYPE_INT] = BC_MUL_INT, [TYPE_FLOAT] = BC_MUL_FLOAT },
+   [AST_DIV] = { [TYPE_INT] = BC_DIV_INT, [TYPE_FLOAT] = BC_DIV_FLOAT },
+};
+
+static const uint16_t comparison_opcodes[AST_GE + 1][TYPE_FLOAT + 1] = {
+   [AST_GT] = { [TYPE_INT] = BC_GT_INT, [TYPE_FLOAT] = BC_GT_FLOAT },
+   [AST_LT] = { [TYPE_INT] = BC_LT_INT, [TYPE_FLOAT] = BC_LT_FLOAT },
+   [AST_EQ] = { [TYPE_INT] = BC_EQ_INT, [TYPE_FLOAT] = BC_EQ_FLOAT },
+   [AST_NE] = { [TYPE_INT] = BC_NE_INT, [TYPE_FLOAT] = BC_NE_FLOAT },
+   [AST_LE] = { [TYPE_INT] = BC_LE_INT, [TYPE_FLOAT] = BC_LE_FLOAT },
+   [AST_GE] = { [TYPE_INT] = BC_GE_INT, [TYPE_FLOAT] = BC_GE_FLOAT },
+};
+
+static uint32_t compile_expression(struct bytecode *, ast_index, int);
+
+/*
+ * Where an expression leaves its value 'reg', with the temporaries from
+ * 'mark' up free again: 'dest' if one was asked for, a variable as it
+ * is, a temporary moved down to 'mark'.
+ */
+static uint32_t
+result_in(struct bytecode *bytecode, uint32_t reg, int dest, uint32_t mark)
+{
+   struct bc_compiler *compiler = bytecode->compiler;
+   uint32_t result;
+
+   compiler->next_register = mark;
+   if (dest < 0 && reg < mark)
+      return reg;
+
+   result = dest >= 0 ? (uint32_t) dest : new_register(compiler);
+   if (result != reg)
+      emit(bytecode, BC_MOVE, result, reg, 0, 0);
+
+   return result;
+}
+
+/* the arguments go to the top of the frame, where the callee's starts */
+static uint32_t
+compile_call(struct bytecode *bytecode, struct ast_expression *call,
+             int dest)
+{
+   struct bc_compiler *compiler = bytecode->compiler;
+   struct ast_expression *argument, *value;
+   uint32_t mark = compiler->next_register, reg, result;
+   ast_index next;
+
+   for (next = call->subexpr[0]; next != AST_NONE;
+        next = argument->subexpr[1]) {
+      argument = ast_expression(compiler->ast, next);
+      value = ast_expression(compiler->ast, argument->subexpr[0]);
+
+      reg = new_register(compiler);
+      if (value->operator == AST_IDENTIFIER)
+         emit(bytecode, BC_MOVE, reg,
+              get_binding(compiler, value->primary_expr.symbol), 0, 0);
+      else
+         compile_expression(bytecode, argument->subexpr[0], reg);
+      compiler->next_register = reg + 1;
+   }
+
+   compiler->next_register = mark;
+   result = dest >= 0 ? (uint32_t) dest : new_register(compiler);
+   emit(bytecode, BC_CALL, result, mark, 0,
+        get_binding(compiler, call->primary_expr.symbol));
+
+   return result;
+}
+
+/*
+ * Returns the register holding the value of 'index': 'dest' unless that
+ * is -1, when a variable is used in place and anything else goes to the
+ * first free register. Reading a variable in place is safe because only
+ * a statement assigns: no operand changes while the other is evaluated.
+ */
+static uint32_t
+compile_expression(struct bytecode *bytecode, ast_index index, int dest)
+{
+   struct bc_compiler *compiler = bytecode->compiler;
+   struct ast *ast = compiler->ast;
+   struct ast_expression *expression = ast_expression(ast, index);
+   uint32_t mark = compiler->next_register, lhs, rhs, reg, array;
+   int from;
+
+   switch (expression->operator) {
+      case AST_INT_CONSTANT:
+      case AST_FLOAT_CONSTANT:
+         reg = dest >= 0 ? (uint32_t) dest : new_register(compiler);
+         /* the bits of either */
+         emit(bytecode, BC_LOAD_CONSTANT, reg, 0, 0,
+              expression->primary_expr.int_constant);
+         return reg;
+
+      case AST_IDENTIFIER:
+         reg = get_binding(compiler, expression->primary_expr.symbol);
+         return result_in(bytecode, reg, dest, mark);
+
+      case AST_INDEX:
+         array = get_binding(compiler, expression->primary_expr.symbol);
+         lhs = compile_expression(bytecode, expression->subexpr[0], -1);
+         compiler->next_register = mark;
+         reg = dest >= 0 ? (uint32_t) dest : new_register(compiler);
+         emit(bytecode, BC_LOAD_ELEMENT, reg, array, lhs, 0);
+         return reg;
+
+      /* the value of an assignment is the value assigned */
+      case AST_ASSIGN:
+         reg = get_binding(compiler, expression->primary_expr.symbol);
+         compile_expression(bytecode, expression->subexpr[0], reg);
+         return result_in(bytecode, reg, dest, mark);
+
+      /* the index goes first, like the address in C */
+      case AST_ASSIGN_INDEX:
+         array = get_binding(compiler, expression->primary_expr.symbol);
+         rhs = compile_expression(bytecode, expression->subexpr[1], -1);
+         reg = compile_expression(bytecode, expression->subexpr[0], -1);
+         emit(bytecode, BC_STORE_ELEMENT, reg, array, rhs, 0);
+         return result_in(bytecode, reg, dest, mark);
+
+      case AST_CALL:
+         return compile_call(bytecode, expression, dest);
+
+      /* a comparison is 1 or 0 already, as an int */
+      case AST_CONVERT:
+         from = ast_expression(ast, expression->subexpr[0])->type;
+         if (from == TYPE_BOOL && expression->type == TYPE_INT)
+            return compile_expression(bytecode, expression->subexpr[0],
+                                      dest);
+
+         lhs = compile_expression(bytecode, expression->subexpr[0], -1);
+         compiler->next_register = mark;
+         reg = dest >= 0 ? (uint32_t) dest : new_register(compiler);
+         emit(bytecode, expression->type == TYPE_FLOAT ? BC_INT_TO_FLOAT
+                                                       : BC_FLOAT_TO_INT,
+              reg, lhs, 0, 0);
+         return reg;
+
+      case AST_ADD: case AST_SUB:
+      case AST_MUL: case AST_DIV:
+      case AST_GT: case AST_LT:
+      case AST_EQ: case AST_NE:
+      case AST_LE: case AST_GE:
+         lhs = compile_expression(bytecode, expression->subexpr[0], -1);
+         rhs = compile_expression(bytecode, expression->subexpr[1], -1);
+         from = ast_expression(ast, expression->subexpr[0])->type;
+
+         compiler->next_register = mark;
+         reg = dest >= 0 ? (uint32_t) dest : new_register(compiler);
+         emit(bytecode,
+              expression->operator <= AST_DIV ?
+              math_opcodes[expression->operator][from] :
+              comparison_opcodes[expression->operator][from],
+              reg, lhs, rhs, 0);
+         return reg;
+
+      default:
+         fprintf(stderr, "Request to compile unknown expression operator: "
+                         "%d\n", expression->operator);
+         exit(EXIT_FAILURE);
+   }
+}
+
+/*
+ * A condition is always a comparison, see typecheck.h: it becomes one
+ * instruction jumping when it does not hold, to be patched.
+ */
+static uint32_t
+compile_condition(struct bytecode *bytecode, ast_index index)
+{
+   struct bc_compiler *compiler = bytecode->compiler;
+   struct ast_expression *condition = ast_expression(compiler->ast, index);
+   uint32_t mark = compiler->next_register, lhs, rhs;
+   int from;
+
+   lhs = compile_expression(bytecode, condition->subexpr[0], -1);
+   rhs = compile_expression(bytecode, condition->subexpr[1], -1);
+   from = ast_expression(compiler->ast, condition->subexpr[0])->type;
+   compiler->next_register = mark;
+
+   return emit(bytecode,
+               comparison_opcodes[condition->operator][from] +
+               BC_UNLESS_GT_INT - BC_GT_INT, 0, lhs, rhs, 0);
+}
+
+/* whether the list declares an array, to be freed with the block */
+static int
+declares_array(struct ast *ast, struct ast_statement_list *statement_list)
+{
+   ast_ref statement;
+   uint32_t i;
+
+   for (i = 0; i < statement_list->number_of_statements; i++) {
+      statement = ast->statements[statement_list->first + i];
+      if (AST_REF_TAG(statement) == AST_DECLARATION &&
+          ast->declarations[AST_REF_INDEX(statement)].size != AST_NONE)
+         return 1;
+   }
+
+   return 0;
+}
+
+static void
+compile_compound_statement(struct bytecode *bytecode, ast_index index)
+{
+   struct bc_compiler *compiler = bytecode->compiler;
+   struct ast_statement_list *statement_list;
+   uint32_t registers = compiler->next_register, saved = 0, i;
+   int mark = compiler->undo_log_size, arrays;
+
+   statement_list = &compiler->ast->compound_statements[index].statement_list;
+   arrays = declares_array(compiler->ast, statement_list);
+   if (arrays) {
+      saved = new_register(compiler);
+      emit(bytecode, BC_SAVE_ARRAYS, saved, 0, 0, 0);
+   }
+
+   compiler->depth++;
+   for (i = 0; i < statement_list->number_of_statements; i++)
+      compile_statement(bytecode,
+                        compiler->ast->statements[statement_list->first + i]);
+   compiler->depth--;
+
+   if (arrays)
+      emit(bytecode, BC_RESTORE_ARRAYS, saved, 0, 0, 0);
+
+   exit_scope(compiler, mark);
+   compiler->next_register = registers;
+}
+
+static void
+compile_declaration(struct bytecode *bytecode,
+                    struct ast_declaration *declaration)
+{
+   struct bc_compiler *compiler = bytecode->compiler;
+   struct ast_expression *size;
+   uint32_t mark = compiler->next_register, length, reg;
+
+   if (declaration->size == AST_NONE) {
+      bind_symbol(compiler, declaration->symbol, BINDING_REGISTER,
+                  new_register(compiler));
+      return;
+   }
+
+   size = ast_expression(compiler->ast, declaration->size);
+   if (size->operator == AST_INT_CONSTANT &&
+       size->primary_expr.int_constant < 0) {
+      fprintf(stderr, "%s: negative array size\n",
+                      intern_get_name(declaration->symbol));
+      exit(EXIT_FAILURE);
+   }
+
+   /* the size is evaluated before the array is in scope */
+   length = compile_expression(bytecode, declaration->size, -1);
+   compiler->next_register = mark;
+   reg = new_register(compiler);
+   emit(bytecode, BC_NEW_ARRAY, reg, length, 0, 0);
+   bind_symbol(compiler, declaration->symbol, BINDING_ARRAY, reg);
+}
+
+/*
+ * The function gets its own registers, parameters first, and is bound
+ * before its body, which may call it.
+ */
+static void
+compile_function_definition(struct bytecode *bytecode,
+                            struct ast_function_definition *definition)
+{
+   struct bc_compiler *compiler = bytecode->compiler;
+   struct ast_declaration *parameters;
+   uint32_t skip, function, saved_function, saved_next, saved_max, i, zero;
+   int mark;
+
+   skip = emit(bytecode, BC_JUMP, 0, 0, 0, 0);
+   function = new_function(bytecode);
+   bytecode->functions[function].entry = bytecode->number_of_instructions;
+   bind_symbol(compiler, definition->symbol, BINDING_FUNCTION, function);
+
+   saved_function = compiler->function;
+   saved_next = compiler->next_register;
+   saved_max = compiler->max_registers;
+   compiler->function = function;
+   compiler->next_register = 0;
+   compiler->max_registers = 0;
+
+   mark = compiler->undo_log_size;
+   compiler->depth++;
+   parameters = &compiler->ast->declarations[definition->first_parameter];
+   for (i = 0; i < definition->number_of_parameters; i++)
+      bind_symbol(compiler, parameters[i].symbol,
+                  parameters[i].size == AST_UNSIZED ? BINDING_ARRAY
+                                                    : BINDING_REGISTER,
+                  new_register(compiler));
+   compile_compound_statement(bytecode, definition->body);
+   compiler->depth--;
+   exit_scope(compiler, mark);
+
+   /* running off the end returns zero */
+   zero = new_register(compiler);
+   emit(bytecode, BC_LOAD_CONSTANT, zero, 0, 0, 0);
+   emit(bytecode, BC_RETURN, zero, 0, 0, 0);
+
+   bytecode->functions[function].number_of_registers =
+      compiler->max_registers;
+   compiler->function = saved_function;
+   compiler->next_register = saved_next;
+   compiler->max_registers = saved_max;
+
+   patch_jump(bytecode, skip);
+}
+
+static void
+add_loop_variable(struct bytecode *bytecode, uint32_t reg, int array)
+{
+   struct bc_loop_variable *variable;
+
+   if (bytecode->number_of_loop_variables ==
+       bytecode->loop_variables_capacity) {
+      bytecode->loop_variables_capacity =
+         bytecode->loop_variables_capacity ?
+         2 * bytecode->loop_variables_capacity : 64;
+      bytecode->loop_variables = xrealloc(bytecode->loop_variables,
+                                          bytecode->loop_variables_capacity *
+                                          sizeof(struct bc_loop_variable));
+   }
+
+   variable = &bytecode->loop_variables[bytecode->number_of_loop_variables++];
+   variable->reg = reg;
+   variable->array = array;
+}
+
+/*
+ * Numbers a loop that --tiered may move to native code, listing the
+ * variables of the function it refers to; codegen does the same, see
+ * tier.h. Returns BC_NO_LOOP for any other loop.
+ */
+static uint32_t
+new_loop(struct bytecode *bytecode, struct ast_while_statement *loop)
+{
+   struct bc_compiler *compiler = bytecode->compiler;
+   struct tier_symbols *symbols = &compiler->symbols;
+   struct bc_binding *binding;
+   struct bc_loop *bc_loop;
+   uint32_t i;
+
+   if (!compiler->tiering || compiler->loop_depth >= TIER_MAX_LOOP_DEPTH ||
+       !tier_loop_symbols(symbols, compiler->ast, loop))
+      return BC_NO_LOOP;
+
+   if (bytecode->number_of_loops == bytecode->loops_capacity) {
+      bytecode->loops_capacity = bytecode->loops_capacity ?
+                                 2 * bytecode->loops_capacity : 16;
+      bytecode->loops = xrealloc(bytecode->loops, bytecode->loops_capacity *
+                                 sizeof(struct bc_loop));
+   }
+
+   bc_loop = &bytecode->loops[bytecode->number_of_loops];
+   bc_loop->exit = 0;
+   bc_loop->first_variable = bytecode->number_of_loop_variables;
+   bc_loop->number_of_slots = 0;
+
+   for (i = 0; i < symbols->number_of_symbols; i++) {
+      if (symbols->symbols[i] >= compiler->bindings_capacity)
+         continue;
+
+      binding = &compiler->bindings[symbols->symbols[i]];
+      if ((binding->kind != BINDING_REGISTER &&
+           binding->kind != BINDING_ARRAY) ||
+          binding->function != compiler->function)
+         continue;
+
+      add_loop_variable(bytecode, binding->index,
+                        binding->kind == BINDING_ARRAY);
+      bc_loop->number_of_slots += binding->kind == BINDING_ARRAY ? 2 : 1;
+   }
+
+   bc_loop->number_of_variables = bytecode->number_of_loop_variables -
+                                  bc_loop->first_variable;
+   if (bc_loop->number_of_slots > bytecode->max_loop_slots)
+      bytecode->max_loop_slots = bc_loop->number_of_slots;
+
+   return bytecode->number_of_loops++;
+}
+
+/*
+ * The bounds are evaluated once, into registers of their own, and the
+ * index is set from a count of its own at the top of every iteration,
+ * as codegen does. A parallel for runs as any other: the type checker
+ * has made sure the order of its iterations does not matter.
+ */
+static void
+compile_for_statement(struct bytecode *bytecode,
+                      struct ast_for_statement *for_statement)
+{
+   struct bc_compiler *compiler = bytecode->compiler;
+   uint32_t registers = compiler->next_register, count, upper, one, index;
+   uint32_t top, condition;
+   int mark = compiler->undo_log_size;
+
+   count = new_register(compiler);
+   compile_expression(bytecode, for_statement->lower, count);
+   upper = new_register(compiler);
+   compile_expression(bytecode, for_statement->upper, upper);
+   one = new_register(compiler);
+   emit(bytecode, BC_LOAD_CONSTANT, one, 0, 0, 1);
+
+   compiler->depth++;
+   index = new_register(compiler);
+   bind_symbol(compiler,
+               compiler->ast->declarations[for_statement->index].symbol,
+               BINDING_REGISTER, index);
+
+   top = bytecode->number_of_instructions;
+   condition = emit(bytecode, BC_UNLESS_LT_INT, 0, count, upper, 0);
+   emit(bytecode, BC_MOVE, index, count, 0, 0);
+   compile_compound_statement(bytecode, for_statement->body);
+   emit(bytecode, BC_ADD_INT, count, count, one, 0);
+   emit(bytecode, BC_JUMP, 0, 0, 0, top);
+   patch_jump(bytecode, condition);
+   compiler->depth--;
+
+   exit_scope(compiler, mark);
+   compiler->next_register = registers;
+}
+
+static void
+compile_statement(struct bytecode *bytecode, ast_ref statement)
+{
+   struct bc_compiler *compiler = bytecode->compiler;
+   struct ast *ast = compiler->ast;
+   ast_index index = AST_REF_INDEX(statement);
+   struct ast_selection_statement *selection_statement;
+   uint32_t mark = compiler->next_register, condition, skip, top, loop;
+
+   switch (AST_REF_TAG(statement)) {
+      case AST_DECLARATION:
+         compile_declaration(bytecode, &ast->declarations[index]);
+         return;
+
+      case AST_EXPRESSION:
+         compile_expression(bytecode, index, -1);
+         compiler->next_register = mark;
+         return;
+
+      case AST_COMPOUND_STATEMENT:
+         compile_compound_statement(bytecode, index);
+         return;
+
+      case AST_SELECTION_STATEMENT:
+         selection_statement = &ast->selection_statements[index];
+         condition = compile_condition(bytecode,
+                                       selection_statement->condition);
+         compile_compound_statement(bytecode, selection_statement->then_body);
+         if (selection_statement->else_body != AST_NONE) {
+            skip = emit(bytecode, BC_JUMP, 0, 0, 0, 0);
+            patch_jump(bytecode, condition);
+            compile_compound_statement(bytecode,
+                                       selection_statement->else_body);
+            patch_jump(bytecode, skip);
+         } else {
+            patch_jump(bytecode, condition);
+         }
+         return;
+
+      case AST_WHILE_STATEMENT:
+         loop = new_loop(bytecode, &ast->while_statements[index]);
+         top = bytecode->number_of_instructions;
+         condition = compile_condition(bytecode,
+                                       ast->while_statements[index].condition);
+         compiler->loop_depth++;
+         compile_compound_statement(bytecode,
+                                    ast->while_statements[index].body);
+         compiler->loop_depth--;
+         if (loop == BC_NO_LOOP)
+            emit(bytecode, BC_JUMP, 0, 0, 0, top);
+         else
+            emit(bytecode, BC_LOOP, loop & 0xffff, loop >> 16, 0, top);
+         patch_jump(bytecode, condition);
+         if (loop != BC_NO_LOOP)
+            bytecode->loops[loop].exit = bytecode->number_of_instructions;
+         return;
+
+      case AST_FOR_STATEMENT:
+         compile_for_statement(bytecode, &ast->for_statements[index]);
+         return;
+
+      case AST_FUNCTION_DEFINITION:
+         compile_function_definition(bytecode,
+                                     &ast->function_definitions[index]);
+         return;
+
+      case AST_RETURN_STATEMENT:
+         emit(bytecode, BC_RETURN, compile_expression(bytecode, index, -1),
+              0, 0, 0);
+         compiler->next_register = mark;
+         return;
+
+      default:
+         fprintf(stderr, "Request to compile unknown statement: %d\n",
+                         AST_REF_TAG(statement));
+         exit(EXIT_FAILURE);
+   }
+}
+
+static void
+compiler_destroy(struct bc_compiler *compiler)
+{
+   free(compiler->bindings);
+   free(compiler->undo_log);
+   tier_symbols_destroy(&compiler->symbols);
+   free(compiler);
+}
+
+struct bytecode *
+bytecode_create(struct ast *ast, int tiering)
+{
+   struct bytecode *bytecode;
+
+   bytecode = calloc(1, sizeof(struct bytecode));
+   if (bytecode != NULL)
+      bytecode->compiler = calloc(1, sizeof(struct bc_compiler));
+   if (bytecode == NULL || bytecode->compiler == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   bytecode->compiler->ast = ast;
+   bytecode->compiler->tiering = tiering;
+   new_function(bytecode);
+
+   return bytecode;
+}
+
+void
+bytecode_destroy(struct bytecode *bytecode)
+{
+   if (bytecode->compiler != NULL)
+      compiler_destroy(bytecode->compiler);
+
+   free(bytecode->code);
+   free(bytecode->functions);
+   free(bytecode->loops);
+   free(bytecode->loop_variables);
+   free(bytecode);
+}
+
+void
+bytecode_compile_statement(struct bytecode *bytecode, ast_ref statement)
+{
+   compile_statement(bytecode, statement);
+}
+
+void
+bytecode_compile_translation_unit(struct bytecode *bytecode)
+{
+   struct ast *ast = bytecode->compiler->ast;
+   struct ast_statement_list *statement_list;
+   uint32_t i;
+
+   statement_list = &ast->translation_unit.statement_list;
+   for (i = 0; i < statement_list->number_of_statements; i++)
+      compile_statement(bytecode,
+                        ast->statements[statement_list->first + i]);
+}
+
+void
+bytecode_finish(struct bytecode *bytecode)
+{
+   emit(bytecode, BC_HALT, 0, 0, 0, 0);
+   bytecode->functions[0].number_of_registers =
+      bytecode->compiler->max_registers;
+
+   /* the tree may be gone by now; so goes what referred to it */
+   compiler_destroy(bytecode->compiler);
+   bytecode->compiler = NULL;
+}
@@ -0,0 +1,162 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <stdint.h>
+
+#include "ast.h"
+
+/*
+ * Register bytecode, the back end of --interp: a program that runs once
+ * and is done is better off skipping LLVM altogether. Every declared
+ * variable gets a register of its own and temporaries are allocated
+ * above them, stack-wise, as in Lua; operands name registers, so
+ * 'a = b + c' is a single instruction. Instructions are typed, as the
+ * type checker left the tree, and the condition of an if or while is
+ * one fused compare-and-branch. See interp.h for running it.
+ *
+ * Functions are compiled where they are defined, in the middle of main,
+ * which jumps over them: the code of the whole program is one array, so
+ * a jump or call target is just an instruction index.
+ */
+
+/* a = b, a = k (the bits of an int or float) */
+#define BC_MOVE            0
+#define BC_LOAD_CONSTANT   1
+
+/* a = b op c */
+#define BC_ADD_INT         2
+#define BC_SUB_INT         3
+#define BC_MUL_INT         4
+#define BC_DIV_INT         5
+#define BC_ADD_FLOAT       6
+#define BC_SUB_FLOAT       7
+#define BC_MUL_FLOAT       8
+#define BC_DIV_FLOAT       9
+
+/* a = b op c, 1 or 0 */
+#define BC_GT_INT          10
+#define BC_LT_INT          11
+#define BC_EQ_INT          12
+#define BC_NE_INT          13
+#define BC_LE_INT          14
+#define BC_GE_INT          15
+#define BC_GT_FLOAT        16
+#define BC_LT_FLOAT        17
+#define BC_EQ_FLOAT        18
+#define BC_NE_FLOAT        19
+#define BC_LE_FLOAT        20
+#define BC_GE_FLOAT        21
+
+/* goto k unless b op c, in the order of the comparisons above */
+#define BC_UNLESS_GT_INT   22
+#define BC_UNLESS_LT_INT   23
+#define BC_UNLESS_EQ_INT   24
+#define BC_UNLESS_NE_INT   25
+#define BC_UNLESS_LE_INT   26
+#define BC_UNLESS_GE_INT   27
+#define BC_UNLESS_GT_FLOAT 28
+#define BC_UNLESS_LT_FLOAT 29
+#define BC_UNLESS_EQ_FLOAT 30
+#define BC_UNLESS_NE_FLOAT 31
+#define BC_UNLESS_LE_FLOAT 32
+#define BC_UNLESS_GE_FLOAT 33
+
+/* a = (float) b, a = (int) b; a comparison already is an int */
+#define BC_INT_TO_FLOAT    34
+#define BC_FLOAT_TO_INT    35
+
+/* goto k */
+#define BC_JUMP            36
+
+/*
+ * a = new zeroed array of b elements; a = b[c]; b[c] = a. Indexes are
+ * always checked: next to the dispatch, the check costs nothing.
+ */
+#define BC_NEW_ARRAY       37
+#define BC_LOAD_ELEMENT    38
+#define BC_STORE_ELEMENT   39
+
+/* a = the arrays allocated so far; arrays allocated since a are freed */
+#define BC_SAVE_ARRAYS     40
+#define BC_RESTORE_ARRAYS  41
+
+/*
+ * a = function k (b, b + 1, ...): the arguments are the registers at
+ * the top of the caller's frame, and become the callee's first ones.
+ * A function returns a, main halts.
+ */
+#define BC_CALL            42
+#define BC_RETURN          43
+#define BC_HALT            44
+
+/* goto k, the back edge of loop a | b << 16, which may go native */
+#define BC_LOOP            45
+
+#define BC_NUMBER_OF_OPCODES  46
+
+struct bc_instruction {
+   uint16_t opcode;
+   uint16_t a, b, c;       /* registers */
+   int32_t k;              /* constant, jump target or function */
+};
+
+struct bc_function {
+   uint32_t entry;                  /* instruction index */
+   uint32_t number_of_registers;    /* parameters first */
+};
+
+/*
+ * A loop that --tiered may move to native code, see tier.h: its
+ * variables go to the state in order, and it resumes at 'exit'.
+ */
+struct bc_loop {
+   uint32_t exit;                   /* instruction index */
+   uint32_t first_variable;         /* range of loop_variables */
+   uint32_t number_of_variables;
+   uint32_t number_of_slots;
+};
+
+struct bc_loop_variable {
+   uint16_t reg;
+   uint16_t array;                  /* whether it takes two slots */
+};
+
+/* main is function 0; it starts at instruction 0 */
+struct bytecode {
+   struct bc_instruction *code;
+   uint32_t number_of_instructions;
+   uint32_t code_capacity;
+
+   struct bc_function *functions;
+   uint32_t number_of_functions;
+   uint32_t functions_capacity;
+
+   /* none unless compiled for tiering */
+   struct bc_loop *loops;
+   uint32_t number_of_loops;
+   uint32_t loops_capacity;
+   struct bc_loop_variable *loop_variables;
+   uint32_t number_of_loop_variables;
+   uint32_t loop_variables_capacity;
+   uint32_t max_loop_slots;
+
+   /* the compiler's, see bytecode.c */
+   struct bc_compiler *compiler;
+};
+
+/*
+ * Compiles from the type checked and simplified 'ast'; with 'tiering',
+ * the loops that may go native count their back edges.
+ */
+struct bytecode *bytecode_create(struct ast *ast, int tiering);
+void bytecode_destroy(struct bytecode *bytecode);
+
+/* appends a top-level statement to main */
+void bytecode_compile_statement(struct bytecode *bytecode, ast_ref statement);
+
+void bytecode_compile_translation_unit(struct bytecode *bytecode);
+
+/* ends main, after which the program can run */
+void bytecode_finish(struct bytecode *bytecode);
+
+#endif /* BYTECODE_H */
@@ -0,0 +1,408 @@
+#include <dirent.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include <llvm/Config/llvm-config.h>
+#include <llvm-c/TargetMachine.h>
+
+#include "cache.h"
+#include "timer.h"
+
+/*
+ * Bump TOY_CACHE_FORMAT with every change to the code the compiler
+ * generates, or to the entries themselves: every old entry then misses.
+ * The key does not depend on when the compiler was built, so rebuilding
+ * it keeps the cache and two builds of one source agree.
+ */
+#define TOY_CACHE_FORMAT         1
+
+#define CACHE_STRING(x)          CACHE_STRING_(x)
+#define CACHE_STRING_(x)         #x
+#define CACHE_COMPILER_VERSION   "toy format " CACHE_STRING(TOY_CACHE_FORMAT) \
+                                 ", llvm " LLVM_VERSION_STRING
+
+#define CACHE_MAGIC              "TOYC"
+#define CACHE_SUFFIX             ".toyc"
+#define CACHE_TEMPORARY          ".tmp."
+
+/* a temporary file this old was left by a writer that did not finish */
+#define CACHE_STALE_SECONDS      3600
+
+struct cache_header {
+   char magic[4];
+   uint32_t reserved;
+   double compile_ms;
+};
+
+struct cache_entry {
+   char *path;
+   off_t size;
+   time_t mtime;
+};
+
+typedef unsigned __int128 cache_hash;
+
+static cache_hash
+hash_bytes(cache_hash hash, const void *data, size_t size)
+{
+   /* FNV-1a, 128-bit variant: prime is 2^88 + 2^8 + 0x3b */
+   const cache_hash prime = ((cache_hash) 1 << 88) + (1 << 8) + 0x3b;
+   const unsigned char *bytes = data;
+   size_t i;
+
+   for (i = 0; i < size; i++) {
+      hash ^= bytes[i];
+      hash *= prime;
+   }
+
+   return hash;
+}
+
+/* strings are hashed with their terminator, so fields cannot run together */
+static cache_hash
+hash_string(cache_hash hash, const char *string)
+{
+   return hash_bytes(hash, string, strlen(string) + 1);
+}
+
+static void *
+xmalloc(size_t size)
+{
+   void *ptr = malloc(size);
+
+   if (ptr == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   return ptr;
+}
+
+static char *
+cache_path(struct cache *cache, const char *name)
+{
+   char *path;
+
+   path = xmalloc(strlen(cache->directory) + strlen(name) + 2);
+   sprintf(path, "%s/%s", cache->directory, name);
+
+   return path;
+}
+
+static cache_hash
+hash_host(void)
+{
+   /* FNV-1a 128-bit offset basis */
+   cache_hash hash = ((cache_hash) 0x6c62272e07bb0142ull << 64) |
+                     0x62b821756295c58dull;
+   char *triple, *cpu, *features;
+
+   triple = LLVMGetDefaultTargetTriple();
+   cpu = LLVMGetHostCPUName();
+   features = LLVMGetHostCPUFeatures();
+
+   hash = hash_string(hash, CACHE_COMPILER_VERSION);
+   hash = hash_string(hash, triple);
+   hash = hash_string(hash, cpu);
+   hash = hash_string(hash, features);
+
+   LLVMDisposeMessage(triple);
+   LLVMDisposeMessage(cpu);
+   LLVMDisposeMessage(features);
+
+   return hash;
+}
+
+struct cache *
+cache_create(const char *directory, size_t capacity)
+{
+   struct cache *cache;
+   cache_hash hash;
+
+   if (mkdir(directory, 0777) != 0 && errno != EEXIST) {
+      fprintf(stderr, "Unable to create cache directory %s: %s\n",
+                      directory, strerror(errno));
+      exit(EXIT_FAILURE);
+   }
+
+   cache = calloc(1, sizeof(struct cache));
+   if (cache == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   cache->directory = strdup(directory);
+   cache->capacity = capacity;
+   pthread_mutex_init(&cache->lock, NULL);
+
+   hash = hash_host();
+   cache->host_hash[0] = (uint64_t) (hash >> 64);
+   cache->host_hash[1] = (uint64_t) hash;
+
+   return cache;
+}
+
+static int
+compare_entries(const void *a, const void *b)
+{
+   const struct cache_entry *lhs = a, *rhs = b;
+
+   return (lhs->mtime > rhs->mtime) - (lhs->mtime < rhs->mtime);
+}
+
+/* removes 'name' if it is a temporary file left by an interrupted write */
+static void
+cache_remove_stale(struct cache *cache, const char *name, time_t now)
+{
+   struct stat st;
+   char *path;
+
+   path = cache_path(cache, name);
+   if (stat(path, &st) == 0 && now - st.st_mtime > CACHE_STALE_SECONDS)
+      unlink(path);
+   free(path);
+}
+
+/* returns the number of entries removed */
+static int
+cache_evict(struct cache *cache)
+{
+   struct cache_entry *entries;
+   int number_of_entries, entries_capacity, i, evicted;
+   struct dirent *dirent;
+   size_t length, total;
+   struct stat st;
+   time_t now;
+   DIR *dir;
+
+   dir = opendir(cache->directory);
+   if (dir == NULL)
+      return 0;
+
+   entries = NULL;
+   number_of_entries = entries_capacity = 0;
+   total = 0;
+   now = time(NULL);
+
+   while ((dirent = readdir(dir)) != NULL) {
+      /* a younger one may still be being written by another compile */
+      if (strncmp(dirent->d_name, CACHE_TEMPORARY,
+                  strlen(CACHE_TEMPORARY)) == 0) {
+         cache_remove_stale(cache, dirent->d_name, now);
+         continue;
+      }
+
+      length = strlen(dirent->d_name);
+      if (length < strlen(CACHE_SUFFIX) ||
+          strcmp(dirent->d_name + length - strlen(CACHE_SUFFIX),
+                 CACHE_SUFFIX) != 0)
+         continue;
+
+      if (number_of_entries == entries_capacity) {
+         entries_capacity = entries_capacity ? 2 * entries_capacity : 64;
+         entries = realloc(entries,
+                           entries_capacity * sizeof(struct cache_entry));
+         if (entries == NULL) {
+            fprintf(stderr, "Memory reallocation request failed.\n");
+            exit(EXIT_FAILURE);
+         }
+      }
+
+      entries[number_of_entries].path = cache_path(cache, dirent->d_name);
+      if (stat(entries[number_of_entries].path, &st) != 0) {
+         free(entries[number_of_entries].path);
+         continue;
+      }
+
+      entries[number_of_entries].size = st.st_size;
+      entries[number_of_entries].mtime = st.st_mtime;
+      total += st.st_size;
+      number_of_entries++;
+   }
+   closedir(dir);
+
+   /* oldest first; another process may be evicting at the same time */
+   qsort(entries, number_of_entries, sizeof(struct cache_entry),
+         compare_entries);
+
+   evicted = 0;
+   for (i = 0; i < number_of_entries && total > cache->capacity; i++) {
+      if (unlink(entries[i].path) == 0 || errno == ENOENT) {
+         total -= entries[i].size;
+         evicted++;
+      }
+   }
+
+   for (i = 0; i < number_of_entries; i++)
+      free(entries[i].path);
+   free(entries);
+
+   return evicted;
+}
+
+void
+cache_destroy(struct cache *cache)
+{
+   int evicted;
+
+   evicted = cache_evict(cache);
+
+   if (cache->report)
+      fprintf(stderr, "cache: %d hits, %d misses, %.3f ms saved, "
+                      "%d entries evicted\n", cache->hits, cache->misses,
+                      cache->saved_ms, evicted);
+
+   pthread_mutex_destroy(&cache->lock);
+   free(cache->directory);
+   free(cache);
+}
+
+void
+cache_compute_key(struct cache *cache, const char *configuration,
+                  const char *source, size_t size,
+                  char key[CACHE_KEY_LENGTH + 1])
+{
+   cache_hash hash;
+   int i;
+
+   hash = ((cache_hash) cache->host_hash[0] << 64) | cache->host_hash[1];
+   hash = hash_string(hash, configuration);
+   hash = hash_bytes(hash, source, size);
+
+   for (i = 0; i < CACHE_KEY_LENGTH; i++) {
+      key[i] = "0123456789abcdef"[(unsigned) (hash >> 124)];
+      hash <<= 4;
+   }
+   key[CACHE_KEY_LENGTH] = '\0';
+}
+
+static char *
+cache_entry_path(struct cache *cache, const char *key)
+{
+   char name[CACHE_KEY_LENGTH + sizeof(CACHE_SUFFIX)];
+
+   snprintf(name, sizeof(name), "%s%s", key, CACHE_SUFFIX);
+   return cache_path(cache, name);
+}
+
+static void
+cache_count(struct cache *cache, int hit, double saved_ms)
+{
+   pthread_mutex_lock(&cache->lock);
+   if (hit) {
+      cache->hits++;
+      cache->saved_ms += saved_ms;
+   } else {
+      cache->misses++;
+   }
+   pthread_mutex_unlock(&cache->lock);
+}
+
+LLVMMemoryBufferRef
+cache_lookup(struct cache *cache, const char *key)
+{
+   struct cache_header header;
+   LLVMMemoryBufferRef contents;
+   struct stat st;
+   char *path, *data;
+   double start;
+   FILE *file;
+   size_t size;
+
+   start = timer_now();
+   path = cache_entry_path(cache, key);
+
+   file = fopen(path, "rb");
+   if (file == NULL || fstat(fileno(file), &st) != 0 ||
+       (size_t) st.st_size < sizeof(header) ||
+       fread(&header, sizeof(header), 1, file) != 1 ||
+       memcmp(header.magic, CACHE_MAGIC, 4) != 0) {
+      if (file != NULL)
+         fclose(file);
+      free(path);
+      cache_count(cache, 0, 0.0);
+      return NULL;
+   }
+
+   size = st.st_size - sizeof(header);
+   data = xmalloc(size ? size : 1);
+   if (fread(data, 1, size, file) != size) {
+      fclose(file);
+      free(data);
+      free(path);
+      cache_count(cache, 0, 0.0);
+      return NULL;
+   }
+   fclose(file);
+
+   /* the modification time is what eviction goes by */
+   utime(path, NULL);
+   free(path);
+
+   contents = LLVMCreateMemoryBufferWithMemoryRangeCopy(data, size, key);
+   free(data);
+
+   cache_count(cache, 1, header.compile_ms - timer_elapsed_ms(start));
+   return contents;
+}
+
+void
+cache_store(struct cache *cache, const char *key,
+            LLVMMemoryBufferRef contents, double compile_ms)
+{
+   struct cache_header header;
+   char *temporary, *path;
+   size_t size;
+   FILE *file;
+   int fd, ok;
+
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, CACHE_MAGIC, 4);
+   header.compile_ms = compile_ms;
+
+   /* unique per writer, and without the suffix eviction looks for */
+   temporary = cache_path(cache, CACHE_TEMPORARY "XXXXXX");
+   fd = mkstemp(temporary);
+   if (fd < 0 || (file = fdopen(fd, "wb")) == NULL) {
+      fprintf(stderr, "cache: unable to create %s: %s\n",
+                      temporary, strerror(errno));
+      if (fd >= 0)
+         close(fd);
+      free(temporary);
+      return;
+   }
+
+   /* mkstemp() makes it private to us */
+   fchmod(fd, 0644);
+
+   size = LLVMGetBufferSize(contents);
+   ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(LLVMGetBufferStart(contents), 1, size, file) == size;
+   if (fclose(file) != 0)
+      ok = 0;
+
+   if (!ok) {
+      fprintf(stderr, "cache: unable to write %s\n", temporary);
+      unlink(temporary);
+      free(temporary);
+      return;
+   }
+
+   /* readers see either the old entry or the whole new one */
+   path = cache_entry_path(cache, key);
+   if (rename(temporary, path) != 0) {
+      fprintf(stderr, "cache: unable to rename %s: %s\n",
+                      temporary, strerror(errno));
+      unlink(temporary);
+   }
+
+   free(path);
+   free(temporary);
+}
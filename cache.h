@@ -0,0 +1,57 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <llvm-c/Core.h>
+
+#define CACHE_KEY_LENGTH   32    /* hex digits of a 128-bit hash */
+
+/*
+ * Content-addressed compilation cache. Entries live in one directory as
+ * "<key>.toyc", where the key hashes the source together with everything
+ * else that determines the output: the cache format and LLVM versions, the
+ * host triple, CPU and features, and a configuration string supplied by
+ * the caller (optimization level, output kind, ...).
+ *
+ * Entries are written to a temporary file and renamed into place, so
+ * concurrent compiles never see a partial entry. A hit refreshes the
+ * entry's modification time; when the cache is destroyed the least
+ * recently used entries are removed until the directory fits in
+ * 'capacity' bytes, along with temporary files that interrupted writes
+ * left behind. One cache may be shared by several threads.
+ */
+struct cache {
+   char *directory;
+   size_t capacity;
+
+   /* hash of the compiler and host, the starting point of every key */
+   uint64_t host_hash[2];
+
+   pthread_mutex_t lock;      /* guards the statistics below */
+   int hits;
+   int misses;
+   double saved_ms;           /* compile time of the hits, less lookups */
+
+   int report;                /* -ftime-report: print them on destroy */
+};
+
+struct cache *cache_create(const char *directory, size_t capacity);
+
+/* evicts down to the capacity, then prints the statistics if asked to */
+void cache_destroy(struct cache *cache);
+
+void cache_compute_key(struct cache *cache, const char *configuration,
+                       const char *source, size_t size,
+                       char key[CACHE_KEY_LENGTH + 1]);
+
+/* returns the entry's contents, or NULL on a miss */
+LLVMMemoryBufferRef cache_lookup(struct cache *cache, const char *key);
+
+/* 'compile_ms' is what a later hit on this entry saves */
+void cache_store(struct cache *cache, const char *key,
+                 LLVMMemoryBufferRef contents, double compile_ms);
+
+#endif /* CACHE_H */
@@ -1,21 +1,39 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <llvm-c/BitReader.h>
 
 #include "ast.h"
+#include "bytecode.h"
+#include "cache.h"
+#include "driver.h"
+#include "emit.h"
+#include "intern.h"
+#include "jit.h"
+#include "optimizer.h"
+#include "parallel.h"
+#include "profile.h"
+#include "repl.h"
+#include "simplify.h"
+#include "source.h"
+#include "ssa.h"
+#include "symtab.h"
+#include "tier.h"
+#include "timer.h"
+#include "typecheck.h"
 #include "vm_state.h"
 #include "vm_value.h"
 
 static void
 drive_declaration(struct vm_state *, struct ast_declaration *);
 
-static struct vm_value *
-drive_expression(struct vm_state *, struct ast_expression *);
 
 static void
 drive_statement_list(struct vm_state *, struct ast_statement_list *);
 
 static void
-drive_compound_statement(struct vm_state *, struct ast_compound_statement *);
+drive_compound_statement(struct vm_state *, ast_index);
 
 static void
 drive_selection_statement(struct vm_state *, struct ast_selection_statement *);
@@ -23,109 +41,539 @@ drive_selection_statement(struct vm_state *, struct ast_selection_statement *);
 static void
 drive_while_statement(struct vm_state *, struct ast_while_statement *);
 
+static void
+drive_for_statement(struct vm_state *, struct ast_for_statement *);
+
+static void
+drive_function_definition(struct vm_state *,
+                          struct ast_function_definition *);
+
+static void
+drive_return_statement(struct vm_state *, ast_index);
+
 static void
 drive_translation_unit(struct vm_state *, struct ast_translation_unit *);
 
 
+/*
+ * Branches go through these so that, in SSA mode, the predecessors of
+ * every block are known when it gets sealed.
+ */
 static void
-drive_node(struct vm_state *vm, struct ast_node *node)
+build_br(struct vm_state *vm, LLVMBasicBlockRef dest)
 {
-   switch (node->tag) {
-      case AST_NODE:
-         fprintf(stderr, "Request to drive generic ast node\n");
-         exit(EXIT_FAILURE);
+   if (vm->ssa != NULL)
+      ssa_add_predecessor(vm->ssa, dest, LLVMGetInsertBlock(vm->builder));
+
+   LLVMBuildBr(vm->builder, dest);
+}
+
+static void
+build_cond_br(struct vm_state *vm, LLVMValueRef condition,
+              LLVMBasicBlockRef then_block, LLVMBasicBlockRef else_block)
+{
+   if (vm->ssa != NULL) {
+      LLVMBasicBlockRef current_block = LLVMGetInsertBlock(vm->builder);
+
+      ssa_add_predecessor(vm->ssa, then_block, current_block);
+      ssa_add_predecessor(vm->ssa, else_block, current_block);
+   }
+
+   LLVMBuildCondBr(vm->builder, condition, then_block, else_block);
+}
+
+/* the name the profile sites of the function being lowered go by */
+static const char *
+profile_function_name(struct vm_state *vm)
+{
+   return vm->function != NULL ? vm->function->identifier : "main";
+}
+
+/* adds one to profile counter 'index', see profile.h */
+static void
+build_profile_count(struct vm_state *vm, LLVMValueRef index)
+{
+   LLVMTypeRef counter_type = LLVMInt64TypeInContext(vm->context);
+   LLVMTypeRef counters_type = LLVMArrayType(counter_type, 0);
+   LLVMValueRef indices[2], counter, count;
+
+   if (vm->profile_counters == NULL)
+      vm->profile_counters = LLVMAddGlobal(vm->module, counters_type,
+                                           PROFILE_COUNTERS);
+
+   indices[0] = LLVMConstNull(vm->int_type);
+   indices[1] = index;
+   counter = LLVMBuildGEP2(vm->builder, counters_type, vm->profile_counters,
+                           indices, 2, "");
+   count = LLVMBuildLoad2(vm->builder, counter_type, counter, "");
+   count = LLVMBuildAdd(vm->builder, count,
+                        LLVMConstInt(counter_type, 1, 0), "");
+   LLVMBuildStore(vm->builder, count, counter);
+}
+
+/* the counts scaled to 32 bits, as clang does; none is zero */
+static LLVMValueRef
+build_branch_weights(struct vm_state *vm, const uint64_t counts[2])
+{
+   LLVMMetadataRef operands[3];
+   uint64_t scale, max;
+   int i;
+
+   max = counts[0] > counts[1] ? counts[0] : counts[1];
+   scale = max > UINT32_MAX ? max / UINT32_MAX + 1 : 1;
+
+   operands[0] = LLVMMDStringInContext2(vm->context, "branch_weights", 14);
+   for (i = 0; i < 2; i++)
+      operands[i + 1] = LLVMValueAsMetadata(
+                           LLVMConstInt(vm->int_type,
+                                        counts[i] / scale + 1, 0));
+
+   return LLVMMetadataAsValue(vm->context,
+                              LLVMMDNodeInContext2(vm->context, operands, 3));
+}
+
+/*
+ * The branch on an if or while condition: counted for
+ * --profile-generate, weighted by the counts of --profile-use.
+ */
+static void
+build_profiled_cond_br(struct vm_state *vm, int kind,
+                       ast_index condition_expression, LLVMValueRef condition,
+                       LLVMBasicBlockRef then_block,
+                       LLVMBasicBlockRef else_block)
+{
+   struct profile_site *site;
+   LLVMValueRef branch;
+   uint64_t key;
+   uint32_t index;
+
+   if (vm->profile == NULL) {
+      build_cond_br(vm, condition, then_block, else_block);
+      return;
+   }
+
+   key = profile_key(vm->profile, vm->ast, profile_function_name(vm), kind,
+                     condition_expression);
+
+   if (vm->profile->mode == PROFILE_GENERATE) {
+      index = profile_add_site(vm->profile, key, profile_function_name(vm),
+                               kind);
+      build_profile_count(vm, LLVMBuildSelect(vm->builder, condition,
+                                              LLVMConstInt(vm->int_type,
+                                                           2 * index, 0),
+                                              LLVMConstInt(vm->int_type,
+                                                           2 * index + 1, 0),
+                                              ""));
+      build_cond_br(vm, condition, then_block, else_block);
+      return;
+   }
+
+   build_cond_br(vm, condition, then_block, else_block);
+   site = profile_find_site(vm->profile, key);
+   if (site != NULL) {
+      branch = LLVMGetBasicBlockTerminator(LLVMGetInsertBlock(vm->builder));
+      LLVMSetMetadata(branch, LLVMGetMDKindIDInContext(vm->context, "prof", 4),
+                      build_branch_weights(vm, site->counts));
+   }
+}
+
+/* counts the entries of the function being lowered, or weighs them */
+static void
+build_profiled_entry(struct vm_state *vm, LLVMValueRef function_value)
+{
+   LLVMMetadataRef operands[2];
+   struct profile_site *site;
+   uint64_t key;
+   uint32_t index;
+
+   if (vm->profile == NULL)
+      return;
+
+   key = profile_key(vm->profile, vm->ast, profile_function_name(vm),
+                     PROFILE_ENTRY, AST_NONE);
+
+   if (vm->profile->mode == PROFILE_GENERATE) {
+      index = profile_add_site(vm->profile, key, profile_function_name(vm),
+                               PROFILE_ENTRY);
+      build_profile_count(vm, LLVMConstInt(vm->int_type, 2 * index, 0));
+      return;
+   }
+
+   site = profile_find_site(vm->profile, key);
+   if (site == NULL)
+      return;
+
+   operands[0] = LLVMMDStringInContext2(vm->context, "function_entry_count",
+                                        20);
+   operands[1] = LLVMValueAsMetadata(
+                    LLVMConstInt(LLVMInt64TypeInContext(vm->context),
+                                 site->counts[0], 0));
+   LLVMGlobalSetMetadata(function_value,
+                         LLVMGetMDKindIDInContext(vm->context, "prof", 4),
+                         LLVMMDNodeInContext2(vm->context, operands, 2));
+}
+
+/*
+ * The counters get their size once every site is known: the placeholder
+ * the counts were built against makes way for the real array.
+ */
+static void
+finish_profile_counters(struct vm_state *vm)
+{
+   LLVMTypeRef type;
+   LLVMValueRef counters;
+
+   if (vm->profile_counters == NULL)
+      return;
+
+   type = LLVMArrayType(LLVMInt64TypeInContext(vm->context),
+                        2 * vm->profile->number_of_sites);
+   LLVMSetValueName2(vm->profile_counters, "", 0);
+   counters = LLVMAddGlobal(vm->module, type, PROFILE_COUNTERS);
+   LLVMSetInitializer(counters, LLVMConstNull(type));
+
+   LLVMReplaceAllUsesWith(vm->profile_counters,
+                          LLVMConstBitCast(counters,
+                                           LLVMTypeOf(vm->profile_counters)));
+   LLVMDeleteGlobal(vm->profile_counters);
+   vm->profile_counters = counters;
+}
+
+static LLVMBasicBlockRef
+append_block(struct vm_state *vm, LLVMValueRef function, const char *name)
+{
+   return LLVMAppendBasicBlockInContext(vm->context, function, name);
+}
+
+static void
+seal_block(struct vm_state *vm, LLVMBasicBlockRef block)
+{
+   if (vm->ssa != NULL)
+      ssa_seal_block(vm->ssa, block);
+}
+
+/* calls a non-overloaded intrinsic such as "llvm.trap" */
+static LLVMValueRef
+build_intrinsic_call(struct vm_state *vm, const char *name,
+                     LLVMValueRef *args, unsigned number_of_args)
+{
+   unsigned id = LLVMLookupIntrinsicID(name, strlen(name));
+   LLVMValueRef function;
+   LLVMTypeRef type;
+
+   function = LLVMGetIntrinsicDeclaration(vm->module, id, NULL, 0);
+   type = LLVMIntrinsicGetType(vm->context, id, NULL, 0);
+
+   return LLVMBuildCall2(vm->builder, type, function, args, number_of_args,
+                         "");
+}
+
+/*
+ * The block every failed check of a function branches to. It ends in a
+ * noreturn trap, which is also what tells the optimizer that the checks
+ * are expected to pass.
+ */
+static LLVMBasicBlockRef
+get_trap_block(struct vm_state *vm, LLVMValueRef function)
+{
+   LLVMBasicBlockRef current_block;
+
+   if (vm->trap_block != NULL &&
+       LLVMGetBasicBlockParent(vm->trap_block) == function)
+      return vm->trap_block;
+
+   current_block = LLVMGetInsertBlock(vm->builder);
+   vm->trap_block = append_block(vm, function, "out_of_bounds");
+   LLVMPositionBuilderAtEnd(vm->builder, vm->trap_block);
+   build_intrinsic_call(vm, "llvm.trap", NULL, 0);
+   LLVMBuildUnreachable(vm->builder);
+   LLVMPositionBuilderAtEnd(vm->builder, current_block);
+
+   return vm->trap_block;
+}
+
+/* carries on in a new block if 'condition' holds, traps otherwise */
+static void
+build_check(struct vm_state *vm, LLVMValueRef condition)
+{
+   LLVMBasicBlockRef current_block, checked_block;
+   LLVMValueRef function_value;
+
+   current_block = LLVMGetInsertBlock(vm->builder);
+   function_value = LLVMGetBasicBlockParent(current_block);
+
+   checked_block = append_block(vm, function_value, "in_bounds");
+   build_cond_br(vm, condition, checked_block,
+                 get_trap_block(vm, function_value));
+   seal_block(vm, checked_block);
+   LLVMPositionBuilderAtEnd(vm->builder, checked_block);
+}
+
+/*
+ * Address of array[index]. The index is checked against the length
+ * unless it is a constant known to be in bounds; a check in a loop is
+ * left for the optimizer, which drops it when the loop condition implies
+ * it, so the loop still vectorizes.
+ */
+static LLVMValueRef
+build_element_pointer(struct vm_state *vm, struct vm_value *array,
+                      ast_index index_expression)
+{
+   struct vm_value index;
+   LLVMValueRef offset;
+
+   index = drive_expression(vm, index_expression);
+
+   if (vm->bounds_checks &&
+       !(LLVMIsAConstantInt(index.llvm_value) &&
+         LLVMIsAConstantInt(array->length) &&
+         LLVMConstIntGetZExtValue(index.llvm_value) <
+         LLVMConstIntGetZExtValue(array->length))) {
+      /* unsigned, so that a negative index fails too */
+      build_check(vm, LLVMBuildICmp(vm->builder, LLVMIntULT,
+                                    index.llvm_value, array->length, ""));
+   }
+
+   offset = LLVMBuildSExt(vm->builder, index.llvm_value,
+                          LLVMInt64TypeInContext(vm->context), "");
+   return LLVMBuildInBoundsGEP2(vm->builder, array->llvm_type,
+                                array->llvm_value, &offset, 1, "");
+}
+
+void
+drive_statement(struct vm_state *vm, ast_ref statement)
+{
+   struct ast *ast = vm->ast;
+   ast_index index = AST_REF_INDEX(statement);
 
+   switch (AST_REF_TAG(statement)) {
       case AST_DECLARATION:
-         drive_declaration(vm, (struct ast_declaration *) node);
+         drive_declaration(vm, &ast->declarations[index]);
          return;
       case AST_EXPRESSION:
-         drive_expression(vm, (struct ast_expression *) node);
-         return;
-      case AST_STATEMENT_LIST:
-         drive_statement_list(vm, (struct ast_statement_list *) node);
+         drive_expression(vm, index);
          return;
       case AST_COMPOUND_STATEMENT:
-         drive_compound_statement(vm, (struct ast_compound_statement *) node);
+         drive_compound_statement(vm, index);
          return;
       case AST_SELECTION_STATEMENT:
-         drive_selection_statement(vm, (struct ast_selection_statement *) node);
+         drive_selection_statement(vm, &ast->selection_statements[index]);
          return;
       case AST_WHILE_STATEMENT:
-         drive_while_statement(vm, (struct ast_while_statement *) node);
+         drive_while_statement(vm, &ast->while_statements[index]);
+         return;
+      case AST_FOR_STATEMENT:
+         drive_for_statement(vm, &ast->for_statements[index]);
+         return;
+      case AST_FUNCTION_DEFINITION:
+         drive_function_definition(vm, &ast->function_definitions[index]);
          return;
-      case AST_TRANSLATION_UNIT:
-         drive_translation_unit(vm, (struct ast_translation_unit *) node);
+      case AST_RETURN_STATEMENT:
+         drive_return_statement(vm, index);
          return;
 
       default:
-         fprintf(stderr, "Request to drive unknonwn node: %d\n", node->tag);
+         fprintf(stderr, "Request to drive unknonwn statement: %d\n",
+                         AST_REF_TAG(statement));
          exit(EXIT_FAILURE);
    }
 }
 
+/*
+ * An array argument passes the array's pointer and length; the type
+ * checker has made sure it names an array, and only once.
+ */
+static struct vm_value
+drive_call(struct vm_state *vm, struct ast_expression *call)
+{
+   struct vm_value *function, *array, argument, ret = { 0 };
+   struct ast_expression *node, *value;
+   LLVMTypeRef *types;
+   LLVMValueRef *args;
+   unsigned i, n;
+   ast_index next;
+
+   function = vm_state_get_value(vm, call->primary_expr.symbol);
+
+   n = LLVMCountParamTypes(function->function_type);
+   types = malloc((n + 1) * sizeof(LLVMTypeRef));
+   args = malloc((n + 1) * sizeof(LLVMValueRef));
+   if (types == NULL || args == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+   LLVMGetParamTypes(function->function_type, types);
+
+   i = 0;
+   for (next = call->subexpr[0]; next != AST_NONE; next = node->subexpr[1]) {
+      node = ast_expression(vm->ast, next);
+
+      if (LLVMGetTypeKind(types[i]) != LLVMPointerTypeKind) {
+         argument = drive_expression(vm, node->subexpr[0]);
+         args[i++] = argument.llvm_value;
+         continue;
+      }
+
+      value = ast_expression(vm->ast, node->subexpr[0]);
+      array = vm_state_get_value(vm, value->primary_expr.symbol);
+      args[i++] = array->llvm_value;
+      args[i++] = array->length;
+   }
+
+   ret.type_specifier = function->type_specifier;
+   ret.llvm_type = function->llvm_type;
+   ret.symbol = -1;
+   ret.llvm_value = LLVMBuildCall2(vm->builder, function->function_type,
+                                   function->llvm_value, args, n, "");
+
+   free(types);
+   free(args);
+
+   return ret;
+}
+
+static void
+drive_array_declaration(struct vm_state *vm, struct vm_value *vmval,
+                        ast_index size)
+{
+   struct vm_value length;
+   LLVMValueRef zero;
+
+   length = drive_expression(vm, size);
+
+   if (LLVMIsAConstantInt(length.llvm_value)) {
+      if (LLVMConstIntGetSExtValue(length.llvm_value) < 0) {
+         fprintf(stderr, "%s: negative array size\n", vmval->identifier);
+         exit(EXIT_FAILURE);
+      }
+   } else if (vm->bounds_checks) {
+      zero = LLVMConstNull(vm->int_type);
+      build_check(vm, LLVMBuildICmp(vm->builder, LLVMIntSGE,
+                                    length.llvm_value, zero, ""));
+   }
+
+   vm_value_alloca_array(vm, vmval, length.llvm_value);
+}
+
 static void
 drive_declaration(struct vm_state *vm,
                   struct ast_declaration *declaration)
 {
    struct vm_value *vmval;
 
-   vmval = vm_value_new(declaration->type_specifier,
-                        declaration->identifier);
+   vmval = vm_value_new_variable(vm, declaration->type_specifier,
+                                     declaration->symbol);
+
+   /* the size is evaluated before the array is in scope */
+   if (declaration->size != AST_NONE) {
+      drive_array_declaration(vm, vmval, declaration->size);
+   } else if (vm->ssa != NULL) {
+      vmval->ssa_variable = ssa_declare_variable(vm->ssa, vmval->llvm_type);
+      ssa_write_variable(vm->ssa, vmval->ssa_variable,
+                         LLVMGetInsertBlock(vm->builder),
+                         LLVMGetUndef(vmval->llvm_type));
+   } else {
+      vm_value_alloca(vm, vmval);
+   }
 
-   vmval->llvm_value = LLVMBuildAlloca(vm->builder,
-                                       vmval->llvm_type,
-                                       vmval->identifier);
    vm_state_put_value(vm, vmval);
 }
 
-static struct vm_value *
-drive_expression(struct vm_state *vm,
-                 struct ast_expression *expression)
+struct vm_value
+drive_expression(struct vm_state *vm, ast_index index)
 {
+   struct ast_expression *expression = ast_expression(vm->ast, index);
+
    switch (expression->operator) {
       case AST_ADD: case AST_SUB:
       case AST_MUL: case AST_DIV: {
-         struct vm_value *lhs, *rhs;
+         struct vm_value lhs, rhs;
 
          lhs = drive_expression(vm, expression->subexpr[0]);
          rhs = drive_expression(vm, expression->subexpr[1]);
 
-         return vm_value_build_math_op(vm, expression->operator, lhs, rhs);
+         return vm_value_build_math_op(vm, expression->operator, &lhs, &rhs);
       }
       case AST_GT: case AST_LT:
       case AST_EQ: case AST_NE:
       case AST_LE: case AST_GE: {
-         struct vm_value *lhs, *rhs;
+         struct vm_value lhs, rhs;
 
          lhs = drive_expression(vm, expression->subexpr[0]);
          rhs = drive_expression(vm, expression->subexpr[1]);
 
-         return vm_value_build_cmp_op(vm, expression->operator, lhs, rhs);
+         return vm_value_build_cmp_op(vm, expression->operator, &lhs, &rhs);
       }
       case AST_ASSIGN: {
-         struct vm_value *ret, *lhs, *rhs;
+         struct vm_value *lhs, ret, rhs;
 
-         lhs = vm_state_get_value(vm, expression->primary_expr.identifier);
+         lhs = vm_state_get_value(vm, expression->primary_expr.symbol);
          rhs = drive_expression(vm, expression->subexpr[0]);
 
-         ret = vm_value_dup(lhs);
-         LLVMBuildStore(vm->builder, rhs->llvm_value, ret->llvm_value);
+         /* the value of an assignment is the value assigned */
+         ret = *lhs;
+         ret.llvm_value = rhs.llvm_value;
+         if (vm->ssa != NULL) {
+            ssa_write_variable(vm->ssa, lhs->ssa_variable,
+                               LLVMGetInsertBlock(vm->builder),
+                               rhs.llvm_value);
+         } else {
+            LLVMBuildStore(vm->builder, rhs.llvm_value, lhs->llvm_value);
+         }
+
+         return ret;
+      }
+      case AST_ASSIGN_INDEX: {
+         struct vm_value *array, ret;
+         LLVMValueRef pointer;
+
+         /* the index goes first, like the address in C */
+         array = vm_state_get_value(vm, expression->primary_expr.symbol);
+         pointer = build_element_pointer(vm, array, expression->subexpr[1]);
+         ret = drive_expression(vm, expression->subexpr[0]);
+         LLVMBuildStore(vm->builder, ret.llvm_value, pointer);
+
+         return ret;
+      }
+      case AST_INDEX: {
+         struct vm_value *array, ret;
+         LLVMValueRef pointer;
 
+         array = vm_state_get_value(vm, expression->primary_expr.symbol);
+         pointer = build_element_pointer(vm, array, expression->subexpr[0]);
+         ret = *array;
+         ret.length = NULL;
+         ret.llvm_value = LLVMBuildLoad2(vm->builder, array->llvm_type,
+                                         pointer, "");
          return ret;
       }
       case AST_IDENTIFIER: {
-         struct vm_value *vmval, *ret;
+         struct vm_value *vmval, ret;
+
+         vmval = vm_state_get_value(vm, expression->primary_expr.symbol);
+         ret = *vmval;
+         if (vm->ssa != NULL) {
+            LLVMBasicBlockRef block = LLVMGetInsertBlock(vm->builder);
 
-         vmval = vm_state_get_value(vm, expression->primary_expr.identifier);
-         ret = vm_value_dup(vmval);
-         ret->llvm_value = LLVMBuildLoad(vm->builder, vmval->llvm_value, "");
+            ret.llvm_value = ssa_read_variable(vm->ssa, vmval->ssa_variable,
+                                               block);
+         } else {
+            ret.llvm_value = LLVMBuildLoad(vm->builder, vmval->llvm_value, "");
+         }
          return ret;
       }
+      case AST_CALL:
+         return drive_call(vm, expression);
+      case AST_CONVERT: {
+         struct vm_value value = drive_expression(vm, expression->subexpr[0]);
+
+         return vm_value_build_conversion(vm, expression->type, &value);
+      }
       case AST_INT_CONSTANT:
-         return vm_value_new_from_int_constant(
+         return vm_value_from_int_constant(vm,
                expression->primary_expr.int_constant);
       case AST_FLOAT_CONSTANT:
-         return vm_value_new_from_float_constant(
+         return vm_value_from_float_constant(vm,
                expression->primary_expr.float_constant);
       default:
          fprintf(stderr,
@@ -133,18 +581,18 @@ drive_expression(struct vm_state *vm,
                  expression->operator);
          exit(EXIT_FAILURE);
    }
-
-   return NULL;
 }
 
 static void
 drive_statement_list(struct vm_state *vm,
                      struct ast_statement_list *statement_list)
 {
-   int i;
+   ast_ref *statements;
+   uint32_t i;
 
+   statements = &vm->ast->statements[statement_list->first];
    for (i = 0; i < statement_list->number_of_statements; i++)
-      drive_node(vm, statement_list->statement[i]);
+      drive_statement(vm, statements[i]);
 }
 
 static void
@@ -155,89 +603,1102 @@ drive_selection_statement(struct vm_state *vm,
                      condition_block, then_block, else_block,
                      merge_block;
    LLVMValueRef function_value;
-   struct vm_value *cond_vmval;
+   struct vm_value cond_vmval;
 
    current_block = LLVMGetInsertBlock(vm->builder);
    function_value = LLVMGetBasicBlockParent(current_block);
 
-   condition_block = LLVMAppendBasicBlock(function_value, "if_condition");
-   then_block = LLVMAppendBasicBlock(function_value, "then_body");
-   if (selection_statement->else_body != NULL)
-      else_block = LLVMAppendBasicBlock(function_value, "else_body");
-   merge_block = LLVMAppendBasicBlock(function_value, "if_merge");
+   condition_block = append_block(vm, function_value, "if_condition");
+   then_block = append_block(vm, function_value, "then_body");
+   if (selection_statement->else_body != AST_NONE)
+      else_block = append_block(vm, function_value, "else_body");
+   merge_block = append_block(vm, function_value, "if_merge");
 
-   LLVMBuildBr(vm->builder, condition_block);
+   build_br(vm, condition_block);
+   seal_block(vm, condition_block);
    LLVMPositionBuilderAtEnd(vm->builder, condition_block);
    cond_vmval = drive_expression(vm, selection_statement->condition);
-   if (selection_statement->else_body != NULL) {
-      LLVMBuildCondBr(vm->builder, cond_vmval->llvm_value,
-                                   then_block, else_block);
+   if (selection_statement->else_body != AST_NONE) {
+      build_profiled_cond_br(vm, PROFILE_IF, selection_statement->condition,
+                             cond_vmval.llvm_value, then_block, else_block);
+      seal_block(vm, else_block);
    } else {
-      LLVMBuildCondBr(vm->builder, cond_vmval->llvm_value,
-                                   then_block, merge_block);
+      build_profiled_cond_br(vm, PROFILE_IF, selection_statement->condition,
+                             cond_vmval.llvm_value, then_block, merge_block);
    }
+   seal_block(vm, then_block);
 
    LLVMPositionBuilderAtEnd(vm->builder, then_block);
    drive_compound_statement(vm, selection_statement->then_body);
-   LLVMBuildBr(vm->builder, merge_block);
+   build_br(vm, merge_block);
 
-   if (selection_statement->else_body != NULL) {
+   if (selection_statement->else_body != AST_NONE) {
       LLVMPositionBuilderAtEnd(vm->builder, else_block);
       drive_compound_statement(vm, selection_statement->else_body);
-      LLVMBuildBr(vm->builder, merge_block);
+      build_br(vm, merge_block);
    }
 
+   seal_block(vm, merge_block);
    LLVMPositionBuilderAtEnd(vm->builder, merge_block);
 }
 
+/* whether 'vmval' goes through the state of a loop function */
+static int
+is_loop_variable(struct vm_state *vm, struct vm_value *vmval)
+{
+   return vmval != NULL && vmval->function_type == NULL &&
+          vmval->owner == vm->function;
+}
+
+/* the address of slot 'slot' of 'state', as a pointer to 'type' */
+static LLVMValueRef
+build_slot_pointer(struct vm_state *vm, LLVMValueRef state, uint32_t slot,
+                   LLVMTypeRef type)
+{
+   LLVMValueRef index, pointer;
+
+   index = LLVMConstInt(LLVMInt32TypeInContext(vm->context), slot, 0);
+   pointer = LLVMBuildInBoundsGEP2(vm->builder,
+                                   LLVMInt64TypeInContext(vm->context),
+                                   state, &index, 1, "");
+   return LLVMBuildBitCast(vm->builder, pointer, LLVMPointerType(type, 0),
+                           "");
+}
+
+/*
+ * Builds the loop into "loop.<k>" for --tiered, taking the variables of
+ * the function it refers to from the state, see tier.h, in the order of
+ * vm->loop_symbols. The scalars are copied into variables of the loop
+ * function and back out once the loop is done; the arrays are used in
+ * place. The loops within are left to the interpreter's calls.
+ */
+static void
+drive_tiered_loop(struct vm_state *vm,
+                  struct ast_while_statement *while_statement)
+{
+   struct tier_symbols *symbols = vm->loop_symbols;
+   struct vm_value *outer, *vmval;
+   LLVMBasicBlockRef saved_block, saved_entry_block, saved_trap_block;
+   LLVMValueRef saved_last_alloca, function_value, state, value;
+   LLVMTypeRef state_type, function_type;
+   char name[32];
+   uint32_t i, slot;
+
+   state_type = LLVMPointerType(LLVMInt64TypeInContext(vm->context), 0);
+   function_type = LLVMFunctionType(LLVMVoidTypeInContext(vm->context),
+                                    &state_type, 1, 0);
+   snprintf(name, sizeof(name), "loop.%u", vm->number_of_loops++);
+   function_value = LLVMAddFunction(vm->module, name, function_type);
+   state = LLVMGetParam(function_value, 0);
+
+   saved_block = LLVMGetInsertBlock(vm->builder);
+   saved_entry_block = vm->entry_block;
+   saved_last_alloca = vm->last_alloca;
+   saved_trap_block = vm->trap_block;
+
+   vm->entry_block = append_block(vm, function_value, "entry");
+   vm->last_alloca = NULL;
+   vm->trap_block = NULL;
+   vm->tiering = 0;
+   LLVMPositionBuilderAtEnd(vm->builder, vm->entry_block);
+
+   vm_state_enter_scope(vm);
+   for (i = slot = 0; i < symbols->number_of_symbols; i++) {
+      outer = vm_state_get_value(vm, symbols->symbols[i]);
+      if (!is_loop_variable(vm, outer))
+         continue;
+
+      vmval = vm_value_new_variable(vm, outer->type_specifier,
+                                        outer->symbol);
+      if (outer->length != NULL) {
+         value = build_slot_pointer(vm, state, slot++,
+                                    LLVMPointerType(vmval->llvm_type, 0));
+         vmval->llvm_value = LLVMBuildLoad2(vm->builder,
+                                            LLVMPointerType(vmval->llvm_type,
+                                                            0),
+                                            value, vmval->identifier);
+         value = build_slot_pointer(vm, state, slot++, vm->int_type);
+         vmval->length = LLVMBuildLoad2(vm->builder, vm->int_type, value,
+                                        "");
+      } else {
+         value = build_slot_pointer(vm, state, slot++, vmval->llvm_type);
+         value = LLVMBuildLoad2(vm->builder, vmval->llvm_type, value, "");
+         vm_value_alloca(vm, vmval);
+         LLVMBuildStore(vm->builder, value, vmval->llvm_value);
+      }
+
+      vm_state_put_value(vm, vmval);
+   }
+
+   drive_while_statement(vm, while_statement);
+
+   for (i = slot = 0; i < symbols->number_of_symbols; i++) {
+      vmval = vm_state_get_value(vm, symbols->symbols[i]);
+      if (!is_loop_variable(vm, vmval))
+         continue;
+
+      if (vmval->length != NULL) {
+         slot += 2;
+         continue;
+      }
+
+      value = LLVMBuildLoad2(vm->builder, vmval->llvm_type,
+                             vmval->llvm_value, "");
+      LLVMBuildStore(vm->builder, value,
+                     build_slot_pointer(vm, state, slot++,
+                                        vmval->llvm_type));
+   }
+   vm_state_exit_scope(vm);
+   LLVMBuildRetVoid(vm->builder);
+
+   vm->entry_block = saved_entry_block;
+   vm->last_alloca = saved_last_alloca;
+   vm->trap_block = saved_trap_block;
+   vm->tiering = 1;
+   LLVMPositionBuilderAtEnd(vm->builder, saved_block);
+}
+
 static void
 drive_while_statement(struct vm_state *vm,
                       struct ast_while_statement *while_statement)
 {
    LLVMBasicBlockRef current_block, condition_block, body_block, merge_block;
    LLVMValueRef function_value;
-   struct vm_value *cond_vmval;
+   struct vm_value cond_vmval;
+
+   /* numbered as bytecode.c numbers them, before the loops within */
+   if (vm->tiering && vm->loop_depth < TIER_MAX_LOOP_DEPTH &&
+       tier_loop_symbols(vm->loop_symbols, vm->ast, while_statement))
+      drive_tiered_loop(vm, while_statement);
 
    current_block = LLVMGetInsertBlock(vm->builder);
    function_value = LLVMGetBasicBlockParent(current_block);
 
-   condition_block = LLVMAppendBasicBlock(function_value, "while_condition");
-   body_block = LLVMAppendBasicBlock(function_value, "while_body");
-   merge_block = LLVMAppendBasicBlock(function_value, "while_merge");
+   condition_block = append_block(vm, function_value, "while_condition");
+   body_block = append_block(vm, function_value, "while_body");
+   merge_block = append_block(vm, function_value, "while_merge");
 
-   LLVMBuildBr(vm->builder, condition_block);
+   /* the condition block stays unsealed until the back edge exists */
+   build_br(vm, condition_block);
    LLVMPositionBuilderAtEnd(vm->builder, condition_block);
    cond_vmval = drive_expression(vm, while_statement->condition);
-   LLVMBuildCondBr(vm->builder, cond_vmval->llvm_value,
-                                body_block, merge_block);
+   build_profiled_cond_br(vm, PROFILE_WHILE, while_statement->condition,
+                          cond_vmval.llvm_value, body_block, merge_block);
+   seal_block(vm, body_block);
+   seal_block(vm, merge_block);
 
    LLVMPositionBuilderAtEnd(vm->builder, body_block);
+   vm->loop_depth++;
    drive_compound_statement(vm, while_statement->body);
-   LLVMBuildBr(vm->builder, condition_block);
+   vm->loop_depth--;
+   build_br(vm, condition_block);
+   seal_block(vm, condition_block);
 
    LLVMPositionBuilderAtEnd(vm->builder, merge_block);
 }
 
+/* the value of scalar variable 'vmval', in whichever form it lives */
+static LLVMValueRef
+build_variable_load(struct vm_state *vm, struct vm_value *vmval)
+{
+   if (vm->ssa != NULL)
+      return ssa_read_variable(vm->ssa, vmval->ssa_variable,
+                               LLVMGetInsertBlock(vm->builder));
+
+   return LLVMBuildLoad2(vm->builder, vmval->llvm_type, vmval->llvm_value,
+                         "");
+}
+
+static void
+build_variable_store(struct vm_state *vm, struct vm_value *vmval,
+                     LLVMValueRef value)
+{
+   if (vm->ssa != NULL)
+      ssa_write_variable(vm->ssa, vmval->ssa_variable,
+                         LLVMGetInsertBlock(vm->builder), value);
+   else
+      LLVMBuildStore(vm->builder, value, vmval->llvm_value);
+}
+
+/* makes a place for new scalar 'vmval', which starts out as 'value' */
 static void
-drive_compound_statement(struct vm_state *vm,
-                         struct ast_compound_statement *compound_statement)
+build_scalar_variable(struct vm_state *vm, struct vm_value *vmval,
+                      LLVMValueRef value)
 {
-   drive_statement_list(vm, compound_statement->statement_list);
+   if (vm->ssa != NULL)
+      vmval->ssa_variable = ssa_declare_variable(vm->ssa, vmval->llvm_type);
+   else
+      vm_value_alloca(vm, vmval);
+
+   build_variable_store(vm, vmval, value);
+}
+
+/*
+ * The loop of a for statement, from 'lower' up to 'upper' - 1. The count
+ * is a phi of its own, which the optimizer takes for the induction
+ * variable it is, and the index is set from it at the top of every
+ * iteration: assigning the index does not change how often the loop
+ * runs.
+ */
+static void
+build_for_loop(struct vm_state *vm, struct ast_for_statement *for_statement,
+               LLVMValueRef lower, LLVMValueRef upper)
+{
+   LLVMBasicBlockRef current_block, condition_block, body_block, merge_block,
+                     blocks[2];
+   LLVMValueRef function_value, count, values[2];
+   struct ast_declaration *declaration;
+   struct vm_value *index;
+
+   declaration = &vm->ast->declarations[for_statement->index];
+   vm_state_enter_scope(vm);
+   drive_declaration(vm, declaration);
+   index = vm_state_get_value(vm, declaration->symbol);
+
+   current_block = LLVMGetInsertBlock(vm->builder);
+   function_value = LLVMGetBasicBlockParent(current_block);
+
+   condition_block = append_block(vm, function_value, "for_condition");
+   body_block = append_block(vm, function_value, "for_body");
+   merge_block = append_block(vm, function_value, "for_merge");
+
+   /* the condition block stays unsealed until the back edge exists */
+   build_br(vm, condition_block);
+   LLVMPositionBuilderAtEnd(vm->builder, condition_block);
+   count = LLVMBuildPhi(vm->builder, vm->int_type, "count");
+   build_cond_br(vm, LLVMBuildICmp(vm->builder, LLVMIntSLT, count, upper, ""),
+                 body_block, merge_block);
+   seal_block(vm, body_block);
+   seal_block(vm, merge_block);
+
+   LLVMPositionBuilderAtEnd(vm->builder, body_block);
+   build_variable_store(vm, index, count);
+   drive_compound_statement(vm, for_statement->body);
+
+   /* no overflow: the count is below an int */
+   values[0] = lower;
+   values[1] = LLVMBuildNSWAdd(vm->builder, count,
+                               LLVMConstInt(vm->int_type, 1, 0), "");
+   blocks[0] = current_block;
+   blocks[1] = LLVMGetInsertBlock(vm->builder);
+   LLVMAddIncoming(count, values, blocks, 2);
+   build_br(vm, condition_block);
+   seal_block(vm, condition_block);
+
+   vm_state_exit_scope(vm);
+   LLVMPositionBuilderAtEnd(vm->builder, merge_block);
+}
+
+/* what a reduction variable of a parallel for starts out as in each run */
+static LLVMValueRef
+reduction_identity(struct vm_state *vm, struct ast_expression *capture)
+{
+   int one = capture->operator == AST_REDUCE_MUL;
+
+   if (capture->type == TYPE_FLOAT)
+      return vm_value_from_float_constant(vm, one).llvm_value;
+
+   return vm_value_from_int_constant(vm, one).llvm_value;
+}
+
+static int
+reduction_operation(struct ast_expression *capture)
+{
+   return capture->operator == AST_REDUCE_ADD ? AST_ADD : AST_MUL;
+}
+
+/*
+ * Folds 'vmval' into the i32 at 'slot' with a compare-and-swap loop:
+ * every run of a parallel for folds its part of a reduction into the
+ * same slot. A float is swapped by its bits.
+ */
+static void
+build_atomic_fold(struct vm_state *vm, int operation, struct vm_value *vmval,
+                  LLVMValueRef slot)
+{
+   LLVMBasicBlockRef current_block, fold_block, folded_block, blocks[2];
+   LLVMValueRef function_value, expected, swap, values[2];
+   struct vm_value part, folded;
+
+   part = *vmval;
+   part.llvm_value = build_variable_load(vm, vmval);
+   values[0] = LLVMBuildLoad2(vm->builder, vm->int_type, slot, "");
+   LLVMSetOrdering(values[0], LLVMAtomicOrderingMonotonic);
+   LLVMSetAlignment(values[0], 4);
+
+   current_block = LLVMGetInsertBlock(vm->builder);
+   function_value = LLVMGetBasicBlockParent(current_block);
+   fold_block = append_block(vm, function_value, "fold");
+   folded_block = append_block(vm, function_value, "folded");
+
+   build_br(vm, fold_block);
+   LLVMPositionBuilderAtEnd(vm->builder, fold_block);
+   expected = LLVMBuildPhi(vm->builder, vm->int_type, "");
+   folded = part;
+   folded.llvm_value = LLVMBuildBitCast(vm->builder, expected,
+                                        vmval->llvm_type, "");
+   folded = vm_value_build_math_op(vm, operation, &folded, &part);
+   swap = LLVMBuildAtomicCmpXchg(vm->builder, slot, expected,
+                                 LLVMBuildBitCast(vm->builder,
+                                                  folded.llvm_value,
+                                                  vm->int_type, ""),
+                                 LLVMAtomicOrderingSequentiallyConsistent,
+                                 LLVMAtomicOrderingSequentiallyConsistent,
+                                 0);
+   values[1] = LLVMBuildExtractValue(vm->builder, swap, 0, "");
+   build_cond_br(vm, LLVMBuildExtractValue(vm->builder, swap, 1, ""),
+                 folded_block, fold_block);
+   blocks[0] = current_block;
+   blocks[1] = fold_block;
+   LLVMAddIncoming(expected, values, blocks, 2);
+   seal_block(vm, fold_block);
+   seal_block(vm, folded_block);
+
+   LLVMPositionBuilderAtEnd(vm->builder, folded_block);
+}
+
+/*
+ * Builds the body of a parallel for into "<function>.parallel", which
+ * runs the iterations it is given, see parallel.h. It takes the outer
+ * variables it refers to from a context of slots, laid out as the state
+ * of a tiered loop, see tier.h: a scalar is copied in, an array used in
+ * place. A reduction variable starts out as the identity of its
+ * operation instead, and is folded into its slot once the iterations
+ * are done.
+ */
+static LLVMValueRef
+build_parallel_body(struct vm_state *vm,
+                    struct ast_for_statement *for_statement)
+{
+   LLVMBasicBlockRef saved_block, saved_entry_block, saved_trap_block;
+   LLVMValueRef saved_last_alloca, function_value, context, value;
+   LLVMTypeRef types[3], function_type;
+   struct ssa_builder *saved_ssa;
+   struct ast_expression *capture;
+   struct vm_value *outer, *vmval;
+   ast_index next;
+   uint32_t slot;
+   char name[128];
+
+   types[0] = LLVMPointerType(LLVMInt64TypeInContext(vm->context), 0);
+   types[1] = types[2] = vm->int_type;
+   function_type = LLVMFunctionType(LLVMVoidTypeInContext(vm->context),
+                                    types, 3, 0);
+   snprintf(name, sizeof(name), "%.100s.parallel",
+            vm->function != NULL ? vm->function->identifier : "main");
+   function_value = LLVMAddFunction(vm->module, name, function_type);
+   LLVMSetLinkage(function_value, LLVMInternalLinkage);
+   context = LLVMGetParam(function_value, 0);
+
+   saved_block = LLVMGetInsertBlock(vm->builder);
+   saved_entry_block = vm->entry_block;
+   saved_last_alloca = vm->last_alloca;
+   saved_trap_block = vm->trap_block;
+   saved_ssa = vm->ssa;
+
+   vm->entry_block = append_block(vm, function_value, "entry");
+   vm->last_alloca = NULL;
+   vm->trap_block = NULL;
+   if (saved_ssa != NULL)
+      vm->ssa = ssa_builder_create(vm->context, vm->entry_block);
+   LLVMPositionBuilderAtEnd(vm->builder, vm->entry_block);
+
+   vm_state_enter_scope(vm);
+   slot = 0;
+   for (next = for_statement->captures; next != AST_NONE;
+        next = capture->subexpr[0]) {
+      capture = ast_expression(vm->ast, next);
+      outer = vm_state_get_value(vm, capture->primary_expr.symbol);
+      vmval = vm_value_new_variable(vm, outer->type_specifier,
+                                        outer->symbol);
+
+      if (outer->length != NULL) {
+         value = build_slot_pointer(vm, context, slot++,
+                                    LLVMPointerType(vmval->llvm_type, 0));
+         vmval->llvm_value = LLVMBuildLoad2(vm->builder,
+                                            LLVMPointerType(vmval->llvm_type,
+                                                            0),
+                                            value, vmval->identifier);
+         value = build_slot_pointer(vm, context, slot++, vm->int_type);
+         vmval->length = LLVMBuildLoad2(vm->builder, vm->int_type, value,
+                                        "");
+      } else if (capture->operator == AST_CAPTURE) {
+         value = build_slot_pointer(vm, context, slot++, vmval->llvm_type);
+         build_scalar_variable(vm, vmval,
+                               LLVMBuildLoad2(vm->builder, vmval->llvm_type,
+                                              value, ""));
+      } else {
+         slot++;
+         build_scalar_variable(vm, vmval, reduction_identity(vm, capture));
+      }
+
+      vm_state_put_value(vm, vmval);
+   }
+
+   build_for_loop(vm, for_statement, LLVMGetParam(function_value, 1),
+                  LLVMGetParam(function_value, 2));
+
+   slot = 0;
+   for (next = for_statement->captures; next != AST_NONE;
+        next = capture->subexpr[0]) {
+      capture = ast_expression(vm->ast, next);
+      vmval = vm_state_get_value(vm, capture->primary_expr.symbol);
+      if (vmval->length != NULL) {
+         slot += 2;
+         continue;
+      }
+
+      if (capture->operator != AST_CAPTURE)
+         build_atomic_fold(vm, reduction_operation(capture), vmval,
+                           build_slot_pointer(vm, context, slot,
+                                              vm->int_type));
+      slot++;
+   }
+   vm_state_exit_scope(vm);
+   LLVMBuildRetVoid(vm->builder);
+
+   if (vm->ssa != NULL) {
+      ssa_builder_finalize(vm->ssa);
+      ssa_builder_destroy(vm->ssa);
+   }
+
+   vm->entry_block = saved_entry_block;
+   vm->last_alloca = saved_last_alloca;
+   vm->trap_block = saved_trap_block;
+   vm->ssa = saved_ssa;
+   LLVMPositionBuilderAtEnd(vm->builder, saved_block);
+
+   return function_value;
+}
+
+/*
+ * Fills the context of the body, hands both to the runtime with the
+ * bounds, and once every iteration has run folds what the reductions
+ * came to into their variables.
+ */
+static void
+drive_parallel_for(struct vm_state *vm,
+                   struct ast_for_statement *for_statement,
+                   LLVMValueRef lower, LLVMValueRef upper)
+{
+   LLVMTypeRef slot_type = LLVMInt64TypeInContext(vm->context);
+   LLVMTypeRef types[4], runtime_type;
+   LLVMValueRef runtime, args[4], value;
+   struct vm_value context = { 0 }, *vmval, part, result;
+   struct ast_expression *capture;
+   ast_index next;
+   uint32_t slot, number_of_slots = 0;
+
+   for (next = for_statement->captures; next != AST_NONE;
+        next = capture->subexpr[0]) {
+      capture = ast_expression(vm->ast, next);
+      vmval = vm_state_get_value(vm, capture->primary_expr.symbol);
+      number_of_slots += vmval->length != NULL ? 2 : 1;
+   }
+
+   context.llvm_type = LLVMArrayType(slot_type,
+                                     number_of_slots > 0 ? number_of_slots
+                                                         : 1);
+   context.identifier = "context";
+   vm_value_alloca(vm, &context);
+   args[1] = LLVMBuildBitCast(vm->builder, context.llvm_value,
+                              LLVMPointerType(slot_type, 0), "");
+
+   slot = 0;
+   for (next = for_statement->captures; next != AST_NONE;
+        next = capture->subexpr[0]) {
+      capture = ast_expression(vm->ast, next);
+      vmval = vm_state_get_value(vm, capture->primary_expr.symbol);
+
+      if (vmval->length != NULL) {
+         LLVMBuildStore(vm->builder, vmval->llvm_value,
+                        build_slot_pointer(vm, args[1], slot++,
+                                           LLVMPointerType(vmval->llvm_type,
+                                                           0)));
+         LLVMBuildStore(vm->builder, vmval->length,
+                        build_slot_pointer(vm, args[1], slot++,
+                                           vm->int_type));
+         continue;
+      }
+
+      value = capture->operator == AST_CAPTURE ?
+              build_variable_load(vm, vmval) :
+              reduction_identity(vm, capture);
+      LLVMBuildStore(vm->builder, value,
+                     build_slot_pointer(vm, args[1], slot++,
+                                        vmval->llvm_type));
+   }
+
+   args[0] = build_parallel_body(vm, for_statement);
+   args[2] = lower;
+   args[3] = upper;
+
+   types[0] = LLVMTypeOf(args[0]);
+   types[1] = LLVMTypeOf(args[1]);
+   types[2] = types[3] = vm->int_type;
+   runtime_type = LLVMFunctionType(LLVMVoidTypeInContext(vm->context), types,
+                                   4, 0);
+   runtime = LLVMGetNamedFunction(vm->module, PARALLEL_FOR);
+   if (runtime == NULL)
+      runtime = LLVMAddFunction(vm->module, PARALLEL_FOR, runtime_type);
+   LLVMBuildCall2(vm->builder, runtime_type, runtime, args, 4, "");
+
+   slot = 0;
+   for (next = for_statement->captures; next != AST_NONE;
+        next = capture->subexpr[0]) {
+      capture = ast_expression(vm->ast, next);
+      vmval = vm_state_get_value(vm, capture->primary_expr.symbol);
+      if (vmval->length != NULL) {
+         slot += 2;
+         continue;
+      }
+      if (capture->operator == AST_CAPTURE) {
+         slot++;
+         continue;
+      }
+
+      part = *vmval;
+      part.llvm_value = LLVMBuildLoad2(vm->builder, vmval->llvm_type,
+                                       build_slot_pointer(vm, args[1],
+                                                          slot++,
+                                                          vmval->llvm_type),
+                                       "");
+      result = *vmval;
+      result.llvm_value = build_variable_load(vm, vmval);
+      result = vm_value_build_math_op(vm, reduction_operation(capture),
+                                      &result, &part);
+      build_variable_store(vm, vmval, result.llvm_value);
+   }
+}
+
+/* the bounds are evaluated once, before the index is in scope */
+static void
+drive_for_statement(struct vm_state *vm,
+                    struct ast_for_statement *for_statement)
+{
+   struct vm_value lower, upper;
+
+   lower = drive_expression(vm, for_statement->lower);
+   upper = drive_expression(vm, for_statement->upper);
+
+   if (for_statement->parallel)
+      drive_parallel_for(vm, for_statement, lower.llvm_value,
+                         upper.llvm_value);
+   else
+      build_for_loop(vm, for_statement, lower.llvm_value, upper.llvm_value);
+}
+
+/* whether the list declares an array of a size not known until run time */
+static int
+declares_runtime_array(struct ast *ast,
+                       struct ast_statement_list *statement_list)
+{
+   struct ast_declaration *declaration;
+   ast_ref statement;
+   uint32_t i;
+
+   for (i = 0; i < statement_list->number_of_statements; i++) {
+      statement = ast->statements[statement_list->first + i];
+      if (AST_REF_TAG(statement) != AST_DECLARATION)
+         continue;
+
+      declaration = &ast->declarations[AST_REF_INDEX(statement)];
+      if (declaration->size != AST_NONE &&
+          ast_expression(ast, declaration->size)->operator !=
+          AST_INT_CONSTANT)
+         return 1;
+   }
+
+   return 0;
+}
+
+static void
+drive_compound_statement(struct vm_state *vm, ast_index index)
+{
+   struct ast_statement_list *statement_list;
+   LLVMValueRef stack = NULL;
+
+   statement_list = &vm->ast->compound_statements[index].statement_list;
+
+   /* runtime-sized arrays go when the block does, as in a loop body */
+   if (declares_runtime_array(vm->ast, statement_list))
+      stack = build_intrinsic_call(vm, "llvm.stacksave", NULL, 0);
+
+   vm_state_enter_scope(vm);
+   drive_statement_list(vm, statement_list);
+   vm_state_exit_scope(vm);
+
+   if (stack != NULL)
+      build_intrinsic_call(vm, "llvm.stackrestore", &stack, 1);
+}
+
+/*
+ * Every definition is an LLVM function of its own, so the optimizer and
+ * code generator get units of the size the program chose rather than one
+ * huge main. Functions are internal to the module: the inliner gets to
+ * drop a body once every call to it is inlined.
+ */
+static void
+drive_function_definition(struct vm_state *vm,
+                          struct ast_function_definition *definition)
+{
+   struct ast_declaration *parameters;
+   struct vm_value *function, *saved_function, *vmval;
+   LLVMBasicBlockRef saved_block, saved_entry_block, saved_trap_block;
+   LLVMValueRef saved_last_alloca, function_value, value;
+   LLVMAttributeRef noalias, align;
+   struct ssa_builder *saved_ssa;
+   LLVMTypeRef *types;
+   unsigned i, n;
+
+   parameters = &vm->ast->declarations[definition->first_parameter];
+   function = vm_value_new_variable(vm, definition->type_specifier,
+                                        definition->symbol);
+
+   /* an array parameter is a pointer to the first element and a length */
+   types = malloc((2 * definition->number_of_parameters + 1) *
+                  sizeof(LLVMTypeRef));
+   if (types == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+   for (i = n = 0; i < definition->number_of_parameters; i++) {
+      types[n] = vm_value_llvm_type(vm, parameters[i].type_specifier);
+      if (parameters[i].size == AST_UNSIZED) {
+         types[n] = LLVMPointerType(types[n], 0);
+         types[++n] = vm->int_type;
+      }
+      n++;
+   }
+   function->function_type = LLVMFunctionType(function->llvm_type, types, n,
+                                              0);
+   free(types);
+
+   function_value = LLVMAddFunction(vm->module, function->identifier,
+                                    function->function_type);
+   LLVMSetLinkage(function_value, LLVMInternalLinkage);
+   function->llvm_value = function_value;
+
+   /* declared before the body, which may call it */
+   vm_state_put_value(vm, function);
+
+   saved_block = LLVMGetInsertBlock(vm->builder);
+   saved_entry_block = vm->entry_block;
+   saved_last_alloca = vm->last_alloca;
+   saved_trap_block = vm->trap_block;
+   saved_function = vm->function;
+   saved_ssa = vm->ssa;
+
+   vm->entry_block = append_block(vm, function_value, "entry");
+   vm->last_alloca = NULL;
+   vm->trap_block = NULL;
+   vm->function = function;
+   if (saved_ssa != NULL)
+      vm->ssa = ssa_builder_create(vm->context, vm->entry_block);
+   LLVMPositionBuilderAtEnd(vm->builder, vm->entry_block);
+   build_profiled_entry(vm, function_value);
+
+   /* every array is distinct and aligned, see drive_call() */
+   noalias = LLVMCreateEnumAttribute(vm->context,
+                                     LLVMGetEnumAttributeKindForName(
+                                        "noalias", 7), 0);
+   align = LLVMCreateEnumAttribute(vm->context,
+                                   LLVMGetEnumAttributeKindForName(
+                                      "align", 5), VM_ARRAY_ALIGNMENT);
+
+   vm_state_enter_scope(vm);
+   for (i = n = 0; i < definition->number_of_parameters; i++) {
+      vmval = vm_value_new_variable(vm, parameters[i].type_specifier,
+                                        parameters[i].symbol);
+      value = LLVMGetParam(function_value, n);
+      LLVMSetValueName2(value, vmval->identifier, strlen(vmval->identifier));
+
+      if (parameters[i].size == AST_UNSIZED) {
+         LLVMAddAttributeAtIndex(function_value, n + 1, noalias);
+         LLVMAddAttributeAtIndex(function_value, n + 1, align);
+         vmval->llvm_value = value;
+         vmval->length = LLVMGetParam(function_value, ++n);
+      } else if (vm->ssa != NULL) {
+         vmval->ssa_variable = ssa_declare_variable(vm->ssa,
+                                                    vmval->llvm_type);
+         ssa_write_variable(vm->ssa, vmval->ssa_variable, vm->entry_block,
+                            value);
+      } else {
+         vm_value_alloca(vm, vmval);
+         LLVMBuildStore(vm->builder, value, vmval->llvm_value);
+      }
+      n++;
+
+      vm_state_put_value(vm, vmval);
+   }
+   drive_compound_statement(vm, definition->body);
+   vm_state_exit_scope(vm);
+
+   /* running off the end returns zero */
+   if (LLVMGetBasicBlockTerminator(LLVMGetInsertBlock(vm->builder)) == NULL)
+      LLVMBuildRet(vm->builder, LLVMConstNull(function->llvm_type));
+
+   if (vm->ssa != NULL) {
+      ssa_builder_finalize(vm->ssa);
+      ssa_builder_destroy(vm->ssa);
+   }
+
+   vm->entry_block = saved_entry_block;
+   vm->last_alloca = saved_last_alloca;
+   vm->trap_block = saved_trap_block;
+   vm->function = saved_function;
+   vm->ssa = saved_ssa;
+   LLVMPositionBuilderAtEnd(vm->builder, saved_block);
+}
+
+static void
+drive_return_statement(struct vm_state *vm, ast_index index)
+{
+   LLVMBasicBlockRef unreachable_block;
+
+   LLVMBuildRet(vm->builder, drive_expression(vm, index).llvm_value);
+
+   /* whatever follows in the block is dead, but still gets lowered */
+   unreachable_block = append_block(vm,
+                                    LLVMGetBasicBlockParent(
+                                       LLVMGetInsertBlock(vm->builder)),
+                                    "after_return");
+   seal_block(vm, unreachable_block);
+   LLVMPositionBuilderAtEnd(vm->builder, unreachable_block);
 }
 
 static void
 drive_translation_unit(struct vm_state *vm,
                        struct ast_translation_unit *translation_unit)
 {
-   drive_statement_list(vm, translation_unit->statement_list);
+   drive_statement_list(vm, &translation_unit->statement_list);
+}
+
+struct driver *
+driver_create(struct driver_options *options, const char *input_name)
+{
+   struct driver *driver;
+
+   driver = calloc(1, sizeof(struct driver));
+   if (driver == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   driver->options = options;
+   driver->input_name = input_name;
+
+   driver->ast = malloc(sizeof(struct ast));
+   if (driver->ast == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+   ast_init(driver->ast);
+
+   driver->typechecker = typechecker_create(driver->ast);
+   driver->simplifier = simplifier_create(driver->ast);
+
+   driver->vm = vm_state_create("Toy");
+   driver->vm->ast = driver->ast;
+   driver->vm->bounds_checks = !options->no_bounds_check;
+   driver->vm->profile = options->profile;
+   if (options->repl)
+      driver->repl = repl_create(options, driver->vm);
+   else if (options->interp)
+      driver->bytecode = bytecode_create(driver->ast, options->tiered);
+   else if (options->ssa)
+      driver->vm->ssa = ssa_builder_create(driver->vm->context,
+                                            driver->vm->entry_block);
+
+   return driver;
 }
 
 void
-ast_to_llvm(struct ast_translation_unit *translation_unit)
+driver_destroy(struct driver *driver)
 {
-   struct vm_state *vm;
+   struct time_report *report = &driver->report;
+
+   /* the tier's thread may still be lowering into driver->vm */
+   if (driver->tier != NULL)
+      tier_destroy(driver->tier, report);
+   if (driver->repl != NULL)
+      repl_destroy(driver->repl, report);
+   if (driver->typechecker != NULL)
+      typechecker_destroy(driver->typechecker, report);
+   if (driver->simplifier != NULL)
+      simplifier_destroy(driver->simplifier, report);
+
+   if (driver->options->time_report) {
+      report->values = driver->vm->number_of_values;
+      report->symbol_lookups = driver->vm->symtab->lookups;
+      report->symbol_inserts = driver->vm->symtab->inserts;
+      if (driver->options->profile != NULL) {
+         report->profile_sites_compiled =
+            driver->options->profile->sites_compiled;
+         report->profile_sites_matched =
+            driver->options->profile->sites_matched;
+      }
+      time_report_print(report, driver->input_name,
+                        driver->options->time_report, stderr);
+   }
+
+   if (driver->bytecode != NULL)
+      bytecode_destroy(driver->bytecode);
+
+   vm_state_destroy(driver->vm);
+   ast_destroy(driver->ast);
+   free(driver->ast);
+   free(driver);
+}
+
+void
+driver_add_statement(struct driver *driver, ast_ref statement)
+{
+   struct ast *ast = driver->ast;
+   double start;
+
+   driver->number_of_statements++;
+   if (!driver->options->stream && driver->repl == NULL) {
+      statement_list_add_statement(ast, statement);
+      return;
+   }
+
+   /* nothing else is pending at the top level, so the whole tree can go */
+   start = timer_now();
+   statement = typecheck_top_level_statement(driver->typechecker, statement);
+   driver->report.phase_ms[PHASE_TYPECHECK] += timer_elapsed_ms(start);
+
+   /* the REPL reports an ill-typed input and carries on without it */
+   if (statement == AST_NONE && driver->repl == NULL)
+      exit(EXIT_FAILURE);
+
+   start = timer_now();
+   if (statement != AST_NONE)
+      statement = simplify_top_level_statement(driver->simplifier,
+                                               statement);
+   driver->report.phase_ms[PHASE_SIMPLIFY] += timer_elapsed_ms(start);
+
+   start = timer_now();
+   if (statement != AST_NONE && driver->repl != NULL)
+      repl_evaluate(driver->repl, statement);
+   else if (statement != AST_NONE && driver->bytecode != NULL)
+      bytecode_compile_statement(driver->bytecode, statement);
+   else if (statement != AST_NONE)
+      drive_statement(driver->vm, statement);
+   driver->report.phase_ms[PHASE_CODEGEN] += timer_elapsed_ms(start);
+
+   driver->number_of_nodes += ast_number_of_nodes(ast);
+   time_report_count_ast(&driver->report, ast);
+   ast_release(ast);
+
+   if (driver->repl != NULL)
+      repl_prompt(driver->repl);
+}
+
+void
+driver_finish(struct driver *driver)
+{
+   struct time_report *report = &driver->report;
+   struct vm_state *vm = driver->vm;
+   struct ast *ast = driver->ast;
+   double start;
+
+   /* every input has been run already */
+   if (driver->repl != NULL)
+      return;
+
+   /* lexing, and lowering while streaming, went on during the parse */
+   report->phase_ms[PHASE_PARSE] = timer_elapsed_ms(driver->start) -
+                                   report->phase_ms[PHASE_LEX] -
+                                   report->phase_ms[PHASE_TYPECHECK] -
+                                   report->phase_ms[PHASE_SIMPLIFY] -
+                                   report->phase_ms[PHASE_CODEGEN];
+
+   if (!driver->options->stream) {
+      start = timer_now();
+      create_translation_unit(ast, driver->number_of_statements);
+      if (!typecheck_translation_unit(driver->typechecker))
+         exit(EXIT_FAILURE);
+      report->phase_ms[PHASE_TYPECHECK] = timer_elapsed_ms(start);
+
+      start = timer_now();
+      simplify_translation_unit(driver->simplifier);
+      report->phase_ms[PHASE_SIMPLIFY] = timer_elapsed_ms(start);
+
+      // print_translation_unit(ast);
+      start = timer_now();
+      if (driver->bytecode != NULL)
+         bytecode_compile_translation_unit(driver->bytecode);
+      else
+         drive_translation_unit(vm, &ast->translation_unit);
+      report->phase_ms[PHASE_CODEGEN] = timer_elapsed_ms(start);
+
+      /* the tree is no longer needed once the IR is built */
+      driver->number_of_nodes = ast_number_of_nodes(ast);
+      time_report_count_ast(report, ast);
+      if (!driver->options->tiered)
+         ast_release(ast);
+   }
+
+   typechecker_destroy(driver->typechecker, report);
+   driver->typechecker = NULL;
+   simplifier_destroy(driver->simplifier, report);
+   driver->simplifier = NULL;
+
+   /* the interpreter runs what it is given; there is nothing to verify */
+   if (driver->bytecode != NULL) {
+      bytecode_finish(driver->bytecode);
+      report->functions = driver->bytecode->number_of_functions;
+      report->instructions = driver->bytecode->number_of_instructions;
+      if (driver->options->tiered)
+         driver->tier = tier_create(driver,
+                                    driver->bytecode->number_of_loops);
+      return;
+   }
+
+   start = timer_now();
+   vm_state_finalize(vm);
+   finish_profile_counters(vm);
+   report->phase_ms[PHASE_CODEGEN] += timer_elapsed_ms(start);
+
+   start = timer_now();
+   vm_state_verify(vm);
+   report->phase_ms[PHASE_VERIFY] = timer_elapsed_ms(start);
+
+   start = timer_now();
+   optimize_module(vm->module, driver->options->opt_level);
+   report->phase_ms[PHASE_OPTIMIZE] = timer_elapsed_ms(start);
+
+   if (driver->options->time_report)
+      time_report_count_module(report, vm->module);
+}
+
+LLVMModuleRef
+driver_lower_loops(struct driver *driver)
+{
+   struct vm_state *vm = driver->vm;
+   struct tier_symbols symbols = { 0 };
+   LLVMModuleRef module;
+
+   vm->tiering = 1;
+   vm->loop_symbols = &symbols;
+   drive_translation_unit(vm, &driver->ast->translation_unit);
+   vm_state_finalize(vm);
+   vm->tiering = 0;
+   vm->loop_symbols = NULL;
+   tier_symbols_destroy(&symbols);
+
+   /* the interpreter runs main; what the loops call is all that is left */
+   LLVMDeleteFunction(LLVMGetNamedFunction(vm->module, "main"));
+   vm_state_verify(vm);
+
+   module = vm->module;
+   vm->module = NULL;
+
+   return module;
+}
+
+void
+driver_output_module(struct driver_options *options, LLVMModuleRef module,
+                     const char *output_name, struct time_report *report)
+{
+   if (options->run && options->profile != NULL &&
+       options->profile->mode == PROFILE_GENERATE) {
+      profile_run_module(options->profile, module, report);
+      return;
+   }
+
+   if (options->run) {
+      jit_run_module(module, report);
+      return;
+   }
+
+   if (options->emit != 0)
+      emit_module(module, options->emit, options->opt_level, output_name);
+   else
+      LLVMDumpModule(module);
+
+   LLVMDisposeModule(module);
+}
+
+int
+driver_artifact_kind(struct driver_options *options)
+{
+   if (options->link || options->run)
+      return EMIT_BC;
+   if (options->emit != 0)
+      return options->emit;
+
+   return EMIT_LL;
+}
+
+LLVMMemoryBufferRef
+driver_compile_artifact(struct driver_options *options,
+                        const char *input_name, struct source *source,
+                        int kind)
+{
+   char key[CACHE_KEY_LENGTH + 1], configuration[64];
+   LLVMMemoryBufferRef artifact;
+   struct driver *driver;
+   double start;
+   int status;
+
+   start = timer_now();
+
+   if (options->cache != NULL) {
+      snprintf(configuration, sizeof(configuration),
+               "-O%d ssa=%d emit=%d bounds-check=%d", options->opt_level,
+               options->ssa, kind, !options->no_bounds_check);
+      cache_compute_key(options->cache, configuration, source->data,
+                        source->size, key);
+
+      artifact = cache_lookup(options->cache, key);
+      if (artifact != NULL)
+         return artifact;
+   }
+
+   driver = driver_create(options, input_name);
+   status = parse_source(driver, source);
+
+   artifact = NULL;
+   if (status == 0) {
+      double output_start = timer_now();
+
+      artifact = emit_module_to_buffer(driver->vm->module, kind,
+                                       options->opt_level);
+      driver->report.phase_ms[PHASE_OUTPUT] = timer_elapsed_ms(output_start);
+   }
+   driver_destroy(driver);
+
+   if (options->cache != NULL && artifact != NULL)
+      cache_store(options->cache, key, artifact, timer_elapsed_ms(start));
+
+   return artifact;
+}
+
+void
+driver_output_artifact(struct driver_options *options,
+                       LLVMMemoryBufferRef artifact, const char *output_name)
+{
+   LLVMContextRef context;
+   LLVMModuleRef module;
+
+   if (options->run) {
+      context = LLVMContextCreate();
+      if (LLVMParseBitcodeInContext2(context, artifact, &module)) {
+         fprintf(stderr, "Unable to read back bitcode\n");
+         exit(EXIT_FAILURE);
+      }
+      jit_run_module(module, NULL);
+      LLVMContextDispose(context);
+   } else if (options->emit != 0) {
+      emit_write(output_name, LLVMGetBufferStart(artifact),
+                 LLVMGetBufferSize(artifact));
+   } else {
+      /* IR text, dumped where LLVMDumpModule() would */
+      fwrite(LLVMGetBufferStart(artifact), 1, LLVMGetBufferSize(artifact),
+             stderr);
+   }
 
-   vm = vm_state_create("Toy");
-   drive_translation_unit(vm, translation_unit);
-   vm_state_destroy(vm);
+   LLVMDisposeMemoryBuffer(artifact);
 }
@@ -1,8 +1,139 @@
 #ifndef DRIVER_H
 #define DRIVER_H
 
+#include <stdio.h>
+
+#include "ast.h"
+#include "report.h"
 #include "vm_state.h"
+#include "vm_value.h"
+
+struct bytecode;
+struct cache;
+struct profile;
+struct repl;
+struct simplifier;
+struct source;
+struct tier;
+struct typechecker;
+
+struct driver_options {
+   int run;          /* jit-compile and execute main instead of dumping IR */
+   int opt_level;    /* 0-3, see optimize_module() */
+   int ssa;          /* build SSA values directly instead of allocas */
+   int stream;       /* lower each top-level statement once it is parsed */
+   int link;         /* link the modules of several inputs into one */
+   int number_of_threads;  /* for several inputs, see batch_compile() */
+   int repl;         /* run each top-level statement as it is entered */
+   int lexer;        /* LEXER_*, see fastlex.h */
+   int no_bounds_check;    /* index arrays without checking the index */
+   int interp;       /* run main on the bytecode interpreter, see interp.h */
+   int tiered;       /* and its hot loops as native code, see tier.h */
+
+   int emit;                  /* EMIT_*, see emit.h; 0 dumps IR to stderr */
+   const char *output_name;   /* -o; NULL for stdout */
+
+   struct cache *cache;       /* --cache-dir; NULL when not caching */
+   struct profile *profile;   /* --profile-generate or --profile-use */
+
+   int time_report;           /* REPORT_*, see report.h; 0 for none */
+};
+
+/*
+ * Compilation state of one input, shared by the parser actions. The
+ * parser hands every top-level statement to driver_add_statement(): by
+ * default they are collected into a translation unit that is lowered as
+ * a whole, while in streaming mode each one is lowered into the open
+ * module right away and its tree released, so the AST never holds more
+ * than one top-level statement.
+ *
+ * A driver owns its tree and its vm_state (and with it an LLVM context),
+ * so several inputs can be compiled on different threads.
+ */
+struct driver {
+   struct driver_options *options;
+   const char *input_name;          /* for diagnostics */
+
+   struct ast *ast;
+   struct typechecker *typechecker;
+   struct simplifier *simplifier;
+   struct vm_state *vm;
+   struct repl *repl;               /* NULL unless options->repl */
+   struct bytecode *bytecode;       /* NULL unless options->interp */
+   struct tier *tier;               /* NULL unless options->tiered */
+
+   uint32_t number_of_statements;   /* top-level statements seen */
+   size_t number_of_nodes;          /* lowered so far */
+
+   /* printed by driver_destroy() with options->time_report */
+   double start;                    /* of parse_input() */
+   struct time_report report;
+};
+
+struct driver *driver_create(struct driver_options *options,
+                             const char *input_name);
+
+/* prints the time report first, if asked for */
+void driver_destroy(struct driver *driver);
+
+/*
+ * Parses 'input' and lowers it, leaving the verified and optimized
+ * module in driver->vm, or the finished driver->bytecode. Returns 0 on
+ * success. Defined in parser.y.
+ */
+int parse_input(struct driver *driver, FILE *input);
+
+/* the same, scanning the whole of 'source' in place with options->lexer */
+int parse_source(struct driver *driver, struct source *source);
+
+void driver_add_statement(struct driver *driver, ast_ref statement);
+
+/*
+ * Lower a statement, or an expression, at the builder's position; the
+ * REPL uses these to build every input into a module of its own.
+ */
+void drive_statement(struct vm_state *vm, ast_ref statement);
+struct vm_value drive_expression(struct vm_state *vm, ast_index index);
+
+/*
+ * Lowers what is left, then verifies and optimizes the module; for the
+ * interpreter, finishes the bytecode instead.
+ */
+void driver_finish(struct driver *driver);
+
+/*
+ * For --tiered, lowers the finished program once more into a module of
+ * just its loop functions and what they call, see tier.h; the tree is
+ * kept for this. Called once, on the tier's background thread.
+ */
+LLVMModuleRef driver_lower_loops(struct driver *driver);
+
+/*
+ * Jit-compiles and runs 'module' or writes it to 'output_name' as
+ * requested by --emit, taking ownership of the module. A run adds its
+ * jit timings to 'report', which may be NULL.
+ */
+void driver_output_module(struct driver_options *options,
+                          LLVMModuleRef module, const char *output_name,
+                          struct time_report *report);
+
+/*
+ * What compiling one input produces when it is not output right away:
+ * bitcode to run or link, what --emit asks for, or IR text to dump.
+ */
+int driver_artifact_kind(struct driver_options *options);
+
+/*
+ * Compiles 'source' into the bytes of 'kind' (EMIT_*), trying the cache
+ * first when there is one. Returns NULL if the source does not compile.
+ */
+LLVMMemoryBufferRef driver_compile_artifact(struct driver_options *options,
+                                            const char *input_name,
+                                            struct source *source, int kind);
 
-void ast_to_llvm(struct ast_translation_unit *translation_unit);
+/* same as driver_output_module(), for an artifact; takes ownership */
+void driver_output_artifact(struct driver_options *options,
+                            LLVMMemoryBufferRef artifact,
+                            const char *output_name);
 
 #endif /* DRIVER_H */
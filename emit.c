@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <llvm-c/BitWriter.h>
+#include <llvm-c/TargetMachine.h>
+
+#include "emit.h"
+#include "target.h"
+
+int
+emit_parse_kind(const char *name)
+{
+   if (strcmp(name, "ll") == 0)
+      return EMIT_LL;
+   if (strcmp(name, "bc") == 0)
+      return EMIT_BC;
+   if (strcmp(name, "asm") == 0)
+      return EMIT_ASM;
+   if (strcmp(name, "obj") == 0)
+      return EMIT_OBJ;
+
+   return 0;
+}
+
+const char *
+emit_extension(int kind)
+{
+   switch (kind) {
+      case EMIT_BC:
+         return ".bc";
+      case EMIT_ASM:
+         return ".s";
+      case EMIT_OBJ:
+         return ".o";
+      default:
+         return ".ll";
+   }
+}
+
+void
+emit_write(const char *filename, const char *data, size_t size)
+{
+   FILE *output;
+
+   if (filename == NULL || strcmp(filename, "-") == 0) {
+      output = stdout;
+   } else {
+      output = fopen(filename, "wb");
+      if (output == NULL) {
+         perror(filename);
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   if (fwrite(data, 1, size, output) != size || fflush(output) != 0) {
+      fprintf(stderr, "Failed to write %s\n",
+                      output == stdout ? "standard output" : filename);
+      exit(EXIT_FAILURE);
+   }
+
+   if (output != stdout)
+      fclose(output);
+}
+
+static LLVMMemoryBufferRef
+emit_machine_code(LLVMModuleRef module, int kind, int opt_level)
+{
+   LLVMTargetMachineRef machine;
+   LLVMMemoryBufferRef buffer;
+   char *error;
+
+   machine = target_machine_create_host(opt_level);
+   target_machine_configure_module(machine, module);
+
+   error = NULL;
+   if (LLVMTargetMachineEmitToMemoryBuffer(machine, module,
+                                           kind == EMIT_ASM ?
+                                           LLVMAssemblyFile : LLVMObjectFile,
+                                           &error, &buffer)) {
+      fprintf(stderr, "Code generation failed: %s\n", error);
+      exit(EXIT_FAILURE);
+   }
+
+   LLVMDisposeTargetMachine(machine);
+   return buffer;
+}
+
+LLVMMemoryBufferRef
+emit_module_to_buffer(LLVMModuleRef module, int kind, int opt_level)
+{
+   LLVMMemoryBufferRef buffer;
+   char *text;
+
+   switch (kind) {
+      case EMIT_LL:
+         text = LLVMPrintModuleToString(module);
+         buffer = LLVMCreateMemoryBufferWithMemoryRangeCopy(text,
+                                                            strlen(text),
+                                                            "ll");
+         LLVMDisposeMessage(text);
+         return buffer;
+      case EMIT_BC:
+         return LLVMWriteBitcodeToMemoryBuffer(module);
+      default:
+         return emit_machine_code(module, kind, opt_level);
+   }
+}
+
+void
+emit_module(LLVMModuleRef module, int kind, int opt_level,
+            const char *filename)
+{
+   LLVMMemoryBufferRef buffer;
+
+   buffer = emit_module_to_buffer(module, kind, opt_level);
+   emit_write(filename, LLVMGetBufferStart(buffer),
+              LLVMGetBufferSize(buffer));
+   LLVMDisposeMemoryBuffer(buffer);
+}
@@ -0,0 +1,33 @@
+#ifndef EMIT_H
+#define EMIT_H
+
+#include <llvm-c/Core.h>
+
+/* output kinds, see --emit= */
+#define EMIT_LL      1     /* textual IR */
+#define EMIT_BC      2     /* bitcode */
+#define EMIT_ASM     3     /* assembly for the host */
+#define EMIT_OBJ     4     /* object file for the host */
+
+/* returns the kind named 'name' (ll, bc, asm, obj), or 0 if unknown */
+int emit_parse_kind(const char *name);
+
+/* extension of the kind's files, for outputs named after their input */
+const char *emit_extension(int kind);
+
+/*
+ * Writes 'module' as 'kind' to 'filename', or to stdout if that is NULL
+ * or "-". Assembly and objects are generated in-process for the host at
+ * the given optimization level.
+ */
+void emit_module(LLVMModuleRef module, int kind, int opt_level,
+                 const char *filename);
+
+/* the bytes emit_module() would write */
+LLVMMemoryBufferRef emit_module_to_buffer(LLVMModuleRef module, int kind,
+                                          int opt_level);
+
+/* writes 'size' bytes to 'filename', or to stdout if NULL or "-" */
+void emit_write(const char *filename, const char *data, size_t size);
+
+#endif /* EMIT_H */
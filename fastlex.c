@@ -0,0 +1,274 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "fastlex.h"
+#include "intern.h"
+
+#define CLASS_SPACE     1     /* [ \t\r\n] */
+#define CLASS_DIGIT     2     /* [0-9] */
+#define CLASS_ALPHA     4     /* [_a-zA-Z] */
+#define CLASS_WORD      (CLASS_DIGIT | CLASS_ALPHA)
+
+static const unsigned char classes[256] = {
+   [' '] = CLASS_SPACE, ['\t'] = CLASS_SPACE,
+   ['\r'] = CLASS_SPACE, ['\n'] = CLASS_SPACE,
+   ['0' ... '9'] = CLASS_DIGIT,
+   ['a' ... 'z'] = CLASS_ALPHA, ['A' ... 'Z'] = CLASS_ALPHA,
+   ['_'] = CLASS_ALPHA,
+};
+
+/* no two keywords share a slot, so one compare tells */
+#define KEYWORD_HASH(first, length)    ((2 * (first) + (length)) & 15)
+
+static const struct keyword {
+   const char *name;
+   size_t length;
+   int token;
+} keywords[16] = {
+   [KEYWORD_HASH('i', 3)] = { "int",      3, KW_INT      },
+   [KEYWORD_HASH('f', 5)] = { "float",    5, KW_FLOAT    },
+   [KEYWORD_HASH('i', 2)] = { "if",       2, KW_IF       },
+   [KEYWORD_HASH('e', 4)] = { "else",     4, KW_ELSE     },
+   [KEYWORD_HASH('w', 5)] = { "while",    5, KW_WHILE    },
+   [KEYWORD_HASH('r', 6)] = { "return",   6, KW_RETURN   },
+   [KEYWORD_HASH('f', 3)] = { "for",      3, KW_FOR      },
+   [KEYWORD_HASH('p', 8)] = { "parallel", 8, KW_PARALLEL },
+};
+
+#ifdef __SSE2__
+/* bytes of 'chunk' in [low, low + count), by the signed-compare trick */
+static inline __m128i
+in_range(__m128i chunk, int low, int count)
+{
+   return _mm_cmplt_epi8(_mm_add_epi8(chunk,
+                                      _mm_set1_epi8((char) (-128 - low))),
+                         _mm_set1_epi8((char) (-128 + count)));
+}
+
+static inline __m128i
+space_mask(__m128i chunk)
+{
+   __m128i blank, newline, tab, carriage_return;
+
+   blank = _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' '));
+   newline = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'));
+   tab = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'));
+   carriage_return = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r'));
+
+   return _mm_or_si128(_mm_or_si128(blank, newline),
+                       _mm_or_si128(tab, carriage_return));
+}
+
+static inline __m128i
+word_mask(__m128i chunk)
+{
+   /* setting 0x20 folds A-Z onto a-z and moves nothing else there */
+   __m128i lower = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+
+   return _mm_or_si128(_mm_or_si128(in_range(lower, 'a', 26),
+                                    in_range(chunk, '0', 10)),
+                       _mm_cmpeq_epi8(chunk, _mm_set1_epi8('_')));
+}
+#endif
+
+/*
+ * Returns the end of the run of 'class' characters at 'p'. Whole chunks
+ * are only loaded while they lie before 'end'; the tail goes bytewise.
+ */
+static inline const char *
+skip_class(const char *p, const char *end, int class)
+{
+#ifdef __SSE2__
+   __m128i chunk, mask;
+   unsigned bits;
+
+   /* most runs are short: a blank, a one-letter name, a small number */
+   if (p < end && !(classes[(unsigned char) *p] & class))
+      return p;
+   if (p + 1 < end && !(classes[(unsigned char) p[1]] & class))
+      return p + 1;
+
+   while (end - p >= 16) {
+      chunk = _mm_loadu_si128((const __m128i *) p);
+      if (class == CLASS_SPACE)
+         mask = space_mask(chunk);
+      else if (class == CLASS_DIGIT)
+         mask = in_range(chunk, '0', 10);
+      else
+         mask = word_mask(chunk);
+
+      bits = ~_mm_movemask_epi8(mask) & 0xffff;
+      if (bits != 0)
+         return p + __builtin_ctz(bits);
+      p += 16;
+   }
+#endif
+
+   while (p < end && (classes[(unsigned char) *p] & class))
+      p++;
+
+   return p;
+}
+
+/* what atoi() makes of the digits: strtol() clamps, then int truncates */
+static int
+convert_int(const char *p, const char *end)
+{
+   unsigned long value = 0;
+   int digit;
+
+   for (; p < end; p++) {
+      digit = *p - '0';
+      if (value > (unsigned long) (LONG_MAX - digit) / 10)
+         return (int) LONG_MAX;
+      value = value * 10 + digit;
+   }
+
+   return (int) value;
+}
+
+/* rare enough to convert the way the flex scanner does */
+static float
+convert_float(const char *p, const char *end)
+{
+   char small[64], *text = small;
+   size_t length = end - p;
+   float value;
+
+   if (length >= sizeof(small)) {
+      text = malloc(length + 1);
+      if (text == NULL) {
+         fprintf(stderr, "Memory allocation request failed.\n");
+         exit(EXIT_FAILURE);
+      }
+   }
+   memcpy(text, p, length);
+   text[length] = '\0';
+
+   value = (float) atof(text);
+
+   if (text != small)
+      free(text);
+
+   return value;
+}
+
+void
+fastlex_init(struct fastlex *lexer, const char *data, size_t size)
+{
+   lexer->position = data;
+   lexer->end = data + size;
+   lexer->text = data;
+}
+
+static int
+scan_word(struct fastlex *lexer, const char *p, YYSTYPE *value)
+{
+   const struct keyword *keyword;
+   const char *start = p;
+   size_t length;
+
+   p = skip_class(p + 1, lexer->end, CLASS_WORD);
+   length = p - start;
+   lexer->position = p;
+
+   keyword = &keywords[KEYWORD_HASH((unsigned char) *start, length)];
+   if (keyword->length == length && memcmp(keyword->name, start, length) == 0)
+      return keyword->token;
+
+   value->symbol = intern_identifier(start, length);
+   return IDENTIFIER;
+}
+
+static int
+scan_number(struct fastlex *lexer, const char *p, YYSTYPE *value)
+{
+   const char *start = p, *end = lexer->end;
+
+   p = skip_class(p + 1, end, CLASS_DIGIT);
+
+   /* a dot only belongs to the number with a digit after it */
+   if (end - p >= 2 && p[0] == '.' &&
+       (classes[(unsigned char) p[1]] & CLASS_DIGIT)) {
+      p = skip_class(p + 2, end, CLASS_DIGIT);
+      lexer->position = p;
+      value->float_const = convert_float(start, p);
+      return FLOAT_CONSTANT;
+   }
+
+   lexer->position = p;
+   value->int_const = convert_int(start, p);
+   return INT_CONSTANT;
+}
+
+/* 'one', or 'two' when an '=' follows */
+static int
+scan_operator(struct fastlex *lexer, const char *p, int one, int two)
+{
+   if (lexer->end - p >= 2 && p[1] == '=') {
+      lexer->position = p + 2;
+      return two;
+   }
+
+   lexer->position = p + 1;
+   return one;
+}
+
+int
+fastlex_next(struct fastlex *lexer, YYSTYPE *value)
+{
+   const char *p = lexer->position, *end = lexer->end;
+   int token;
+
+   for (;;) {
+      p = skip_class(p, end, CLASS_SPACE);
+      lexer->text = p;
+      if (p == end) {
+         lexer->position = p;
+         return 0;
+      }
+
+      token = 0;
+      switch (*p) {
+         case '+': token = OP_ADD;    break;
+         case '-': token = OP_SUB;    break;
+         case '*': token = OP_MUL;    break;
+         case '/': token = OP_DIV;    break;
+         case ';': token = SEMICOLON; break;
+         case ',': token = COMMA;     break;
+         case '{': token = LBRACE;    break;
+         case '}': token = RBRACE;    break;
+         case '(': token = LPAREN;    break;
+         case ')': token = RPAREN;    break;
+         case '[': token = LBRACKET;  break;
+         case ']': token = RBRACKET;  break;
+         case '>': return scan_operator(lexer, p, OP_GT, OP_GE);
+         case '<': return scan_operator(lexer, p, OP_LT, OP_LE);
+         case '=': return scan_operator(lexer, p, OP_ASSIGN, OP_EQ);
+         case '!':
+            /* a lone '!' is ignored, like every unknown character */
+            token = scan_operator(lexer, p, 0, OP_NE);
+            if (token != 0)
+               return token;
+            p++;
+            continue;
+         default:
+            if (classes[(unsigned char) *p] & CLASS_ALPHA)
+               return scan_word(lexer, p, value);
+            if (classes[(unsigned char) *p] & CLASS_DIGIT)
+               return scan_number(lexer, p, value);
+      }
+
+      p++;
+      if (token != 0) {
+         lexer->position = p;
+         return token;
+      }
+   }
+}
@@ -0,0 +1,31 @@
+#ifndef FASTLEX_H
+#define FASTLEX_H
+
+#include <stddef.h>
+
+#include "parser.tab.h"
+
+/* front ends of --lexer */
+#define LEXER_FLEX   0
+#define LEXER_FAST   1
+
+/*
+ * Hand-written scanner for the tokens of lexer.l, returning the same
+ * tokens and values as the flex scanner. Runs of whitespace, identifier
+ * and number characters are classified 16 bytes at a time with SSE2
+ * compares, keywords are found through a perfect hash, and the input is
+ * only read, never written, so a mapped source stays shared with the
+ * page cache.
+ */
+struct fastlex {
+   const char *position;
+   const char *end;
+   const char *text;       /* start of the last token */
+};
+
+void fastlex_init(struct fastlex *lexer, const char *data, size_t size);
+
+/* returns the next token, or 0 at the end of the input */
+int fastlex_next(struct fastlex *lexer, YYSTYPE *value);
+
+#endif /* FASTLEX_H */
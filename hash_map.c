@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "hash_map.h"
+
+struct hash_map *
+hash_map_create(void)
+{
+   struct hash_map *map;
+
+   map = calloc(1, sizeof(struct hash_map));
+   if (map == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   map->mask = 255;
+   map->keys = calloc(map->mask + 1, sizeof(uint64_t));
+   map->values = calloc(map->mask + 1, sizeof(void *));
+   if (map->keys == NULL || map->values == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   return map;
+}
+
+void
+hash_map_destroy(struct hash_map *map)
+{
+   free(map->keys);
+   free(map->values);
+   free(map);
+}
+
+static uint64_t
+hash_map_slot(struct hash_map *map, uint64_t key)
+{
+   uint64_t slot;
+
+   /* Fibonacci hashing spreads pointers and packed indices alike */
+   slot = (key * 0x9e3779b97f4a7c15ull) >> 20;
+
+   for (slot &= map->mask; map->keys[slot] != 0; slot = (slot + 1) & map->mask)
+      if (map->keys[slot] == key)
+         break;
+
+   return slot;
+}
+
+void *
+hash_map_get(struct hash_map *map, uint64_t key)
+{
+   uint64_t slot = hash_map_slot(map, key);
+
+   return map->keys[slot] == key ? map->values[slot] : NULL;
+}
+
+static void
+hash_map_grow(struct hash_map *map)
+{
+   uint64_t *keys = map->keys;
+   void **values = map->values;
+   uint64_t i, capacity = map->mask + 1;
+
+   map->mask = 2 * capacity - 1;
+   map->count = 0;
+   map->keys = calloc(2 * capacity, sizeof(uint64_t));
+   map->values = calloc(2 * capacity, sizeof(void *));
+   if (map->keys == NULL || map->values == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   for (i = 0; i < capacity; i++)
+      if (keys[i] != 0)
+         hash_map_put(map, keys[i], values[i]);
+
+   free(keys);
+   free(values);
+}
+
+void
+hash_map_put(struct hash_map *map, uint64_t key, void *value)
+{
+   uint64_t slot;
+
+   if (2 * (map->count + 1) > map->mask)
+      hash_map_grow(map);
+
+   slot = hash_map_slot(map, key);
+   if (map->keys[slot] == 0) {
+      map->keys[slot] = key;
+      map->count++;
+   }
+   map->values[slot] = value;
+}
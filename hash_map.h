@@ -0,0 +1,21 @@
+#ifndef HASH_MAP_H
+#define HASH_MAP_H
+
+#include <stdint.h>
+
+/* open-addressing hash map from non-zero 64-bit keys to pointers */
+struct hash_map {
+   uint64_t *keys;
+   void **values;
+   uint64_t mask;
+   uint64_t count;
+};
+
+struct hash_map *hash_map_create(void);
+void hash_map_destroy(struct hash_map *map);
+
+/* returns NULL when 'key' is not present */
+void *hash_map_get(struct hash_map *map, uint64_t key);
+void hash_map_put(struct hash_map *map, uint64_t key, void *value);
+
+#endif /* HASH_MAP_H */
@@ -0,0 +1,146 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "intern.h"
+
+struct intern_pool {
+   struct arena names_arena;
+
+   /* indexed by symbol id */
+   const char **names;
+   uint32_t *hashes;
+   int number_of_symbols;
+   int names_capacity;
+
+   /* open addressing with linear probing; holds symbol id + 1, 0 if empty */
+   int *slots;
+   uint32_t slots_mask;
+};
+
+/* one pool per thread, so that sources can be compiled in parallel */
+static _Thread_local struct intern_pool pool = {
+   .names_arena = { .block_size = 64 * 1024 },
+};
+
+static uint32_t
+hash_name(const char *name, size_t length)
+{
+   uint32_t hash = 2166136261u;
+   size_t i;
+
+   /* FNV-1a */
+   for (i = 0; i < length; i++) {
+      hash ^= (unsigned char) name[i];
+      hash *= 16777619u;
+   }
+
+   return hash;
+}
+
+static void *
+xrealloc(void *ptr, size_t size)
+{
+   ptr = realloc(ptr, size);
+   if (ptr == NULL) {
+      fprintf(stderr, "Memory reallocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   return ptr;
+}
+
+static void
+grow_slots(void)
+{
+   uint32_t capacity, slot;
+   int symbol;
+
+   capacity = pool.slots == NULL ? 1024 : 2 * (pool.slots_mask + 1);
+
+   free(pool.slots);
+   pool.slots = calloc(capacity, sizeof(int));
+   if (pool.slots == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+   pool.slots_mask = capacity - 1;
+
+   for (symbol = 0; symbol < pool.number_of_symbols; symbol++) {
+      slot = pool.hashes[symbol] & pool.slots_mask;
+      while (pool.slots[slot] != 0)
+         slot = (slot + 1) & pool.slots_mask;
+      pool.slots[slot] = symbol + 1;
+   }
+}
+
+int
+intern_identifier(const char *name, size_t length)
+{
+   uint32_t hash, slot;
+   char *copy;
+   int symbol;
+
+   /* keep the load factor at or below 1/2 */
+   if (2 * (uint32_t) pool.number_of_symbols >= pool.slots_mask)
+      grow_slots();
+
+   hash = hash_name(name, length);
+   slot = hash & pool.slots_mask;
+
+   while (pool.slots[slot] != 0) {
+      symbol = pool.slots[slot] - 1;
+      if (pool.hashes[symbol] == hash &&
+          strncmp(pool.names[symbol], name, length) == 0 &&
+          pool.names[symbol][length] == '\0')
+         return symbol;
+
+      slot = (slot + 1) & pool.slots_mask;
+   }
+
+   if (pool.number_of_symbols == pool.names_capacity) {
+      pool.names_capacity = pool.names_capacity ? 2 * pool.names_capacity
+                                                : 1024;
+      pool.names = xrealloc(pool.names,
+                            pool.names_capacity * sizeof(const char *));
+      pool.hashes = xrealloc(pool.hashes,
+                             pool.names_capacity * sizeof(uint32_t));
+   }
+
+   copy = arena_alloc(&pool.names_arena, length + 1);
+   memcpy(copy, name, length);
+
+   symbol = pool.number_of_symbols++;
+   pool.names[symbol] = copy;
+   pool.hashes[symbol] = hash;
+   pool.slots[slot] = symbol + 1;
+
+   return symbol;
+}
+
+const char *
+intern_get_name(int symbol)
+{
+   return pool.names[symbol];
+}
+
+int
+intern_number_of_symbols(void)
+{
+   return pool.number_of_symbols;
+}
+
+struct intern_pool *
+intern_lend(void)
+{
+   return &pool;
+}
+
+/* a copy of the lender's: only the names are shared, and only read */
+void
+intern_borrow(struct intern_pool *lent)
+{
+   pool = *lent;
+}
@@ -0,0 +1,30 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+
+/*
+ * Identifier interning: every distinct name is stored once and mapped to
+ * a dense symbol id (0, 1, 2, ...) that the symbol table indexes by.
+ *
+ * Each thread has a pool of its own; ids are only meaningful on the
+ * thread that interned them, which is the one compiling the source.
+ */
+int intern_identifier(const char *name, size_t length);
+
+const char *intern_get_name(int symbol);
+
+int intern_number_of_symbols(void);
+
+/*
+ * Lends the names of the calling thread's pool to another thread, which
+ * looks them up after intern_borrow(); neither thread may intern a new
+ * name from then on. This is how tier.c lowers the tree on a thread of
+ * its own.
+ */
+struct intern_pool;
+
+struct intern_pool *intern_lend(void);
+void intern_borrow(struct intern_pool *lent);
+
+#endif /* INTERN_H */
@@ -0,0 +1,344 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bytecode.h"
+#include "interp.h"
+#include "tier.h"
+
+/* the frames of all active calls share one register stack */
+#define INTERP_STACK_REGISTERS   (1 << 20)
+#define INTERP_MAX_CALL_DEPTH    (1 << 17)
+
+union interp_value {
+   int32_t i;
+   float f;
+};
+
+struct interp_array {
+   int32_t length;
+   union interp_value elements[];
+};
+
+union interp_register {
+   int32_t i;
+   float f;
+   struct interp_array *array;
+};
+
+struct interp_frame {
+   const struct bc_instruction *call;     /* returns past it */
+   union interp_register *registers;
+   uint32_t arrays;                       /* allocated before the call */
+};
+
+/*
+ * Every array allocated and not yet freed, in order: a block or a call
+ * frees the ones it allocated by going back to a mark.
+ */
+struct interp_arrays {
+   struct interp_array **arrays;
+   uint32_t number_of_arrays;
+   uint32_t capacity;
+};
+
+static void
+interp_error(const char *message)
+{
+   fprintf(stderr, "interp: %s\n", message);
+   exit(EXIT_FAILURE);
+}
+
+static struct interp_array *
+allocate_array(struct interp_arrays *arrays, int32_t length)
+{
+   struct interp_array *array;
+
+   if (length < 0)
+      interp_error("negative array size");
+
+   if (arrays->number_of_arrays == arrays->capacity) {
+      arrays->capacity = arrays->capacity ? 2 * arrays->capacity : 64;
+      arrays->arrays = realloc(arrays->arrays, arrays->capacity *
+                               sizeof(struct interp_array *));
+      if (arrays->arrays == NULL) {
+         fprintf(stderr, "Memory reallocation request failed.\n");
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   array = calloc(1, sizeof(struct interp_array) +
+                     (size_t) length * sizeof(union interp_value));
+   if (array == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   array->length = length;
+   arrays->arrays[arrays->number_of_arrays++] = array;
+
+   return array;
+}
+
+static void
+free_arrays(struct interp_arrays *arrays, uint32_t mark)
+{
+   while (arrays->number_of_arrays > mark)
+      free(arrays->arrays[--arrays->number_of_arrays]);
+}
+
+/* dispatch is a computed goto on the opcode, one per handler */
+#define DISPATCH()   goto *handlers[pc->opcode]
+#define NEXT()       do { pc++; DISPATCH(); } while (0)
+
+#define R(x)         registers[pc->x]
+
+/* int arithmetic wraps, as in the IR */
+#define INT_OP(op)   R(a).i = (int32_t) ((uint32_t) R(b).i op (uint32_t) R(c).i)
+
+#define CHECK_INDEX(array, index)                                       \
+   if ((uint32_t) (index) >= (uint32_t) (array)->length)                \
+      interp_error("array index out of bounds")
+
+/*
+ * A hot loop goes native at its back edge, which is where the native
+ * loop would test the condition next: its variables go to the state and
+ * come back from it, and the interpreter carries on past the loop.
+ */
+static void
+run_native_loop(struct bytecode *bytecode, uint32_t loop,
+                tier_loop_function *native, union interp_register *registers,
+                union tier_slot *state)
+{
+   struct bc_loop *bc_loop = &bytecode->loops[loop];
+   struct bc_loop_variable *variables, *variable;
+   union tier_slot *slot = state;
+   uint32_t i;
+
+   variables = bytecode->loop_variables + bc_loop->first_variable;
+   for (i = 0; i < bc_loop->number_of_variables; i++) {
+      variable = &variables[i];
+      if (variable->array) {
+         slot++->pointer = registers[variable->reg].array->elements;
+         slot++->value = registers[variable->reg].array->length;
+      } else {
+         slot++->value = registers[variable->reg].i;
+      }
+   }
+
+   native(state);
+
+   slot = state;
+   for (i = 0; i < bc_loop->number_of_variables; i++) {
+      variable = &variables[i];
+      if (variable->array)
+         slot += 2;
+      else
+         registers[variable->reg].i = slot++->value;
+   }
+}
+
+static void
+execute(struct bytecode *bytecode, struct tier *tier,
+        union interp_register *stack, struct interp_frame *frames,
+        uint32_t *counters, union tier_slot *state)
+{
+   static const void *handlers[BC_NUMBER_OF_OPCODES] = {
+      [BC_MOVE] = &&move,
+      [BC_LOAD_CONSTANT] = &&load_constant,
+      [BC_ADD_INT] = &&add_int,        [BC_ADD_FLOAT] = &&add_float,
+      [BC_SUB_INT] = &&sub_int,        [BC_SUB_FLOAT] = &&sub_float,
+      [BC_MUL_INT] = &&mul_int,        [BC_MUL_FLOAT] = &&mul_float,
+      [BC_DIV_INT] = &&div_int,        [BC_DIV_FLOAT] = &&div_float,
+      [BC_GT_INT] = &&gt_int,          [BC_GT_FLOAT] = &&gt_float,
+      [BC_LT_INT] = &&lt_int,          [BC_LT_FLOAT] = &&lt_float,
+      [BC_EQ_INT] = &&eq_int,          [BC_EQ_FLOAT] = &&eq_float,
+      [BC_NE_INT] = &&ne_int,          [BC_NE_FLOAT] = &&ne_float,
+      [BC_LE_INT] = &&le_int,          [BC_LE_FLOAT] = &&le_float,
+      [BC_GE_INT] = &&ge_int,          [BC_GE_FLOAT] = &&ge_float,
+      [BC_UNLESS_GT_INT] = &&unless_gt_int,
+      [BC_UNLESS_LT_INT] = &&unless_lt_int,
+      [BC_UNLESS_EQ_INT] = &&unless_eq_int,
+      [BC_UNLESS_NE_INT] = &&unless_ne_int,
+      [BC_UNLESS_LE_INT] = &&unless_le_int,
+      [BC_UNLESS_GE_INT] = &&unless_ge_int,
+      [BC_UNLESS_GT_FLOAT] = &&unless_gt_float,
+      [BC_UNLESS_LT_FLOAT] = &&unless_lt_float,
+      [BC_UNLESS_EQ_FLOAT] = &&unless_eq_float,
+      [BC_UNLESS_NE_FLOAT] = &&unless_ne_float,
+      [BC_UNLESS_LE_FLOAT] = &&unless_le_float,
+      [BC_UNLESS_GE_FLOAT] = &&unless_ge_float,
+      [BC_INT_TO_FLOAT] = &&int_to_float,
+      [BC_FLOAT_TO_INT] = &&float_to_int,
+      [BC_JUMP] = &&jump,
+      [BC_NEW_ARRAY] = &&new_array,
+      [BC_LOAD_ELEMENT] = &&load_element,
+      [BC_STORE_ELEMENT] = &&store_element,
+      [BC_SAVE_ARRAYS] = &&save_arrays,
+      [BC_RESTORE_ARRAYS] = &&restore_arrays,
+      [BC_CALL] = &&call,
+      [BC_RETURN] = &&return_,
+      [BC_HALT] = &&halt,
+      [BC_LOOP] = &&loop,
+   };
+   const struct bc_instruction *code = bytecode->code, *pc = code;
+   const struct bc_function *function;
+   union interp_register *registers = stack, value;
+   union interp_register *stack_end = stack + INTERP_STACK_REGISTERS;
+   struct interp_frame *frame = frames;
+   struct interp_arrays arrays = { NULL, 0, 0 };
+   struct interp_array *array;
+   tier_loop_function *native;
+   uint32_t loop;
+
+   DISPATCH();
+
+move:          R(a) = R(b); NEXT();
+load_constant: R(a).i = pc->k; NEXT();
+
+add_int:       INT_OP(+); NEXT();
+sub_int:       INT_OP(-); NEXT();
+mul_int:       INT_OP(*); NEXT();
+div_int:       R(a).i = R(b).i / R(c).i; NEXT();
+add_float:     R(a).f = R(b).f + R(c).f; NEXT();
+sub_float:     R(a).f = R(b).f - R(c).f; NEXT();
+mul_float:     R(a).f = R(b).f * R(c).f; NEXT();
+div_float:     R(a).f = R(b).f / R(c).f; NEXT();
+
+/* float comparisons are ordered, as in vm_value.c: false on a NaN */
+gt_int:        R(a).i = R(b).i > R(c).i; NEXT();
+lt_int:        R(a).i = R(b).i < R(c).i; NEXT();
+eq_int:        R(a).i = R(b).i == R(c).i; NEXT();
+ne_int:        R(a).i = R(b).i != R(c).i; NEXT();
+le_int:        R(a).i = R(b).i <= R(c).i; NEXT();
+ge_int:        R(a).i = R(b).i >= R(c).i; NEXT();
+gt_float:      R(a).i = R(b).f > R(c).f; NEXT();
+lt_float:      R(a).i = R(b).f < R(c).f; NEXT();
+eq_float:      R(a).i = R(b).f == R(c).f; NEXT();
+ne_float:      R(a).i = R(b).f < R(c).f || R(b).f > R(c).f; NEXT();
+le_float:      R(a).i = R(b).f <= R(c).f; NEXT();
+ge_float:      R(a).i = R(b).f >= R(c).f; NEXT();
+
+#define UNLESS(condition)                                               \
+   if (condition)                                                       \
+      NEXT();                                                           \
+   pc = code + pc->k;                                                   \
+   DISPATCH()
+
+unless_gt_int:    UNLESS(R(b).i > R(c).i);
+unless_lt_int:    UNLESS(R(b).i < R(c).i);
+unless_eq_int:    UNLESS(R(b).i == R(c).i);
+unless_ne_int:    UNLESS(R(b).i != R(c).i);
+unless_le_int:    UNLESS(R(b).i <= R(c).i);
+unless_ge_int:    UNLESS(R(b).i >= R(c).i);
+unless_gt_float:  UNLESS(R(b).f > R(c).f);
+unless_lt_float:  UNLESS(R(b).f < R(c).f);
+unless_eq_float:  UNLESS(R(b).f == R(c).f);
+unless_ne_float:  UNLESS(R(b).f < R(c).f || R(b).f > R(c).f);
+unless_le_float:  UNLESS(R(b).f <= R(c).f);
+unless_ge_float:  UNLESS(R(b).f >= R(c).f);
+
+int_to_float:  R(a).f = (float) R(b).i; NEXT();
+float_to_int:  R(a).i = (int32_t) R(b).f; NEXT();
+
+jump:
+   pc = code + pc->k;
+   DISPATCH();
+
+new_array:
+   R(a).array = allocate_array(&arrays, R(b).i);
+   NEXT();
+
+load_element:
+   array = R(b).array;
+   CHECK_INDEX(array, R(c).i);
+   R(a).i = array->elements[R(c).i].i;
+   NEXT();
+
+store_element:
+   array = R(b).array;
+   CHECK_INDEX(array, R(c).i);
+   array->elements[R(c).i].i = R(a).i;
+   NEXT();
+
+save_arrays:
+   R(a).i = arrays.number_of_arrays;
+   NEXT();
+
+restore_arrays:
+   free_arrays(&arrays, R(a).i);
+   NEXT();
+
+call:
+   function = &bytecode->functions[pc->k];
+   if (frame == frames + INTERP_MAX_CALL_DEPTH ||
+       registers + pc->b + function->number_of_registers > stack_end)
+      interp_error("stack overflow");
+
+   frame->call = pc;
+   frame->registers = registers;
+   frame->arrays = arrays.number_of_arrays;
+   frame++;
+
+   registers += pc->b;
+   pc = code + function->entry;
+   DISPATCH();
+
+/* a hot loop asks for native code at every back edge, until it gets some */
+loop:
+   loop = pc->a | (uint32_t) pc->b << 16;
+   if (counters[loop] < TIER_HOT_BACK_EDGES) {
+      counters[loop]++;
+      pc = code + pc->k;
+      DISPATCH();
+   }
+
+   native = tier_loop(tier, loop);
+   if (native == NULL) {
+      pc = code + pc->k;
+      DISPATCH();
+   }
+
+   run_native_loop(bytecode, loop, native, registers, state);
+   pc = code + bytecode->loops[loop].exit;
+   DISPATCH();
+
+/* the arrays the callee allocated go with it */
+return_:
+   value = R(a);
+   frame--;
+   free_arrays(&arrays, frame->arrays);
+   registers = frame->registers;
+   pc = frame->call;
+   R(a) = value;
+   NEXT();
+
+halt:
+   free_arrays(&arrays, 0);
+   free(arrays.arrays);
+}
+
+void
+interp_run(struct bytecode *bytecode, struct tier *tier)
+{
+   union interp_register *stack;
+   struct interp_frame *frames;
+   uint32_t *counters;
+   union tier_slot *state;
+
+   stack = malloc(INTERP_STACK_REGISTERS * sizeof(union interp_register));
+   frames = malloc(INTERP_MAX_CALL_DEPTH * sizeof(struct interp_frame));
+   counters = calloc(bytecode->number_of_loops + 1, sizeof(uint32_t));
+   state = malloc((bytecode->max_loop_slots + 1) * sizeof(union tier_slot));
+   if (stack == NULL || frames == NULL || counters == NULL || state == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   execute(bytecode, tier, stack, frames, counters, state);
+
+   free(state);
+   free(counters);
+   free(frames);
+   free(stack);
+}
@@ -0,0 +1,15 @@
+#ifndef INTERP_H
+#define INTERP_H
+
+#include "bytecode.h"
+#include "tier.h"
+
+/*
+ * Runs a finished program, see bytecode.h. A failed bounds check, a
+ * negative array size or a call stack too deep ends the process. 'tier'
+ * is where the hot loops of a program compiled for tiering get their
+ * native code, NULL for any other program.
+ */
+void interp_run(struct bytecode *bytecode, struct tier *tier);
+
+#endif /* INTERP_H */
@@ -0,0 +1,153 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <llvm-c/Error.h>
+
+#include "jit.h"
+#include "parallel.h"
+#include "report.h"
+#include "target.h"
+#include "timer.h"
+
+static void
+jit_check_error(LLVMErrorRef error, const char *what)
+{
+   char *message;
+
+   if (error == NULL)
+      return;
+
+   message = LLVMGetErrorMessage(error);
+   fprintf(stderr, "JIT error while %s: %s\n", what, message);
+   LLVMDisposeErrorMessage(message);
+   exit(EXIT_FAILURE);
+}
+
+/*
+ * The runtime the generated code calls, which is part of the compiler
+ * rather than exported by it: it is defined in the jit by address.
+ */
+static void
+define_runtime(struct jit *jit)
+{
+   LLVMJITCSymbolMapPair runtime[1];
+
+   runtime[0].Name = LLVMOrcLLJITMangleAndIntern(jit->lljit, PARALLEL_FOR);
+   runtime[0].Sym.Address = (LLVMOrcExecutorAddress) (uintptr_t)
+                            toy_parallel_for;
+   runtime[0].Sym.Flags.GenericFlags = LLVMJITSymbolGenericFlagsExported |
+                                       LLVMJITSymbolGenericFlagsCallable;
+   runtime[0].Sym.Flags.TargetFlags = 0;
+
+   jit_check_error(LLVMOrcJITDylibDefine(
+                      LLVMOrcLLJITGetMainJITDylib(jit->lljit),
+                      LLVMOrcAbsoluteSymbols(runtime, 1)),
+                   "defining the runtime");
+}
+
+struct jit *
+jit_create(LLVMTargetMachineRef machine)
+{
+   LLVMOrcDefinitionGeneratorRef generator;
+   LLVMOrcLLJITBuilderRef builder;
+   struct jit *jit;
+
+   jit = calloc(1, sizeof(struct jit));
+   if (jit == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   target_initialize();
+
+   builder = NULL;
+   if (machine != NULL) {
+      builder = LLVMOrcCreateLLJITBuilder();
+      LLVMOrcLLJITBuilderSetJITTargetMachineBuilder(builder,
+            LLVMOrcJITTargetMachineBuilderCreateFromTargetMachine(machine));
+   }
+
+   jit_check_error(LLVMOrcCreateLLJIT(&jit->lljit, builder),
+                   "creating LLJIT");
+
+   /* intrinsics such as llvm.memset may be lowered to libc calls */
+   jit_check_error(LLVMOrcCreateDynamicLibrarySearchGeneratorForProcess(
+                      &generator, LLVMOrcLLJITGetGlobalPrefix(jit->lljit),
+                      NULL, NULL),
+                   "searching the process for symbols");
+   LLVMOrcJITDylibAddGenerator(LLVMOrcLLJITGetMainJITDylib(jit->lljit),
+                               generator);
+   define_runtime(jit);
+   jit->tsc = LLVMOrcCreateNewThreadSafeContext();
+
+   return jit;
+}
+
+void
+jit_destroy(struct jit *jit)
+{
+   jit_check_error(LLVMOrcDisposeLLJIT(jit->lljit), "disposing LLJIT");
+   LLVMOrcDisposeThreadSafeContext(jit->tsc);
+   free(jit);
+}
+
+void
+jit_add_module(struct jit *jit, LLVMModuleRef module)
+{
+   LLVMOrcThreadSafeModuleRef tsm;
+   LLVMOrcJITDylibRef dylib;
+
+   /*
+    * The module keeps the context it was built in rather than the one
+    * owned by jit->tsc, so that lock does not cover it. Compilation runs
+    * on the thread that calls jit_lookup(), and no other thread may use
+    * the module's context until that lookup returns.
+    */
+   tsm = LLVMOrcCreateNewThreadSafeModule(module, jit->tsc);
+   dylib = LLVMOrcLLJITGetMainJITDylib(jit->lljit);
+
+   jit_check_error(LLVMOrcLLJITAddLLVMIRModule(jit->lljit, dylib, tsm),
+                   "adding module");
+}
+
+void *
+jit_lookup(struct jit *jit, const char *name)
+{
+   LLVMOrcExecutorAddress address;
+
+   jit_check_error(LLVMOrcLLJITLookup(jit->lljit, &address, name),
+                   "looking up symbol");
+
+   return (void *) (uintptr_t) address;
+}
+
+void
+jit_run_module(LLVMModuleRef module, struct time_report *report)
+{
+   struct jit *jit;
+   void (*main_function)(void);
+   double start, setup_ms, compile_ms, execute_ms;
+
+   start = timer_now();
+   jit = jit_create(NULL);
+   jit_add_module(jit, module);
+   setup_ms = timer_elapsed_ms(start);
+
+   /* materialization (and thus compilation) happens on first lookup */
+   start = timer_now();
+   main_function = (void (*)(void)) jit_lookup(jit, "main");
+   compile_ms = timer_elapsed_ms(start);
+
+   start = timer_now();
+   main_function();
+   execute_ms = timer_elapsed_ms(start);
+
+   jit_destroy(jit);
+
+   if (report != NULL) {
+      report->jit_setup_ms += setup_ms;
+      report->jit_compile_ms += compile_ms;
+      report->jit_execute_ms += execute_ms;
+   }
+}
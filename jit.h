@@ -0,0 +1,33 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <llvm-c/Core.h>
+#include <llvm-c/LLJIT.h>
+#include <llvm-c/TargetMachine.h>
+
+struct time_report;
+
+struct jit {
+   LLVMOrcLLJITRef lljit;
+   LLVMOrcThreadSafeContextRef tsc;
+};
+
+/*
+ * Everything added is compiled for 'machine', of which the jit takes
+ * ownership; NULL picks the host at the default optimization level.
+ */
+struct jit *jit_create(LLVMTargetMachineRef machine);
+void jit_destroy(struct jit *jit);
+
+/* hands ownership of 'module' over to the jit */
+void jit_add_module(struct jit *jit, LLVMModuleRef module);
+
+void *jit_lookup(struct jit *jit, const char *name);
+
+/*
+ * Jit-compiles 'module', runs its main function and disposes of it,
+ * adding the time of each step to 'report' unless it is NULL.
+ */
+void jit_run_module(LLVMModuleRef module, struct time_report *report);
+
+#endif /* JIT_H */
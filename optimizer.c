@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <llvm-c/Error.h>
+#include <llvm-c/Transforms/PassBuilder.h>
+
+#include "optimizer.h"
+#include "target.h"
+
+void
+optimize_module_for_machine(LLVMModuleRef module,
+                            LLVMTargetMachineRef machine, int opt_level)
+{
+   LLVMPassBuilderOptionsRef options;
+   LLVMErrorRef error;
+   char pipeline[32];
+
+   if (opt_level <= 0)
+      return;
+   if (opt_level > 3)
+      opt_level = 3;
+
+   target_machine_configure_module(machine, module);
+
+   options = LLVMCreatePassBuilderOptions();
+   LLVMPassBuilderOptionsSetLoopUnrolling(options, opt_level >= 2);
+   LLVMPassBuilderOptionsSetLoopInterleaving(options, opt_level >= 2);
+   LLVMPassBuilderOptionsSetLoopVectorization(options, opt_level >= 2);
+   LLVMPassBuilderOptionsSetSLPVectorization(options, opt_level >= 2);
+
+   snprintf(pipeline, sizeof(pipeline), "default<O%d>", opt_level);
+
+   error = LLVMRunPasses(module, pipeline, machine, options);
+   if (error != NULL) {
+      char *message = LLVMGetErrorMessage(error);
+      fprintf(stderr, "Failed to run %s pipeline: %s\n", pipeline, message);
+      LLVMDisposeErrorMessage(message);
+      exit(EXIT_FAILURE);
+   }
+
+   LLVMDisposePassBuilderOptions(options);
+}
+
+void
+optimize_module(LLVMModuleRef module, int opt_level)
+{
+   LLVMTargetMachineRef machine;
+
+   if (opt_level <= 0)
+      return;
+   if (opt_level > 3)
+      opt_level = 3;
+
+   /* the vectorizer and unroller need the host's cost model */
+   machine = target_machine_create_host(opt_level);
+   optimize_module_for_machine(module, machine, opt_level);
+   LLVMDisposeTargetMachine(machine);
+}
@@ -0,0 +1,19 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <llvm-c/Core.h>
+#include <llvm-c/TargetMachine.h>
+
+/*
+ * Runs the standard -O<opt_level> pipeline (mem2reg/SROA, inliner,
+ * instcombine, GVN, LICM, loop rotation/unrolling, loop vectorizer, ...)
+ * on 'module'.
+ * Level 0 leaves the module untouched.
+ */
+void optimize_module(LLVMModuleRef module, int opt_level);
+
+/* same, with a host target machine the caller keeps around */
+void optimize_module_for_machine(LLVMModuleRef module,
+                                 LLVMTargetMachineRef machine, int opt_level);
+
+#endif /* OPTIMIZER_H */
@@ -0,0 +1,223 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "parallel.h"
+
+/*
+ * What is left of a worker's share, as offsets from the lower bound:
+ * begin | end << 32. The worker takes chunks off the front and thieves
+ * take halves off the back, each with one compare-and-swap; a range
+ * never comes back once its first iteration is taken, so there is no
+ * ABA to fear.
+ */
+#define RANGE(begin, end)     ((uint64_t) (end) << 32 | (begin))
+#define RANGE_BEGIN(range)    ((uint32_t) (range))
+#define RANGE_END(range)      ((uint32_t) ((range) >> 32))
+
+/* a cache line each, as every thief reads them all */
+struct parallel_worker {
+   _Alignas(64) _Atomic uint64_t range;
+   pthread_t thread;
+};
+
+struct parallel_pool {
+   struct parallel_worker workers[PARALLEL_MAX_WORKERS];
+   int number_of_workers;
+
+   /* one loop at a time, whatever the threads calling */
+   pthread_mutex_t loop;
+
+   /* the loop being run, published under 'lock' with a new generation */
+   pthread_mutex_t lock;
+   pthread_cond_t start;
+   pthread_cond_t done;
+   uint64_t generation;
+   parallel_body *body;
+   int64_t *context;
+   int32_t lower;
+   uint32_t grain;         /* iterations in a chunk */
+   int running;            /* workers not done with the loop yet */
+};
+
+static struct parallel_pool pool;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+/* set on the workers, and on a caller while its loop runs */
+static _Thread_local int in_parallel_for;
+
+/* the next chunk of worker 'self's own range, or 0 if it is empty */
+static int
+take_chunk(int self, uint32_t *begin, uint32_t *end)
+{
+   _Atomic uint64_t *range = &pool.workers[self].range;
+   uint64_t value = atomic_load(range);
+
+   do {
+      *begin = RANGE_BEGIN(value);
+      if (*begin >= RANGE_END(value))
+         return 0;
+      *end = RANGE_END(value) - *begin > pool.grain ? *begin + pool.grain
+                                                    : RANGE_END(value);
+   } while (!atomic_compare_exchange_weak(range, &value,
+                                          RANGE(*end, RANGE_END(value))));
+
+   return 1;
+}
+
+/*
+ * Moves the back half of another worker's range, or the last iteration
+ * of one, to worker 'self', whose range is empty: no thief touches it
+ * meanwhile. Returns 0 once there is nothing left to steal.
+ */
+static int
+steal(int self)
+{
+   _Atomic uint64_t *range;
+   uint64_t value;
+   uint32_t begin, middle, end;
+   int i;
+
+   for (i = 1; i < pool.number_of_workers; i++) {
+      range = &pool.workers[(self + i) % pool.number_of_workers].range;
+      value = atomic_load(range);
+
+      while ((begin = RANGE_BEGIN(value)) < (end = RANGE_END(value))) {
+         middle = begin + (end - begin) / 2;
+         if (atomic_compare_exchange_weak(range, &value,
+                                          RANGE(begin, middle))) {
+            atomic_store(&pool.workers[self].range, RANGE(middle, end));
+            return 1;
+         }
+      }
+   }
+
+   return 0;
+}
+
+static void
+run_worker(int self)
+{
+   uint32_t begin, end;
+
+   do {
+      while (take_chunk(self, &begin, &end))
+         pool.body(pool.context, (int32_t) ((int64_t) pool.lower + begin),
+                   (int32_t) ((int64_t) pool.lower + end));
+   } while (steal(self));
+}
+
+static void *
+worker_main(void *arg)
+{
+   int self = (int) (intptr_t) arg;
+   uint64_t generation = 0;
+
+   in_parallel_for = 1;
+   for (;;) {
+      pthread_mutex_lock(&pool.lock);
+      while (pool.generation == generation)
+         pthread_cond_wait(&pool.start, &pool.lock);
+      generation = pool.generation;
+      pthread_mutex_unlock(&pool.lock);
+
+      run_worker(self);
+
+      pthread_mutex_lock(&pool.lock);
+      if (--pool.running == 0)
+         pthread_cond_signal(&pool.done);
+      pthread_mutex_unlock(&pool.lock);
+   }
+
+   return NULL;
+}
+
+static void
+pool_create(void)
+{
+   const char *threads = getenv("TOY_THREADS");
+   long n;
+   int i;
+
+   n = threads != NULL ? atol(threads) : sysconf(_SC_NPROCESSORS_ONLN);
+   if (n < 1)
+      n = 1;
+   if (n > PARALLEL_MAX_WORKERS)
+      n = PARALLEL_MAX_WORKERS;
+   pool.number_of_workers = n;
+
+   pthread_mutex_init(&pool.loop, NULL);
+   pthread_mutex_init(&pool.lock, NULL);
+   pthread_cond_init(&pool.start, NULL);
+   pthread_cond_init(&pool.done, NULL);
+
+   /* worker 0 is whoever calls */
+   for (i = 1; i < n; i++) {
+      if (pthread_create(&pool.workers[i].thread, NULL, worker_main,
+                         (void *) (intptr_t) i) != 0) {
+         fprintf(stderr, "parallel: unable to start a worker thread\n");
+         exit(EXIT_FAILURE);
+      }
+      pthread_detach(pool.workers[i].thread);
+   }
+}
+
+int
+toy_in_parallel_for(void)
+{
+   return in_parallel_for;
+}
+
+void
+toy_parallel_for(parallel_body *body, int64_t *context, int32_t lower,
+                 int32_t upper)
+{
+   uint32_t count;
+   int i, n;
+
+   if (lower >= upper)
+      return;
+
+   pthread_once(&pool_once, pool_create);
+   count = (uint32_t) ((int64_t) upper - lower);
+   n = pool.number_of_workers;
+
+   if (in_parallel_for || n == 1 || count == 1) {
+      body(context, lower, upper);
+      return;
+   }
+
+   pthread_mutex_lock(&pool.loop);
+   in_parallel_for = 1;
+
+   for (i = 0; i < n; i++)
+      atomic_store(&pool.workers[i].range,
+                   RANGE((uint64_t) count * i / n,
+                         (uint64_t) count * (i + 1) / n));
+
+   pthread_mutex_lock(&pool.lock);
+   pool.body = body;
+   pool.context = context;
+   pool.lower = lower;
+   pool.grain = count / ((uint32_t) n * PARALLEL_CHUNKS);
+   if (pool.grain == 0)
+      pool.grain = 1;
+   pool.running = n;
+   pool.generation++;
+   pthread_cond_broadcast(&pool.start);
+   pthread_mutex_unlock(&pool.lock);
+
+   run_worker(0);
+
+   pthread_mutex_lock(&pool.lock);
+   pool.running--;
+   while (pool.running > 0)
+      pthread_cond_wait(&pool.done, &pool.lock);
+   pthread_mutex_unlock(&pool.lock);
+
+   in_parallel_for = 0;
+   pthread_mutex_unlock(&pool.loop);
+}
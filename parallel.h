@@ -0,0 +1,42 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdint.h>
+
+/*
+ * The runtime of parallel for: a small work-stealing thread pool that
+ * comes with the compiler. Jit-compiled code finds it through
+ * jit_create(); an object written by --emit=obj links with parallel.c
+ * and -lpthread.
+ *
+ * Codegen builds the body of a parallel for into a function running the
+ * iterations [lower, upper) it is given, see driver.c. The iterations
+ * are split evenly among the workers, each of which runs its share a
+ * chunk at a time from the front; a worker out of work steals the back
+ * half of what is left of another's. The calling thread is a worker as
+ * well, and returns once every iteration has run. A parallel for run
+ * from within one runs serially, on the worker it is on.
+ *
+ * There is a worker per online CPU, or TOY_THREADS of them. They are
+ * started by the first parallel for and last as long as the process.
+ */
+#define PARALLEL_FOR          "toy_parallel_for"
+
+#define PARALLEL_MAX_WORKERS  64
+
+/* chunks a share is cut into, so that a thief finds some left */
+#define PARALLEL_CHUNKS       8
+
+/*
+ * 'context' holds what the body refers to from outside the loop, as
+ * codegen laid it out; the runtime only hands it on.
+ */
+typedef void parallel_body(int64_t *context, int32_t lower, int32_t upper);
+
+void toy_parallel_for(parallel_body *body, int64_t *context, int32_t lower,
+                      int32_t upper);
+
+/* whether the calling thread takes part in a parallel for on the pool */
+int toy_in_parallel_for(void);
+
+#endif /* PARALLEL_H */
@@ -2,28 +2,59 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "ast.h"
+#include "batch.h"
+#include "cache.h"
 #include "driver.h"
+#include "emit.h"
+#include "fastlex.h"
+#include "interp.h"
+#include "profile.h"
+#include "repl.h"
+#include "source.h"
+#include "timer.h"
 
-void yyerror(char *s);
+void yyerror(struct driver *driver, struct ast *ast, char *s);
 
 %}
 
+%code requires {
+#include "ast.h"
+struct driver;
+}
+
+%code {
+/* from the reentrant scanner, see lexer.l */
+typedef void *yyscan_t;
+
+int yylex_init(yyscan_t *scanner);
+int yylex_destroy(yyscan_t scanner);
+void yyset_in(FILE *input, yyscan_t scanner);
+struct yy_buffer_state *yy_scan_buffer(char *base, size_t size,
+                                       yyscan_t scanner);
+char *yyget_text(yyscan_t scanner);
+int yylex(YYSTYPE *value, yyscan_t scanner);
+}
+
+ /* no globals; parse_tokens() feeds the tokens */
+%define api.pure full
+%define api.push-pull push
+
+%parse-param { struct driver *driver }
+%parse-param { struct ast *ast }
+
 %union {
    int int_const;
    float float_const;
 
    int type_specifier;
-   char *identifier;
+   int symbol;
 
-   struct ast_node *node;
-   struct ast_declaration *declaration;
-   struct ast_expression *expression;
-   struct ast_statement_list *statement_list;
-   struct ast_selection_statement *selection_statement;
-   struct ast_while_statement *while_statement;
-   struct ast_compound_statement *compound_statement;
-   struct ast_translation_unit *translation_unit;
+   ast_index index;                 /* of a node in its kind's array */
+   ast_ref statement;
+   uint32_t number_of_statements;   /* pending statement list */
+   uint32_t number_of_parameters;   /* the last declarations created */
 }
 
  /* math operators */
@@ -39,11 +70,16 @@ void yyerror(char *s);
  /* statement terminator */
 %token   SEMICOLON
 
+ /* parameter and argument separator */
+%token   COMMA
+
  /* grouping symbols */
 %token   LBRACE
 %token   RBRACE
 %token   LPAREN
 %token   RPAREN
+%token   LBRACKET
+%token   RBRACKET
 
  /* keywords */
 %token   KW_INT
@@ -51,32 +87,84 @@ void yyerror(char *s);
 %token   KW_IF
 %token   KW_ELSE
 %token   KW_WHILE
+%token   KW_RETURN
+%token   KW_FOR
+%token   KW_PARALLEL
 
  /* integer and floating constants */
 %token <int_const>      INT_CONSTANT
 %token <float_const>    FLOAT_CONSTANT
 
  /* identifier's name */
-%token <identifier>     IDENTIFIER
+%token <symbol>         IDENTIFIER
 
  /* rule types */
 %type <type_specifier>       type_specifier
-%type <expression>           primary_expression expression assignment
-%type <declaration>          declaration
-%type <node>                 statement
-%type <statement_list>       statement_list
-%type <compound_statement>   compound_statement
-%type <selection_statement>  selection_statement selection_rest_statement
-%type <while_statement>      while_statement
-%type <translation_unit>     translation_unit
+%type <index>                primary_expression expression assignment
+%type <index>                declaration
+%type <statement>            statement top_level_statement
+%type <number_of_statements> statement_list
+%type <index>                compound_statement
+%type <index>                selection_statement selection_rest_statement
+%type <index>                while_statement for_statement
+%type <index>                function_definition function_head
+%type <index>                parameter argument_list
+%type <number_of_parameters> parameter_list
 
 %%
 
  /* rule that matches a translation unit (aka. a source file) */
-translation_unit: statement_list {
-   $$ = create_translation_unit($1);
-   // print_node((struct ast_node *) $$);
-   ast_to_llvm($$);
+translation_unit: top_level_statement_list {
+   driver_finish(driver);
+}
+;
+
+ /* each top-level statement goes to the driver as soon as it is parsed */
+top_level_statement_list: top_level_statement {
+   driver_add_statement(driver, $1);
+}
+| top_level_statement_list top_level_statement {
+   driver_add_statement(driver, $2);
+}
+;
+
+ /* functions are only defined at the top level */
+top_level_statement: statement {
+   $$ = $1;
+}
+| function_definition {
+   $$ = AST_REF(AST_FUNCTION_DEFINITION, $1);
+}
+;
+
+function_definition: function_head compound_statement {
+   $$ = $1;
+   ast->function_definitions[$$].body = $2;
+}
+;
+
+function_head: type_specifier IDENTIFIER LPAREN RPAREN {
+   $$ = create_function_definition(ast, $1, $2, 0);
+}
+| type_specifier IDENTIFIER LPAREN parameter_list RPAREN {
+   $$ = create_function_definition(ast, $1, $2, $4);
+}
+;
+
+ /* parameters are declarations, created one after the other */
+parameter_list: parameter {
+   $$ = 1;
+}
+| parameter_list COMMA parameter {
+   $$ = $1 + 1;
+}
+;
+
+parameter: type_specifier IDENTIFIER {
+   $$ = create_declaration(ast, $1, $2, AST_NONE);
+}
+| type_specifier IDENTIFIER LBRACKET RBRACKET {
+   $$ = create_declaration(ast, $1, $2, AST_UNSIZED);
 }
 ;
 
@@ -84,77 +172,110 @@ translation_unit: statement_list {
                2) list of statements
                3) compound statements */
 compound_statement: LBRACE statement_list RBRACE {
-   $$ = create_compound_statement($2);
+   $$ = create_compound_statement(ast, $2);
 }
 ;
 
 statement_list: statement {
-   $$ = create_statement_list($1);
+   statement_list_add_statement(ast, $1);
+   $$ = 1;
 }
 | statement_list statement {
-   $$ = statement_list_add_statement($1, $2);
+   statement_list_add_statement(ast, $2);
+   $$ = $1 + 1;
 }
 ;
 
-statement: declaration SEMICOLON { $$ = (struct ast_node *) $1; }
-         | expression SEMICOLON  { $$ = (struct ast_node *) $1; }
-         | assignment SEMICOLON  { $$ = (struct ast_node *) $1; }
-         | selection_statement   { $$ = (struct ast_node *) $1; }
-         | while_statement       { $$ = (struct ast_node *) $1; }
-         ;
+statement: declaration SEMICOLON {
+   $$ = AST_REF(AST_DECLARATION, $1);
+}
+| expression SEMICOLON {
+   $$ = AST_REF(AST_EXPRESSION, $1);
+}
+| assignment SEMICOLON {
+   $$ = AST_REF(AST_EXPRESSION, $1);
+}
+| selection_statement {
+   $$ = AST_REF(AST_SELECTION_STATEMENT, $1);
+}
+| while_statement {
+   $$ = AST_REF(AST_WHILE_STATEMENT, $1);
+}
+| for_statement {
+   $$ = AST_REF(AST_FOR_STATEMENT, $1);
+}
+| KW_RETURN expression SEMICOLON {
+   $$ = AST_REF(AST_RETURN_STATEMENT, $2);
+}
+;
 
  /* while rule */
 while_statement: KW_WHILE LPAREN expression RPAREN compound_statement {
-   $$ = create_while_statement($3, $5);
+   $$ = create_while_statement(ast, $3, $5);
+}
+;
+
+ /* for rule: the index runs from the first bound up to the second */
+for_statement: KW_FOR LPAREN KW_INT IDENTIFIER OP_ASSIGN expression COMMA
+               expression RPAREN compound_statement {
+   $$ = create_for_statement(ast, 0, $4, $6, $8, $10);
+}
+| KW_PARALLEL KW_FOR LPAREN KW_INT IDENTIFIER OP_ASSIGN expression COMMA
+  expression RPAREN compound_statement {
+   $$ = create_for_statement(ast, 1, $5, $7, $9, $11);
 }
 ;
 
  /* if/then/else rule */
 selection_statement: KW_IF LPAREN expression RPAREN selection_rest_statement {
    $$ = $5;
-   $$->condition = $3;
+   ast->selection_statements[$$].condition = $3;
 }
 ;
 
 selection_rest_statement: compound_statement {
-   $$ = create_selection_statement(NULL, $1, NULL);
+   $$ = create_selection_statement(ast, AST_NONE, $1, AST_NONE);
 }
 | compound_statement KW_ELSE compound_statement {
-   $$ = create_selection_statement(NULL, $1, $3);
+   $$ = create_selection_statement(ast, AST_NONE, $1, $3);
 }
 ;
 
  /* rule to match an assigment statement */
 assignment: IDENTIFIER OP_ASSIGN expression {
-   $$ = create_expression(AST_ASSIGN, $3, NULL);
-   $$->primary_expr.identifier = $1;
+   $$ = create_expression(ast, AST_ASSIGN, $3, AST_NONE);
+   ast_expression(ast, $$)->primary_expr.symbol = $1;
+}
+| IDENTIFIER LBRACKET expression RBRACKET OP_ASSIGN expression {
+   $$ = create_expression(ast, AST_ASSIGN_INDEX, $6, $3);
+   ast_expression(ast, $$)->primary_expr.symbol = $1;
 }
 ;
 
  /* expression evaluation rules */
 expression: expression OP_ADD expression {
-   $$ = create_expression(AST_ADD, $1, $3);
+   $$ = create_expression(ast, AST_ADD, $1, $3);
 }
 | expression OP_SUB expression {
-   $$ = create_expression(AST_SUB, $1, $3);
+   $$ = create_expression(ast, AST_SUB, $1, $3);
 }
 | expression OP_MUL expression {
-   $$ = create_expression(AST_MUL, $1, $3);
+   $$ = create_expression(ast, AST_MUL, $1, $3);
 }
 | expression OP_DIV expression {
-   $$ = create_expression(AST_DIV, $1, $3);
+   $$ = create_expression(ast, AST_DIV, $1, $3);
 }
 | expression OP_GT  expression {
-   $$ = create_expression(AST_GT, $1, $3);
+   $$ = create_expression(ast, AST_GT, $1, $3);
 }
 | expression OP_LT  expression {
-   $$ = create_expression(AST_LT, $1, $3);
+   $$ = create_expression(ast, AST_LT, $1, $3);
 }
 | expression OP_EQ  expression {
-   $$ = create_expression(AST_EQ, $1, $3);
+   $$ = create_expression(ast, AST_EQ, $1, $3);
 }
 | expression OP_NE  expression {
-   $$ = create_expression(AST_NE, $1, $3);
+   $$ = create_expression(ast, AST_NE, $1, $3);
 }
 | LPAREN expression RPAREN {
    $$ = $2;
@@ -165,22 +286,46 @@ expression: expression OP_ADD expression {
 ;
 
 primary_expression: IDENTIFIER {
-   $$ = create_expression(AST_IDENTIFIER, NULL, NULL);
-   $$->primary_expr.identifier = $1;
+   $$ = create_expression(ast, AST_IDENTIFIER, AST_NONE, AST_NONE);
+   ast_expression(ast, $$)->primary_expr.symbol = $1;
+}
+| IDENTIFIER LBRACKET expression RBRACKET {
+   $$ = create_expression(ast, AST_INDEX, $3, AST_NONE);
+   ast_expression(ast, $$)->primary_expr.symbol = $1;
+}
+| IDENTIFIER LPAREN RPAREN {
+   $$ = create_expression(ast, AST_CALL, AST_NONE, AST_NONE);
+   ast_expression(ast, $$)->primary_expr.symbol = $1;
+}
+| IDENTIFIER LPAREN argument_list RPAREN {
+   $$ = create_expression(ast, AST_CALL, $3, AST_NONE);
+   ast_expression(ast, $$)->primary_expr.symbol = $1;
 }
 | INT_CONSTANT {
-   $$ = create_expression(AST_INT_CONSTANT, NULL, NULL);
-   $$->primary_expr.int_constant = $1;
+   $$ = create_expression(ast, AST_INT_CONSTANT, AST_NONE, AST_NONE);
+   ast_expression(ast, $$)->primary_expr.int_constant = $1;
 }
 | FLOAT_CONSTANT {
-   $$ = create_expression(AST_FLOAT_CONSTANT, NULL, NULL);
-   $$->primary_expr.float_constant = $1;
+   $$ = create_expression(ast, AST_FLOAT_CONSTANT, AST_NONE, AST_NONE);
+   ast_expression(ast, $$)->primary_expr.float_constant = $1;
+}
+;
+
+ /* right recursive, so that each argument links to the next */
+argument_list: expression {
+   $$ = create_expression(ast, AST_ARGUMENT, $1, AST_NONE);
+}
+| expression COMMA argument_list {
+   $$ = create_expression(ast, AST_ARGUMENT, $1, $3);
 }
 ;
 
  /* variable declaration rules */
 declaration: type_specifier IDENTIFIER {
-   $$ = create_declaration($1, $2);
+   $$ = create_declaration(ast, $1, $2, AST_NONE);
+}
+| type_specifier IDENTIFIER LBRACKET expression RBRACKET {
+   $$ = create_declaration(ast, $1, $2, $4);
 }
 ;
 
@@ -191,13 +336,330 @@ type_specifier: KW_INT     { $$ = TYPE_INT;     }
 %%
 
 void
-yyerror(char *s)
+yyerror(struct driver *driver, struct ast *ast, char *s)
+{
+   printf("%s: %s\n", driver->input_name, s);
+}
+
+/* from the hand-written scanner when there is one, else from flex */
+static inline int
+next_token(yyscan_t scanner, struct fastlex *fastlex, YYSTYPE *value)
+{
+   if (fastlex != NULL)
+      return fastlex_next(fastlex, value);
+
+   return yylex(value, scanner);
+}
+
+/* 'source' is the text either scanner reads in place, or NULL */
+static int
+parse_tokens(struct driver *driver, yyscan_t scanner, struct fastlex *fastlex,
+             struct source *source)
 {
-   printf("%s\n", s);
+   yypstate *parser;
+   YYSTYPE value;
+   int token, status, fresh;
+   double start;
+
+   driver->start = timer_now();
+   parser = yypstate_new();
+   fresh = 1;
+   do {
+      /* timing every token costs a little, so only on request */
+      if (driver->options->time_report) {
+         start = timer_now();
+         token = next_token(scanner, fastlex, &value);
+         driver->report.phase_ms[PHASE_LEX] += timer_elapsed_ms(start);
+      } else {
+         token = next_token(scanner, fastlex, &value);
+      }
+      driver->report.tokens += token != 0;
+
+      if (source != NULL && (driver->report.tokens & 0xfff) == 0)
+         source_release(source, fastlex != NULL ? fastlex->text :
+                                                  yyget_text(scanner));
+
+      /* the REPL may end without a statement since its last error */
+      if (token == 0 && fresh && driver->repl != NULL) {
+         driver_finish(driver);
+         status = 0;
+         break;
+      }
+
+      status = yypush_parse(parser, token, &value, driver, driver->ast);
+      fresh = 0;
+
+      /* the REPL drops what it could not parse and carries on */
+      if (status == 1 && token != 0 && driver->repl != NULL) {
+         yypstate_delete(parser);
+         parser = yypstate_new();
+         fresh = 1;
+         ast_release(driver->ast);
+         repl_prompt(driver->repl);
+         status = YYPUSH_MORE;
+      }
+   } while (status == YYPUSH_MORE);
+
+   yypstate_delete(parser);
+
+   return status;
+}
+
+static yyscan_t
+scanner_create(void)
+{
+   yyscan_t scanner;
+
+   if (yylex_init(&scanner) != 0) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   return scanner;
+}
+
+int
+parse_input(struct driver *driver, FILE *input)
+{
+   yyscan_t scanner = scanner_create();
+   int status;
+
+   yyset_in(input, scanner);
+   status = parse_tokens(driver, scanner, NULL, NULL);
+   yylex_destroy(scanner);
+
+   return status;
+}
+
+int
+parse_source(struct driver *driver, struct source *source)
+{
+   struct fastlex fastlex;
+   yyscan_t scanner;
+   int status;
+
+   if (driver->options->lexer == LEXER_FAST) {
+      fastlex_init(&fastlex, source->data, source->size);
+      return parse_tokens(driver, NULL, &fastlex, source);
+   }
+
+   /* scanned where it lies; the scanner neither copies nor frees it */
+   scanner = scanner_create();
+   if (yy_scan_buffer(source->data, source->size + SOURCE_PADDING,
+                      scanner) == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+   status = parse_tokens(driver, scanner, NULL, source);
+   yylex_destroy(scanner);
+
+   return status;
+}
+
+static void
+usage(const char *program)
+{
+   fprintf(stderr, "Usage: %s [options] [file...]\n", program);
+   fprintf(stderr, "Compiles standard input when no file is given.\n");
+   fprintf(stderr, "  -O<n>     optimization level (default: -O0)\n");
+   fprintf(stderr, "  --ssa     build SSA form directly, without allocas\n");
+   fprintf(stderr, "  --stream  lower each top-level statement as soon as "
+                   "it is parsed\n");
+   fprintf(stderr, "  --lexer=<flex|fast>  scan with flex (default) or the "
+                   "hand-written SIMD scanner\n");
+   fprintf(stderr, "  --run     JIT-compile and execute the program\n");
+   fprintf(stderr, "  --interp  run the program on the bytecode "
+                   "interpreter, without LLVM\n");
+   fprintf(stderr, "  --tiered  interpret, moving hot loops to code "
+                   "optimized in the background\n");
+   fprintf(stderr, "  --repl    run each statement read from standard "
+                   "input as it is entered\n");
+   fprintf(stderr, "  -j<n>     compile several files on n threads "
+                   "(default: one per CPU)\n");
+   fprintf(stderr, "  --link    link several files into one module; "
+                   "implied by --run\n");
+   fprintf(stderr, "  --emit=<kind>  write ll, bc, asm or obj instead of "
+                   "dumping IR to stderr\n");
+   fprintf(stderr, "  -o <file>      output file (default: stdout, or "
+                   "named after each input)\n");
+   fprintf(stderr, "  --cache-dir=<dir>  reuse earlier results kept "
+                   "in dir\n");
+   fprintf(stderr, "  --cache-size=<MB>  evict the least recently used "
+                   "above this (default: 512)\n");
+   fprintf(stderr, "  --profile-generate=<file>  count branches while "
+                   "running, into file\n");
+   fprintf(stderr, "  --profile-use=<file>       optimize by the counts "
+                   "in file\n");
+   fprintf(stderr, "  -fno-bounds-check     index arrays without "
+                   "checking the index\n");
+   fprintf(stderr, "  -ftime-report[=json]  report the time and work of "
+                   "each phase\n");
+   exit(EXIT_FAILURE);
 }
 
 int main(int argc, char *argv[])
 {
-   yyparse();
-   return 0;
+   struct driver_options options = { 0 };
+   struct driver *driver;
+   LLVMMemoryBufferRef artifact;
+   const char *cache_directory = NULL;
+   const char *profile_path = NULL;
+   int profile_mode = 0;
+   size_t cache_size = 512;
+   double start;
+   struct source source = { 0 };
+   char **filenames;
+   int i, number_of_files, status;
+
+   filenames = calloc(argc, sizeof(char *));
+   if (filenames == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   number_of_files = 0;
+   for (i = 1; i < argc; i++) {
+      if (strcmp(argv[i], "--run") == 0)
+         options.run = 1;
+      else if (strcmp(argv[i], "--interp") == 0)
+         options.interp = 1;
+      else if (strcmp(argv[i], "--tiered") == 0)
+         options.interp = options.tiered = 1;
+      else if (strcmp(argv[i], "--ssa") == 0)
+         options.ssa = 1;
+      else if (strcmp(argv[i], "--stream") == 0)
+         options.stream = 1;
+      else if (strcmp(argv[i], "--repl") == 0)
+         options.repl = 1;
+      else if (strcmp(argv[i], "--link") == 0)
+         options.link = 1;
+      else if (strcmp(argv[i], "--lexer=flex") == 0)
+         options.lexer = LEXER_FLEX;
+      else if (strcmp(argv[i], "--lexer=fast") == 0)
+         options.lexer = LEXER_FAST;
+      else if (strncmp(argv[i], "--emit=", 7) == 0) {
+         options.emit = emit_parse_kind(argv[i] + 7);
+         if (options.emit == 0)
+            usage(argv[0]);
+      } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+         options.output_name = argv[++i];
+      else if (strcmp(argv[i], "-fno-bounds-check") == 0)
+         options.no_bounds_check = 1;
+      else if (strcmp(argv[i], "-ftime-report") == 0)
+         options.time_report = REPORT_TEXT;
+      else if (strcmp(argv[i], "-ftime-report=json") == 0)
+         options.time_report = REPORT_JSON;
+      else if (strncmp(argv[i], "--cache-dir=", 12) == 0)
+         cache_directory = argv[i] + 12;
+      else if (strncmp(argv[i], "--profile-generate=", 19) == 0) {
+         profile_mode = PROFILE_GENERATE;
+         profile_path = argv[i] + 19;
+      } else if (strncmp(argv[i], "--profile-use=", 14) == 0) {
+         profile_mode = PROFILE_USE;
+         profile_path = argv[i] + 14;
+      } else if (strncmp(argv[i], "--cache-size=", 13) == 0 &&
+               atoi(argv[i] + 13) > 0)
+         cache_size = atoi(argv[i] + 13);
+      else if (argv[i][0] == '-' && argv[i][1] == 'O' &&
+               argv[i][2] >= '0' && argv[i][2] <= '3' && argv[i][3] == '\0')
+         options.opt_level = argv[i][2] - '0';
+      else if (strncmp(argv[i], "-j", 2) == 0 && atoi(argv[i] + 2) > 0)
+         options.number_of_threads = atoi(argv[i] + 2);
+      else if (argv[i][0] == '-')
+         usage(argv[0]);
+      else
+         filenames[number_of_files++] = argv[i];
+   }
+
+   if (options.output_name != NULL && options.emit == 0)
+      options.emit = EMIT_LL;
+   if (options.run && options.emit != 0)
+      usage(argv[0]);
+   if (options.repl && (number_of_files > 0 || options.run || options.link ||
+                        options.emit != 0 || options.ssa ||
+                        options.lexer == LEXER_FAST ||
+                        cache_directory != NULL))
+      usage(argv[0]);
+   if (options.interp && (number_of_files > 1 || options.run ||
+                          options.link || options.emit != 0 ||
+                          options.repl || cache_directory != NULL))
+      usage(argv[0]);
+   if (options.tiered && options.stream)
+      usage(argv[0]);
+   /* sites are numbered across one module, and only --run writes counts */
+   if (profile_mode != 0 && (number_of_files > 1 || options.repl ||
+                             options.interp || cache_directory != NULL))
+      usage(argv[0]);
+   if (profile_mode == PROFILE_GENERATE && !options.run)
+      usage(argv[0]);
+
+   /* without linking, every input gets an output of its own */
+   if (options.output_name != NULL && number_of_files > 1 && !options.link) {
+      fprintf(stderr, "-o needs --link when compiling several files\n");
+      exit(EXIT_FAILURE);
+   }
+
+   if (cache_directory != NULL) {
+      options.cache = cache_create(cache_directory, cache_size << 20);
+      options.cache->report = options.time_report != 0;
+   }
+   if (profile_mode != 0)
+      options.profile = profile_create(profile_mode, profile_path);
+
+   if (number_of_files > 1) {
+      status = batch_compile(&options, filenames, number_of_files);
+      if (options.cache != NULL)
+         cache_destroy(options.cache);
+      free(filenames);
+      return status;
+   }
+
+   /* a file is mapped; standard input is read as it comes, unless ... */
+   if (number_of_files == 1) {
+      if (source_open(&source, filenames[0]) != 0) {
+         perror(filenames[0]);
+         exit(EXIT_FAILURE);
+      }
+   } else if (options.cache != NULL || options.lexer == LEXER_FAST) {
+      /* ... it is hashed, or scanned by hand, as a whole */
+      source_read(&source, stdin);
+   }
+
+   if (options.cache != NULL) {
+      artifact = driver_compile_artifact(&options,
+                                         number_of_files == 1 ?
+                                         filenames[0] : "<stdin>",
+                                         &source,
+                                         driver_artifact_kind(&options));
+      status = artifact == NULL;
+      if (artifact != NULL)
+         driver_output_artifact(&options, artifact, options.output_name);
+      cache_destroy(options.cache);
+   } else {
+      driver = driver_create(&options,
+                             number_of_files == 1 ? filenames[0] : "<stdin>");
+      if (source.data != NULL)
+         status = parse_source(driver, &source);
+      else
+         status = parse_input(driver, stdin);
+      if (status == 0 && !options.repl) {
+         start = timer_now();
+         if (options.interp) {
+            interp_run(driver->bytecode, driver->tier);
+         } else {
+            driver_output_module(&options, driver->vm->module,
+                                 options.output_name, &driver->report);
+            driver->vm->module = NULL;
+         }
+         driver->report.phase_ms[PHASE_OUTPUT] = timer_elapsed_ms(start);
+      }
+      driver_destroy(driver);
+      if (options.profile != NULL)
+         profile_destroy(options.profile);
+   }
+
+   source_close(&source);
+   free(filenames);
+
+   return status == 0 ? 0 : EXIT_FAILURE;
 }
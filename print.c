@@ -1,27 +1,31 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "ast.h"
+#include "intern.h"
 
 static void
-print_declaration(struct ast_declaration *);
+print_declaration(struct ast *, struct ast_declaration *);
 
 static void
-print_expression(struct ast_expression *);
+print_expression(struct ast *, ast_index);
 
 static void
-print_statement_list(struct ast_statement_list *);
+print_statement_list(struct ast *, struct ast_statement_list *);
 
 static void
-print_compound_statement(struct ast_compound_statement *);
+print_compound_statement(struct ast *, ast_index);
 
 static void
-print_selection_statement(struct ast_selection_statement *);
+print_selection_statement(struct ast *, struct ast_selection_statement *);
 
 static void
-print_while_statement(struct ast_while_statement *);
+print_while_statement(struct ast *, struct ast_while_statement *);
 
 static void
-print_translation_unit(struct ast_translation_unit *);
+print_for_statement(struct ast *, struct ast_for_statement *);
+
+static void
+print_function_definition(struct ast *, struct ast_function_definition *);
 
 static int ntabs = 0;
 
@@ -35,9 +39,9 @@ print_tabs(void)
 }
 
 static void
-print_declaration(struct ast_declaration *declaration)
+print_type_specifier(int type_specifier)
 {
-   switch (declaration->type_specifier) {
+   switch (type_specifier) {
       case TYPE_INT:
          printf("int");
          break;
@@ -45,63 +49,92 @@ print_declaration(struct ast_declaration *declaration)
          printf("float");
          break;
       default:
-         fprintf(stderr, "Unknown type specifier: %d\n",
-                         declaration->type_specifier);
+         fprintf(stderr, "Unknown type specifier: %d\n", type_specifier);
          exit(EXIT_FAILURE);
    }
+}
+
+/* without the ';', which parameters do not have */
+static void
+print_declarator(struct ast *ast, struct ast_declaration *declaration)
+{
+   print_type_specifier(declaration->type_specifier);
+
+   printf(" %s", intern_get_name(declaration->symbol));
+   if (declaration->size == AST_UNSIZED) {
+      printf("[]");
+   } else if (declaration->size != AST_NONE) {
+      printf("[");
+      print_expression(ast, declaration->size);
+      printf("]");
+   }
+}
 
-   printf(" %s;", declaration->identifier);
+static void
+print_declaration(struct ast *ast, struct ast_declaration *declaration)
+{
+   print_declarator(ast, declaration);
+   printf(";");
 }
 
 static void
-print_expression(struct ast_expression *expression)
+print_expression(struct ast *ast, ast_index index)
 {
+   struct ast_expression *expression = ast_expression(ast, index);
+
    switch (expression->operator) {
       case AST_ADD:
-         print_expression(expression->subexpr[0]);
+         print_expression(ast, expression->subexpr[0]);
          printf(" + ");
-         print_expression(expression->subexpr[1]);
+         print_expression(ast, expression->subexpr[1]);
          break;
       case AST_SUB:
-         print_expression(expression->subexpr[0]);
+         print_expression(ast, expression->subexpr[0]);
          printf(" - ");
-         print_expression(expression->subexpr[1]);
+         print_expression(ast, expression->subexpr[1]);
          break;
       case AST_MUL:
-         print_expression(expression->subexpr[0]);
+         print_expression(ast, expression->subexpr[0]);
          printf(" * ");
-         print_expression(expression->subexpr[1]);
+         print_expression(ast, expression->subexpr[1]);
          break;
       case AST_DIV:
-         print_expression(expression->subexpr[0]);
+         print_expression(ast, expression->subexpr[0]);
          printf(" / ");
-         print_expression(expression->subexpr[1]);
+         print_expression(ast, expression->subexpr[1]);
          break;
 
       case AST_GT:
-         print_expression(expression->subexpr[0]);
+         print_expression(ast, expression->subexpr[0]);
          printf(" > ");
-         print_expression(expression->subexpr[1]);
+         print_expression(ast, expression->subexpr[1]);
          break;
       case AST_LT:
-         print_expression(expression->subexpr[0]);
+         print_expression(ast, expression->subexpr[0]);
          printf(" < ");
-         print_expression(expression->subexpr[1]);
+         print_expression(ast, expression->subexpr[1]);
          break;
       case AST_EQ:
-         print_expression(expression->subexpr[0]);
+         print_expression(ast, expression->subexpr[0]);
          printf(" == ");
-         print_expression(expression->subexpr[1]);
+         print_expression(ast, expression->subexpr[1]);
          break;
       case AST_NE:
-         print_expression(expression->subexpr[0]);
+         print_expression(ast, expression->subexpr[0]);
          printf(" != ");
-         print_expression(expression->subexpr[1]);
+         print_expression(ast, expression->subexpr[1]);
          break;
 
       case AST_ASSIGN:
-         printf("%s = ", expression->primary_expr.identifier);
-         print_expression(expression->subexpr[0]);
+         printf("%s = ",
+                intern_get_name(expression->primary_expr.symbol));
+         print_expression(ast, expression->subexpr[0]);
+         break;
+      case AST_ASSIGN_INDEX:
+         printf("%s[", intern_get_name(expression->primary_expr.symbol));
+         print_expression(ast, expression->subexpr[1]);
+         printf("] = ");
+         print_expression(ast, expression->subexpr[0]);
          break;
 
       case AST_INT_CONSTANT:
@@ -111,7 +144,32 @@ print_expression(struct ast_expression *expression)
          printf("%f", expression->primary_expr.float_constant);
          break;
       case AST_IDENTIFIER:
-         printf("%s", expression->primary_expr.identifier);
+         printf("%s", intern_get_name(expression->primary_expr.symbol));
+         break;
+      case AST_INDEX:
+         printf("%s[", intern_get_name(expression->primary_expr.symbol));
+         print_expression(ast, expression->subexpr[0]);
+         printf("]");
+         break;
+      case AST_CALL:
+         printf("%s(", intern_get_name(expression->primary_expr.symbol));
+         if (expression->subexpr[0] != AST_NONE)
+            print_expression(ast, expression->subexpr[0]);
+         printf(")");
+         break;
+      case AST_ARGUMENT:
+         print_expression(ast, expression->subexpr[0]);
+         if (expression->subexpr[1] != AST_NONE) {
+            printf(", ");
+            print_expression(ast, expression->subexpr[1]);
+         }
+         break;
+      case AST_CONVERT:
+         printf("(");
+         print_type_specifier(expression->type);
+         printf(") (");
+         print_expression(ast, expression->subexpr[0]);
+         printf(")");
          break;
 
       default:
@@ -122,25 +180,25 @@ print_expression(struct ast_expression *expression)
 }
 
 static void
-print_statement_list(struct ast_statement_list *statement_list)
+print_statement_list(struct ast *ast, struct ast_statement_list *statement_list)
 {
-   int i;
+   uint32_t i;
 
    for (i = 0; i < statement_list->number_of_statements; i++) {
       print_tabs();
-      print_node(statement_list->statement[i]);
+      print_statement(ast, ast->statements[statement_list->first + i]);
       printf("\n");
    }
 }
 
 static void
-print_compound_statement(struct ast_compound_statement *compound_statement)
+print_compound_statement(struct ast *ast, ast_index index)
 {
    print_tabs();
    printf("{\n");
    ntabs++;
 
-   print_statement_list(compound_statement->statement_list);
+   print_statement_list(ast, &ast->compound_statements[index].statement_list);
 
    ntabs--;
    print_tabs();
@@ -148,78 +206,119 @@ print_compound_statement(struct ast_compound_statement *compound_statement)
 }
 
 static void
-print_selection_statement(struct ast_selection_statement *selection_statement)
+print_selection_statement(struct ast *ast,
+                          struct ast_selection_statement *selection_statement)
 {
    printf("\n");
    print_tabs();
    printf("if (");
-   print_expression(selection_statement->condition);
+   print_expression(ast, selection_statement->condition);
    printf(")\n");
 
-   print_compound_statement(selection_statement->then_body);
+   print_compound_statement(ast, selection_statement->then_body);
 
-   if (selection_statement->else_body) {
+   if (selection_statement->else_body != AST_NONE) {
       print_tabs();
       printf("else\n");
-      print_compound_statement(selection_statement->else_body);
+      print_compound_statement(ast, selection_statement->else_body);
       printf("\n");
    }
 }
 
 static void
-print_while_statement(struct ast_while_statement *while_statement)
+print_while_statement(struct ast *ast,
+                      struct ast_while_statement *while_statement)
 {
    printf("\n");
    print_tabs();
    printf("while (");
-   print_expression(while_statement->condition);
+   print_expression(ast, while_statement->condition);
+   printf(")\n");
+
+   print_compound_statement(ast, while_statement->body);
+   printf("\n");
+}
+
+static void
+print_for_statement(struct ast *ast, struct ast_for_statement *for_statement)
+{
+   printf("\n");
+   print_tabs();
+   printf("%sfor (", for_statement->parallel ? "parallel " : "");
+   print_declarator(ast, &ast->declarations[for_statement->index]);
+   printf(" = ");
+   print_expression(ast, for_statement->lower);
+   printf(", ");
+   print_expression(ast, for_statement->upper);
    printf(")\n");
 
-   print_compound_statement(while_statement->body);
+   print_compound_statement(ast, for_statement->body);
    printf("\n");
 }
 
 static void
-print_translation_unit(struct ast_translation_unit *translation_unit)
+print_function_definition(struct ast *ast,
+                          struct ast_function_definition *definition)
 {
-   print_statement_list(translation_unit->statement_list);
+   uint32_t i;
+
+   printf("\n");
+   print_tabs();
+   print_type_specifier(definition->type_specifier);
+   printf(" %s(", intern_get_name(definition->symbol));
+   for (i = 0; i < definition->number_of_parameters; i++) {
+      if (i > 0)
+         printf(", ");
+      print_declarator(ast,
+                       &ast->declarations[definition->first_parameter + i]);
+   }
+   printf(")\n");
+
+   print_compound_statement(ast, definition->body);
 }
 
 void
-print_node(struct ast_node *node)
+print_translation_unit(struct ast *ast)
 {
-   int tag = node->tag;
-   void *nodep = node;
+   print_statement_list(ast, &ast->translation_unit.statement_list);
+}
 
-   switch (tag) {
-      case AST_NODE:
-         fprintf(stderr, "Request to print generic AST node.\n");
-         exit(EXIT_FAILURE);
+void
+print_statement(struct ast *ast, ast_ref statement)
+{
+   ast_index index = AST_REF_INDEX(statement);
 
+   switch (AST_REF_TAG(statement)) {
       case AST_DECLARATION:
-         print_declaration(nodep);
+         print_declaration(ast, &ast->declarations[index]);
          break;
       case AST_EXPRESSION:
-         print_expression(nodep);
+         print_expression(ast, index);
          printf(";");
          break;
-      case AST_STATEMENT_LIST:
-         print_statement_list(nodep);
-         break;
       case AST_COMPOUND_STATEMENT:
-         print_compound_statement(nodep);
+         print_compound_statement(ast, index);
          break;
       case AST_SELECTION_STATEMENT:
-         print_selection_statement(nodep);
+         print_selection_statement(ast, &ast->selection_statements[index]);
          break;
       case AST_WHILE_STATEMENT:
-         print_while_statement(nodep);
+         print_while_statement(ast, &ast->while_statements[index]);
+         break;
+      case AST_FOR_STATEMENT:
+         print_for_statement(ast, &ast->for_statements[index]);
          break;
-      case AST_TRANSLATION_UNIT:
-         print_translation_unit(nodep);
+      case AST_FUNCTION_DEFINITION:
+         print_function_definition(ast, &ast->function_definitions[index]);
+         break;
+      case AST_RETURN_STATEMENT:
+         printf("return ");
+         print_expression(ast, index);
+         printf(";");
          break;
 
       default:
-         fprintf(stderr, "Request to print unknown node type: %d\n", tag);
+         fprintf(stderr, "Request to print unknown statement: %d\n",
+                         AST_REF_TAG(statement));
    }
 }
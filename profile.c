@@ -0,0 +1,270 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "hash_map.h"
+#include "intern.h"
+#include "jit.h"
+#include "profile.h"
+#include "report.h"
+#include "timer.h"
+
+#define PROFILE_HEADER  "# toy profile: key function kind true/entries false\n"
+
+static const char *kind_names[] = {
+   [PROFILE_ENTRY] = "entry",
+   [PROFILE_IF] = "if",
+   [PROFILE_WHILE] = "while",
+};
+
+/* FNV-1a */
+static uint64_t
+hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+   const unsigned char *bytes = data;
+   size_t i;
+
+   for (i = 0; i < size; i++) {
+      hash ^= bytes[i];
+      hash *= 0x100000001b3;
+   }
+
+   return hash;
+}
+
+/* with the terminator, so that names cannot run together */
+static uint64_t
+hash_string(uint64_t hash, const char *string)
+{
+   return hash_bytes(hash, string, strlen(string) + 1);
+}
+
+/* the shape of the condition, with names rather than symbol ids */
+static uint64_t
+hash_expression(uint64_t hash, struct ast *ast, ast_index index)
+{
+   struct ast_expression *expression;
+
+   if (index == AST_NONE)
+      return hash_bytes(hash, "", 1);
+
+   expression = ast_expression(ast, index);
+   hash = hash_bytes(hash, &expression->operator, sizeof(uint16_t));
+   hash = hash_bytes(hash, &expression->type, sizeof(uint16_t));
+
+   switch (expression->operator) {
+      case AST_INT_CONSTANT:
+      case AST_FLOAT_CONSTANT:
+         return hash_bytes(hash, &expression->primary_expr,
+                           sizeof(expression->primary_expr));
+
+      case AST_IDENTIFIER:
+         return hash_string(hash,
+                            intern_get_name(expression->primary_expr.symbol));
+
+      case AST_INDEX:
+      case AST_ASSIGN:
+      case AST_ASSIGN_INDEX:
+      case AST_CALL:
+         hash = hash_string(hash,
+                            intern_get_name(expression->primary_expr.symbol));
+         break;
+   }
+
+   hash = hash_expression(hash, ast, expression->subexpr[0]);
+   return hash_expression(hash, ast, expression->subexpr[1]);
+}
+
+static void
+add_site(struct profile *profile, struct profile_site *site)
+{
+   if (profile->number_of_sites == profile->capacity) {
+      profile->capacity = profile->capacity ? 2 * profile->capacity : 64;
+      profile->sites = realloc(profile->sites, profile->capacity *
+                               sizeof(struct profile_site));
+      if (profile->sites == NULL) {
+         fprintf(stderr, "Memory reallocation request failed.\n");
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   profile->sites[profile->number_of_sites++] = *site;
+   hash_map_put(profile->by_key, site->key,
+                (void *) (uintptr_t) profile->number_of_sites);
+}
+
+/* the function names are not kept, nobody needs them back */
+static void
+profile_read(struct profile *profile)
+{
+   struct profile_site site = { 0 };
+   char line[256];
+   FILE *file;
+
+   file = fopen(profile->path, "r");
+   if (file == NULL) {
+      perror(profile->path);
+      exit(EXIT_FAILURE);
+   }
+
+   while (fgets(line, sizeof(line), file) != NULL) {
+      if (line[0] == '#' || line[0] == '\n')
+         continue;
+
+      if (sscanf(line, "%" SCNx64 " %*s %*s %" SCNu64 " %" SCNu64,
+                 &site.key, &site.counts[0], &site.counts[1]) != 3 ||
+          site.key == 0) {
+         fprintf(stderr, "%s: malformed profile line: %s", profile->path,
+                         line);
+         exit(EXIT_FAILURE);
+      }
+      add_site(profile, &site);
+   }
+
+   fclose(file);
+}
+
+static void
+profile_write(struct profile *profile)
+{
+   struct profile_site *site;
+   FILE *file;
+   uint32_t i;
+
+   file = fopen(profile->path, "w");
+   if (file == NULL) {
+      perror(profile->path);
+      exit(EXIT_FAILURE);
+   }
+
+   fputs(PROFILE_HEADER, file);
+   for (i = 0; i < profile->number_of_sites; i++) {
+      site = &profile->sites[i];
+      fprintf(file, "%016" PRIx64 " %s %s %" PRIu64 " %" PRIu64 "\n",
+                    site->key, site->function, kind_names[site->kind],
+                    site->counts[0], site->counts[1]);
+   }
+
+   if (fclose(file) != 0) {
+      perror(profile->path);
+      exit(EXIT_FAILURE);
+   }
+}
+
+struct profile *
+profile_create(int mode, const char *path)
+{
+   struct profile *profile;
+
+   profile = calloc(1, sizeof(struct profile));
+   if (profile == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   profile->mode = mode;
+   profile->path = path;
+   profile->by_key = hash_map_create();
+   profile->ordinals = hash_map_create();
+
+   if (mode == PROFILE_USE)
+      profile_read(profile);
+
+   return profile;
+}
+
+void
+profile_destroy(struct profile *profile)
+{
+   hash_map_destroy(profile->by_key);
+   hash_map_destroy(profile->ordinals);
+   free(profile->sites);
+   free(profile);
+}
+
+uint64_t
+profile_key(struct profile *profile, struct ast *ast, const char *function,
+            int kind, ast_index condition)
+{
+   uint64_t base, ordinal, key;
+
+   base = hash_string(0xcbf29ce484222325, function);
+   base = hash_bytes(base, &kind, sizeof(int));
+   base = hash_expression(base, ast, condition);
+   base += base == 0;
+
+   /* counted in the map itself, from 0 */
+   ordinal = (uintptr_t) hash_map_get(profile->ordinals, base);
+   hash_map_put(profile->ordinals, base, (void *) (uintptr_t) (ordinal + 1));
+
+   key = hash_bytes(base, &ordinal, sizeof(uint64_t));
+   return key + (key == 0);
+}
+
+uint32_t
+profile_add_site(struct profile *profile, uint64_t key, const char *function,
+                 int kind)
+{
+   struct profile_site site = { key, function, kind, { 0, 0 } };
+
+   add_site(profile, &site);
+   return profile->number_of_sites - 1;
+}
+
+struct profile_site *
+profile_find_site(struct profile *profile, uint64_t key)
+{
+   uintptr_t index;
+
+   profile->sites_compiled++;
+   index = (uintptr_t) hash_map_get(profile->by_key, key);
+   if (index == 0)
+      return NULL;
+
+   profile->sites_matched++;
+   return &profile->sites[index - 1];
+}
+
+void
+profile_run_module(struct profile *profile, LLVMModuleRef module,
+                   struct time_report *report)
+{
+   struct jit *jit;
+   void (*main_function)(void);
+   uint64_t *counters = NULL;
+   uint32_t i;
+   double start, setup_ms, compile_ms, execute_ms;
+
+   start = timer_now();
+   jit = jit_create(NULL);
+   jit_add_module(jit, module);
+   setup_ms = timer_elapsed_ms(start);
+
+   start = timer_now();
+   main_function = (void (*)(void)) jit_lookup(jit, "main");
+   if (profile->number_of_sites > 0)
+      counters = jit_lookup(jit, PROFILE_COUNTERS);
+   compile_ms = timer_elapsed_ms(start);
+
+   start = timer_now();
+   main_function();
+   execute_ms = timer_elapsed_ms(start);
+
+   for (i = 0; i < profile->number_of_sites; i++) {
+      profile->sites[i].counts[0] = counters[2 * i];
+      profile->sites[i].counts[1] = counters[2 * i + 1];
+   }
+   jit_destroy(jit);
+
+   if (report != NULL) {
+      report->jit_setup_ms += setup_ms;
+      report->jit_compile_ms += compile_ms;
+      report->jit_execute_ms += execute_ms;
+   }
+
+   profile_write(profile);
+   if (report != NULL)
+      report->profile_sites_written += profile->number_of_sites;
+}
@@ -0,0 +1,87 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+#include <llvm-c/Core.h>
+
+#include "ast.h"
+
+struct hash_map;
+struct time_report;
+
+/*
+ * Profile-guided optimization. --profile-generate=<file> builds every if
+ * and while condition, and the entry of every function, to count into a
+ * global array how often it is reached and which way it goes; once main
+ * has returned, the counts are written to the file. --profile-use=<file>
+ * reads them back and hands them to LLVM as branch weights and function
+ * entry counts, for block layout, unrolling and inlining to go by.
+ *
+ * A site is known by a hash of its function's name, its kind and its
+ * condition, and by how many alike sites come before it in the function,
+ * rather than by its place in the source: a profile still applies after
+ * edits elsewhere, and a site that changed merely goes without weights.
+ */
+#define PROFILE_GENERATE   1
+#define PROFILE_USE        2
+
+/* kinds of sites */
+#define PROFILE_ENTRY      0
+#define PROFILE_IF         1
+#define PROFILE_WHILE      2
+
+/* the counters in the module, two per site */
+#define PROFILE_COUNTERS   "toy.profile"
+
+struct profile_site {
+   uint64_t key;
+   const char *function;   /* name, for the reader of the file */
+   int kind;
+   uint64_t counts[2];     /* condition true, false; or entries, 0 */
+};
+
+struct profile {
+   int mode;               /* PROFILE_* */
+   const char *path;
+
+   struct profile_site *sites;
+   uint32_t number_of_sites;
+   uint32_t capacity;
+
+   struct hash_map *by_key;      /* to the site index + 1 */
+   struct hash_map *ordinals;    /* alike sites so far, see profile_key() */
+
+   uint32_t sites_compiled;      /* of --profile-use, for -ftime-report */
+   uint32_t sites_matched;
+};
+
+/* for PROFILE_USE, reads 'path' and exits if it cannot */
+struct profile *profile_create(int mode, const char *path);
+
+void profile_destroy(struct profile *profile);
+
+/*
+ * The key of the next site of 'kind' in 'function', with 'condition'
+ * (AST_NONE for an entry); call once per site, in program order.
+ */
+uint64_t profile_key(struct profile *profile, struct ast *ast,
+                     const char *function, int kind, ast_index condition);
+
+/* for --profile-generate: a new site, whose counters start at 2 * index */
+uint32_t profile_add_site(struct profile *profile, uint64_t key,
+                          const char *function, int kind);
+
+/* for --profile-use: the counts of site 'key', NULL if it has none */
+struct profile_site *profile_find_site(struct profile *profile, uint64_t key);
+
+/*
+ * For --profile-generate: jit-compiles 'module', runs its main function,
+ * then writes the counts to the profile file. Takes ownership of the
+ * module. The time of each step and the number of sites written go to
+ * 'report' unless it is NULL.
+ */
+void profile_run_module(struct profile *profile, LLVMModuleRef module,
+                        struct time_report *report);
+
+#endif /* PROFILE_H */
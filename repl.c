@@ -0,0 +1,564 @@
+#include <pthread.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "driver.h"
+#include "intern.h"
+#include "jit.h"
+#include "optimizer.h"
+#include "parallel.h"
+#include "repl.h"
+#include "target.h"
+#include "timer.h"
+#include "vm_state.h"
+#include "vm_value.h"
+
+/* a variable declared at the top level, defined in the module of its input */
+struct repl_global {
+   struct vm_value *variable;    /* NULL if the symbol has none */
+   char *name;                   /* of the definition, unique per input */
+   unsigned input;               /* last input that declared it */
+};
+
+struct repl {
+   struct driver_options *options;
+   struct vm_state *vm;
+   struct jit *jit;
+   LLVMTargetMachineRef machine;    /* only with -O<n> */
+
+   /* every input is a void (i8 *result) */
+   LLVMTypeRef function_type;
+
+   struct repl_global *globals;     /* indexed by symbol */
+   int globals_capacity;
+
+   int interactive;
+   unsigned number_of_inputs;
+   double setup_ms, lower_ms, compile_ms, execute_ms;
+};
+
+struct repl *
+repl_create(struct driver_options *options, struct vm_state *vm)
+{
+   struct repl *repl;
+   LLVMTypeRef result_type;
+   double start;
+
+   repl = calloc(1, sizeof(struct repl));
+   if (repl == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   repl->options = options;
+   repl->vm = vm;
+   /* at -O0 the JIT's own machine selects instructions the fast way */
+   start = timer_now();
+   repl->jit = jit_create(target_machine_create_host(options->opt_level));
+   repl->setup_ms = timer_elapsed_ms(start);
+   if (options->opt_level > 0)
+      repl->machine = target_machine_create_host(options->opt_level);
+
+   result_type = LLVMPointerType(LLVMInt8TypeInContext(vm->context), 0);
+   repl->function_type = LLVMFunctionType(LLVMVoidTypeInContext(vm->context),
+                                          &result_type, 1, 0);
+
+   /* every input gets a module of its own, see repl_evaluate() */
+   LLVMDisposeModule(vm->module);
+   vm->module = NULL;
+
+   repl->interactive = isatty(STDIN_FILENO);
+   repl_prompt(repl);
+
+   return repl;
+}
+
+void
+repl_destroy(struct repl *repl, struct time_report *report)
+{
+   int i;
+
+   if (repl->interactive)
+      printf("\n");
+
+   /* lowering an input takes its verifying and optimizing along */
+   report->inputs += repl->number_of_inputs;
+   report->phase_ms[PHASE_CODEGEN] += repl->lower_ms;
+   report->phase_ms[PHASE_OUTPUT] += repl->setup_ms + repl->compile_ms +
+                                     repl->execute_ms;
+   report->jit_setup_ms += repl->setup_ms;
+   report->jit_compile_ms += repl->compile_ms;
+   report->jit_execute_ms += repl->execute_ms;
+
+   /* the modules the JIT owns live in the vm_state's context */
+   jit_destroy(repl->jit);
+   if (repl->machine != NULL)
+      LLVMDisposeTargetMachine(repl->machine);
+
+   for (i = 0; i < repl->globals_capacity; i++)
+      free(repl->globals[i].name);
+   free(repl->globals);
+   free(repl);
+}
+
+void
+repl_prompt(struct repl *repl)
+{
+   if (!repl->interactive)
+      return;
+
+   printf("> ");
+   fflush(stdout);
+}
+
+static struct repl_global *
+repl_global(struct repl *repl, int symbol)
+{
+   int capacity = repl->globals_capacity;
+
+   if (symbol >= capacity) {
+      if (capacity == 0)
+         capacity = 64;
+      while (capacity <= symbol)
+         capacity *= 2;
+
+      repl->globals = realloc(repl->globals,
+                              capacity * sizeof(struct repl_global));
+      if (repl->globals == NULL) {
+         fprintf(stderr, "Memory allocation request failed.\n");
+         exit(EXIT_FAILURE);
+      }
+      memset(&repl->globals[repl->globals_capacity], 0,
+             (capacity - repl->globals_capacity) *
+             sizeof(struct repl_global));
+      repl->globals_capacity = capacity;
+   }
+
+   return &repl->globals[symbol];
+}
+
+/*
+ * Declares 'vmval' in the current module, as 'name'. A function is
+ * declared as such; an array global is [n x T], used through a pointer
+ * to its first element.
+ */
+static LLVMValueRef
+add_global(struct repl *repl, struct vm_value *vmval, const char *name)
+{
+   LLVMTypeRef type = vmval->llvm_type;
+   LLVMValueRef global;
+
+   if (vmval->function_type != NULL) {
+      vmval->llvm_value = LLVMAddFunction(repl->vm->module, name,
+                                          vmval->function_type);
+      return vmval->llvm_value;
+   }
+
+   if (vmval->length != NULL)
+      type = LLVMArrayType(type, LLVMConstIntGetZExtValue(vmval->length));
+
+   global = LLVMAddGlobal(repl->vm->module, type, name);
+   vmval->llvm_value = global;
+   if (vmval->length != NULL) {
+      LLVMSetAlignment(global, VM_ARRAY_ALIGNMENT);
+      vmval->llvm_value = LLVMConstBitCast(global,
+                                           LLVMPointerType(vmval->llvm_type,
+                                                           0));
+   }
+
+   return global;
+}
+
+/*
+ * Records 'vmval' as the definition of its symbol made by this input,
+ * returning the unique name to define it under. A redeclaration shadows
+ * the old global for good.
+ */
+static const char *
+bind_global(struct repl *repl, struct vm_value *vmval)
+{
+   struct repl_global *global;
+   char name[256];
+
+   snprintf(name, sizeof(name), "%s.%u", vmval->identifier,
+            repl->number_of_inputs);
+   global = repl_global(repl, vmval->symbol);
+   free(global->name);
+   global->name = strdup(name);
+   if (global->name == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+   global->variable = vmval;
+   global->input = repl->number_of_inputs;
+
+   return global->name;
+}
+
+/* returns 0 if the declaration cannot be a global */
+static int
+define_global(struct repl *repl, struct ast_declaration *declaration)
+{
+   struct vm_state *vm = repl->vm;
+   struct ast_expression *size = NULL;
+   struct vm_value *vmval;
+   LLVMValueRef global;
+
+   /* a global outlives the input, so its size must be known up front */
+   if (declaration->size != AST_NONE) {
+      size = ast_expression(vm->ast, declaration->size);
+      if (size->operator != AST_INT_CONSTANT ||
+          size->primary_expr.int_constant < 0) {
+         fprintf(stderr, "%s: the size of a top-level array must be "
+                         "a non-negative constant\n",
+                         intern_get_name(declaration->symbol));
+         return 0;
+      }
+   }
+
+   vmval = vm_value_new_variable(vm, declaration->type_specifier,
+                                     declaration->symbol);
+   if (size != NULL)
+      vmval->length = LLVMConstInt(vm->int_type,
+                                   size->primary_expr.int_constant, 0);
+
+   global = add_global(repl, vmval, bind_global(repl, vmval));
+   LLVMSetInitializer(global, LLVMConstNull(LLVMGlobalGetValueType(global)));
+
+   vm_state_put_value(vm, vmval);
+   return 1;
+}
+
+/* makes the function just lowered callable from later inputs */
+static void
+export_function(struct repl *repl, int symbol)
+{
+   struct vm_value *function = vm_state_get_value(repl->vm, symbol);
+   const char *name = bind_global(repl, function);
+
+   LLVMSetValueName2(function->llvm_value, name, strlen(name));
+   LLVMSetLinkage(function->llvm_value, LLVMExternalLinkage);
+}
+
+/*
+ * Makes 'symbol' usable in the current module: a global defined by an
+ * earlier input is declared here, since its old value belongs to a
+ * module the JIT owns by now. Returns 0 if the symbol is undeclared.
+ */
+static int
+resolve_symbol(struct repl *repl, int symbol)
+{
+   struct vm_value *vmval;
+   struct repl_global *global;
+
+   /* a function only sees its own variables, see vm_state */
+   vmval = vm_state_get_value(repl->vm, symbol);
+   if (vmval == NULL ||
+       (vmval->function_type == NULL && vmval->owner != repl->vm->function)) {
+      fprintf(stderr, "%s: undeclared variable\n", intern_get_name(symbol));
+      return 0;
+   }
+
+   if (symbol >= repl->globals_capacity)
+      return 1;
+   global = &repl->globals[symbol];
+   if (global->variable != vmval || global->input == repl->number_of_inputs)
+      return 1;
+
+   add_global(repl, vmval, global->name);
+   global->input = repl->number_of_inputs;
+
+   return 1;
+}
+
+static int
+resolve_expression(struct repl *repl, ast_index index)
+{
+   struct ast_expression *expression = ast_expression(repl->vm->ast, index);
+   int i;
+
+   if (expression->operator == AST_IDENTIFIER ||
+       expression->operator == AST_ASSIGN ||
+       expression->operator == AST_INDEX ||
+       expression->operator == AST_ASSIGN_INDEX ||
+       expression->operator == AST_CALL) {
+      if (!resolve_symbol(repl, expression->primary_expr.symbol))
+         return 0;
+   }
+
+   for (i = 0; i < 2; i++) {
+      if (expression->subexpr[i] != AST_NONE &&
+          !resolve_expression(repl, expression->subexpr[i]))
+         return 0;
+   }
+
+   return 1;
+}
+
+static int resolve_statement(struct repl *, ast_ref);
+
+static int resolve_compound_statement(struct repl *, ast_index);
+
+/* walks the body with stand-ins for the function and its parameters */
+static int
+resolve_function_definition(struct repl *repl,
+                            struct ast_function_definition *definition)
+{
+   struct vm_state *vm = repl->vm;
+   struct ast_declaration *parameters;
+   struct vm_value *function;
+   uint32_t i;
+   int resolved;
+
+   vm_state_enter_scope(vm);
+   function = vm_value_new_variable(vm, definition->type_specifier,
+                                        definition->symbol);
+   function->function_type = LLVMFunctionType(function->llvm_type, NULL, 0,
+                                              0);
+   vm_state_put_value(vm, function);
+
+   vm->function = function;
+   parameters = &vm->ast->declarations[definition->first_parameter];
+   for (i = 0; i < definition->number_of_parameters; i++)
+      vm_state_put_value(vm,
+                         vm_value_new_variable(vm,
+                                               parameters[i].type_specifier,
+                                               parameters[i].symbol));
+   resolved = resolve_compound_statement(repl, definition->body);
+   vm->function = NULL;
+
+   vm_state_exit_scope(vm);
+
+   return resolved;
+}
+
+static int
+resolve_compound_statement(struct repl *repl, ast_index index)
+{
+   struct ast *ast = repl->vm->ast;
+   struct ast_statement_list *statement_list;
+   uint32_t i;
+   int resolved = 1;
+
+   /* block declarations are bound for the walk only, like in codegen */
+   statement_list = &ast->compound_statements[index].statement_list;
+   vm_state_enter_scope(repl->vm);
+   for (i = 0; i < statement_list->number_of_statements && resolved; i++)
+      resolved = resolve_statement(repl,
+                                   ast->statements[statement_list->first + i]);
+   vm_state_exit_scope(repl->vm);
+
+   return resolved;
+}
+
+static int
+resolve_statement(struct repl *repl, ast_ref statement)
+{
+   struct vm_state *vm = repl->vm;
+   struct ast *ast = vm->ast;
+   ast_index index = AST_REF_INDEX(statement);
+
+   switch (AST_REF_TAG(statement)) {
+      case AST_DECLARATION: {
+         struct ast_declaration *declaration = &ast->declarations[index];
+
+         if (declaration->size != AST_NONE &&
+             !resolve_expression(repl, declaration->size))
+            return 0;
+         vm_state_put_value(vm,
+                            vm_value_new_variable(vm,
+                                                  declaration->type_specifier,
+                                                  declaration->symbol));
+         return 1;
+      }
+      case AST_EXPRESSION:
+         return resolve_expression(repl, index);
+      case AST_COMPOUND_STATEMENT:
+         return resolve_compound_statement(repl, index);
+      case AST_SELECTION_STATEMENT: {
+         struct ast_selection_statement *selection_statement =
+            &ast->selection_statements[index];
+
+         return resolve_expression(repl, selection_statement->condition) &&
+                resolve_compound_statement(repl,
+                                           selection_statement->then_body) &&
+                (selection_statement->else_body == AST_NONE ||
+                 resolve_compound_statement(repl,
+                                            selection_statement->else_body));
+      }
+      case AST_WHILE_STATEMENT:
+         return resolve_expression(repl,
+                                   ast->while_statements[index].condition) &&
+                resolve_compound_statement(repl,
+                                           ast->while_statements[index].body);
+      case AST_FOR_STATEMENT: {
+         struct ast_for_statement *for_statement =
+            &ast->for_statements[index];
+         int resolved;
+
+         if (!resolve_expression(repl, for_statement->lower) ||
+             !resolve_expression(repl, for_statement->upper))
+            return 0;
+
+         /* the index is the body's, as in codegen */
+         vm_state_enter_scope(vm);
+         resolved = resolve_statement(repl,
+                                      AST_REF(AST_DECLARATION,
+                                              for_statement->index)) &&
+                    resolve_compound_statement(repl, for_statement->body);
+         vm_state_exit_scope(vm);
+
+         return resolved;
+      }
+      case AST_FUNCTION_DEFINITION:
+         return resolve_function_definition(repl,
+                                            &ast->function_definitions[index]);
+      case AST_RETURN_STATEMENT:
+         return resolve_expression(repl, index);
+      default:
+         return 1;
+   }
+}
+
+/* stores the value of an expression statement through the result pointer */
+static void
+build_result(struct repl *repl, LLVMValueRef function, struct vm_value *value)
+{
+   struct vm_state *vm = repl->vm;
+   LLVMValueRef pointer;
+
+   if (value->llvm_type == vm->bool_type) {
+      value->llvm_value = LLVMBuildZExt(vm->builder, value->llvm_value,
+                                        vm->int_type, "");
+      value->llvm_type = vm->int_type;
+      value->type_specifier = TYPE_INT;
+   }
+
+   pointer = LLVMBuildBitCast(vm->builder, LLVMGetParam(function, 0),
+                              LLVMPointerType(value->llvm_type, 0), "");
+   LLVMBuildStore(vm->builder, value->llvm_value, pointer);
+}
+
+/* where a failed check in the input being run jumps back to */
+static sigjmp_buf trap_return;
+static pthread_t repl_thread;
+
+/*
+ * A failed check, of an index or of the size of an array, runs
+ * llvm.trap, a SIGILL. The REPL's thread jumps back
+ * out of the input; a worker of a parallel for cannot, nor can the REPL's
+ * thread while it runs one, as the pool would be left mid-loop, so those
+ * end the process as they do outside the REPL.
+ */
+static void
+catch_trap(int signal_number)
+{
+   if (!pthread_equal(pthread_self(), repl_thread) || toy_in_parallel_for()) {
+      signal(signal_number, SIG_DFL);
+      return;
+   }
+
+   siglongjmp(trap_return, 1);
+}
+
+/* runs 'entry', returning 0 if it trapped */
+static int
+run_input(void (*entry)(void *), void *result)
+{
+   struct sigaction action = { 0 }, saved;
+
+   action.sa_handler = catch_trap;
+   sigemptyset(&action.sa_mask);
+   sigaction(SIGILL, &action, &saved);
+
+   repl_thread = pthread_self();
+   if (sigsetjmp(trap_return, 1) != 0) {
+      sigaction(SIGILL, &saved, NULL);
+      fprintf(stderr, "array index out of bounds, or negative array size\n");
+      return 0;
+   }
+
+   entry(result);
+   sigaction(SIGILL, &saved, NULL);
+   return 1;
+}
+
+void
+repl_evaluate(struct repl *repl, ast_ref statement)
+{
+   struct vm_state *vm = repl->vm;
+   LLVMValueRef function;
+   struct vm_value value = { 0 };
+   union {
+      int int_constant;
+      float float_constant;
+   } result;
+   void (*entry)(void *);
+   char name[32];
+   double start;
+   int resolved, completed;
+
+   start = timer_now();
+
+   repl->number_of_inputs++;
+   snprintf(name, sizeof(name), "repl.%u", repl->number_of_inputs);
+   function = vm_state_begin_module(vm, name, name, repl->function_type);
+
+   /* top-level declarations are defined as globals, with no code */
+   if (AST_REF_TAG(statement) == AST_DECLARATION)
+      resolved = define_global(repl, &vm->ast->declarations[
+                                        AST_REF_INDEX(statement)]);
+   else
+      resolved = resolve_statement(repl, statement);
+   if (!resolved) {
+      LLVMDisposeModule(vm->module);
+      vm->module = NULL;
+      return;
+   }
+
+   switch (AST_REF_TAG(statement)) {
+      case AST_DECLARATION:
+         break;
+      case AST_FUNCTION_DEFINITION:
+         drive_statement(vm, statement);
+         export_function(repl, vm->ast->function_definitions[
+                                  AST_REF_INDEX(statement)].symbol);
+         break;
+      case AST_EXPRESSION:
+         value = drive_expression(vm, AST_REF_INDEX(statement));
+         build_result(repl, function, &value);
+         break;
+      default:
+         drive_statement(vm, statement);
+   }
+
+   vm_state_finalize(vm);
+   vm_state_verify(vm);
+   if (repl->machine != NULL)
+      optimize_module_for_machine(vm->module, repl->machine,
+                                  repl->options->opt_level);
+   repl->lower_ms += timer_elapsed_ms(start);
+
+   /* the JIT session, and every earlier input, are reused as they are */
+   start = timer_now();
+   jit_add_module(repl->jit, vm->module);
+   vm->module = NULL;
+   entry = (void (*)(void *)) jit_lookup(repl->jit, name);
+   repl->compile_ms += timer_elapsed_ms(start);
+
+   start = timer_now();
+   completed = run_input(entry, &result);
+   repl->execute_ms += timer_elapsed_ms(start);
+   if (!completed)
+      return;
+
+   if (value.type_specifier == TYPE_INT)
+      printf("%d\n", result.int_constant);
+   else if (value.type_specifier == TYPE_FLOAT)
+      printf("%g\n", result.float_constant);
+   fflush(stdout);
+}
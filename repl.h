@@ -0,0 +1,41 @@
+#ifndef REPL_H
+#define REPL_H
+
+#include "ast.h"
+
+struct driver_options;
+struct time_report;
+struct vm_state;
+
+/*
+ * Read-eval-print loop on one long-lived JIT session. Each top-level
+ * statement is lowered into a module of its own, holding a single
+ * function that is compiled and run right away; the value of an
+ * expression statement is printed. Variables declared at the top level
+ * become globals that later modules refer to by name, so the vm_state
+ * (context, types, constants, symbol table), the JIT and the target
+ * machine all carry over from one input to the next.
+ *
+ * An if statement is only evaluated once the next token shows whether
+ * an else follows.
+ */
+struct repl;
+
+struct repl *repl_create(struct driver_options *options, struct vm_state *vm);
+
+/* adds the inputs and their time to 'report' and frees the REPL */
+void repl_destroy(struct repl *repl, struct time_report *report);
+
+/*
+ * Lowers, compiles and runs 'statement'. A statement using an undeclared
+ * variable is reported and skipped, leaving the session intact, as is
+ * one that fails a bounds check: what it stored before that stays
+ * stored. A check failing within a parallel for run on several threads
+ * still ends the process.
+ */
+void repl_evaluate(struct repl *repl, ast_ref statement);
+
+/* asks for the next input, when reading from a terminal */
+void repl_prompt(struct repl *repl);
+
+#endif /* REPL_H */
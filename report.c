@@ -0,0 +1,220 @@
+#include <sys/resource.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "ast.h"
+#include "report.h"
+
+static const char *phase_names[NUMBER_OF_PHASES] = {
+   "lex", "parse", "typecheck", "simplify", "codegen", "verify", "optimize",
+   "output"
+};
+
+void
+time_report_count_ast(struct time_report *report, struct ast *ast)
+{
+   report->declarations += ast->number_of_declarations;
+   report->expressions += ast->number_of_expressions;
+   report->compound_statements += ast->number_of_compound_statements;
+   report->selection_statements += ast->number_of_selection_statements;
+   report->while_statements += ast->number_of_while_statements;
+   report->for_statements += ast->number_of_for_statements;
+   report->function_definitions += ast->number_of_function_definitions;
+   report->ast_bytes += ast_used_bytes(ast);
+   if (ast_reserved_bytes(ast) > report->ast_reserved_bytes)
+      report->ast_reserved_bytes = ast_reserved_bytes(ast);
+}
+
+void
+time_report_count_module(struct time_report *report, LLVMModuleRef module)
+{
+   LLVMValueRef function, instruction;
+   LLVMBasicBlockRef block;
+
+   for (function = LLVMGetFirstFunction(module); function != NULL;
+        function = LLVMGetNextFunction(function)) {
+      if (LLVMIsDeclaration(function))
+         continue;
+
+      report->functions++;
+      for (block = LLVMGetFirstBasicBlock(function); block != NULL;
+           block = LLVMGetNextBasicBlock(block)) {
+         report->basic_blocks++;
+         for (instruction = LLVMGetFirstInstruction(block);
+              instruction != NULL;
+              instruction = LLVMGetNextInstruction(instruction))
+            report->instructions++;
+      }
+   }
+}
+
+/* in KB, as ru_maxrss is on Linux */
+static long
+peak_rss(void)
+{
+   struct rusage usage;
+
+   if (getrusage(RUSAGE_SELF, &usage) != 0)
+      return 0;
+
+   return usage.ru_maxrss;
+}
+
+static void
+print_json_string(const char *s, FILE *out)
+{
+   fputc('"', out);
+   for (; *s != '\0'; s++) {
+      if (*s == '"' || *s == '\\')
+         fprintf(out, "\\%c", *s);
+      else if ((unsigned char) *s < 0x20)
+         fprintf(out, "\\u%04x", *s);
+      else
+         fputc(*s, out);
+   }
+   fputc('"', out);
+}
+
+static void
+print_json(struct time_report *report, const char *input_name, double total,
+           FILE *out)
+{
+   int i;
+
+   fprintf(out, "{\"input\":");
+   print_json_string(input_name, out);
+
+   fprintf(out, ",\"phases_ms\":{");
+   for (i = 0; i < NUMBER_OF_PHASES; i++)
+      fprintf(out, "\"%s\":%.3f,", phase_names[i], report->phase_ms[i]);
+   fprintf(out, "\"total\":%.3f}", total);
+
+   fprintf(out, ",\"tokens\":%" PRIu64, report->tokens);
+   fprintf(out, ",\"ast_nodes\":{\"declaration\":%" PRIu64
+                ",\"expression\":%" PRIu64 ",\"compound\":%" PRIu64
+                ",\"selection\":%" PRIu64 ",\"while\":%" PRIu64
+                ",\"for\":%" PRIu64 ",\"function\":%" PRIu64 "}",
+                report->declarations, report->expressions,
+                report->compound_statements, report->selection_statements,
+                report->while_statements, report->for_statements,
+                report->function_definitions);
+   fprintf(out, ",\"ast_bytes\":%" PRIu64 ",\"ast_reserved_bytes\":%" PRIu64,
+                report->ast_bytes, report->ast_reserved_bytes);
+   fprintf(out, ",\"conversions\":%" PRIu64, report->conversions);
+   fprintf(out, ",\"simplify\":{\"folded\":%" PRIu64 ",\"pruned\":%" PRIu64
+                "}", report->folded_expressions, report->pruned_statements);
+   fprintf(out, ",\"vm_values\":%" PRIu64, report->values);
+   fprintf(out, ",\"symbol_lookups\":%" PRIu64 ",\"symbol_inserts\":%" PRIu64,
+                report->symbol_lookups, report->symbol_inserts);
+   fprintf(out, ",\"llvm\":{\"functions\":%" PRIu64
+                ",\"basic_blocks\":%" PRIu64 ",\"instructions\":%" PRIu64 "}",
+                report->functions, report->basic_blocks,
+                report->instructions);
+   if (report->inputs > 0)
+      fprintf(out, ",\"repl_inputs\":%" PRIu64, report->inputs);
+   if (report->loops > 0)
+      fprintf(out, ",\"tier\":{\"loops\":%" PRIu64 ",\"runs\":%" PRIu64
+                   ",\"compile_ms\":%.3f}",
+                   report->loops, report->tiered_runs,
+                   report->tier_compile_ms);
+   if (report->jit_setup_ms > 0)
+      fprintf(out, ",\"jit_ms\":{\"setup\":%.3f,\"compile\":%.3f"
+                   ",\"execute\":%.3f}",
+                   report->jit_setup_ms, report->jit_compile_ms,
+                   report->jit_execute_ms);
+   if (report->profile_sites_compiled > 0 ||
+       report->profile_sites_written > 0)
+      fprintf(out, ",\"profile_sites\":{\"compiled\":%" PRIu64
+                   ",\"matched\":%" PRIu64 ",\"written\":%" PRIu64 "}",
+                   report->profile_sites_compiled,
+                   report->profile_sites_matched,
+                   report->profile_sites_written);
+   fprintf(out, ",\"peak_rss_kb\":%ld}\n", peak_rss());
+}
+
+static void
+print_text(struct time_report *report, const char *input_name, double total,
+           FILE *out)
+{
+   uint64_t nodes;
+   int i;
+
+   fprintf(out, "time report for %s\n", input_name);
+   for (i = 0; i < NUMBER_OF_PHASES; i++)
+      fprintf(out, "   %-16s %10.3f ms  %5.1f%%\n", phase_names[i],
+                   report->phase_ms[i],
+                   total > 0 ? report->phase_ms[i] / total * 100.0 : 0.0);
+   fprintf(out, "   %-16s %10.3f ms\n", "total", total);
+
+   nodes = report->declarations + report->expressions +
+           report->compound_statements + report->selection_statements +
+           report->while_statements + report->for_statements +
+           report->function_definitions;
+   fprintf(out, "   %-16s %10" PRIu64 "\n", "tokens", report->tokens);
+   fprintf(out, "   %-16s %10" PRIu64 "   (%" PRIu64 " declarations, %"
+                PRIu64 " expressions, %" PRIu64 " compound, %" PRIu64
+                " if, %" PRIu64 " while, %" PRIu64 " for, %" PRIu64
+                " functions)\n",
+                "ast nodes", nodes,
+                report->declarations, report->expressions,
+                report->compound_statements, report->selection_statements,
+                report->while_statements, report->for_statements,
+                report->function_definitions);
+   fprintf(out, "   %-16s %10" PRIu64 "   (%" PRIu64 " reserved at the "
+                "peak)\n", "ast bytes", report->ast_bytes,
+                report->ast_reserved_bytes);
+   fprintf(out, "   %-16s %10" PRIu64 "\n", "conversions",
+                report->conversions);
+   fprintf(out, "   %-16s %10" PRIu64 "   (%" PRIu64 " statements pruned)\n",
+                "folded", report->folded_expressions,
+                report->pruned_statements);
+   fprintf(out, "   %-16s %10" PRIu64 "\n", "vm values", report->values);
+   fprintf(out, "   %-16s %10" PRIu64 "   (%" PRIu64 " inserts)\n",
+                "symbol lookups", report->symbol_lookups,
+                report->symbol_inserts);
+   fprintf(out, "   %-16s %10" PRIu64 "   (%" PRIu64 " basic blocks, %"
+                PRIu64 " functions)\n", "instructions",
+                report->instructions, report->basic_blocks,
+                report->functions);
+   if (report->inputs > 0)
+      fprintf(out, "   %-16s %10" PRIu64 "\n", "repl inputs",
+                   report->inputs);
+   if (report->loops > 0)
+      fprintf(out, "   %-16s %10" PRIu64 "   (%" PRIu64 " runs moved to "
+                   "native code, compiled in %.3f ms)\n", "tiered loops",
+                   report->loops, report->tiered_runs,
+                   report->tier_compile_ms);
+   if (report->jit_setup_ms > 0)
+      fprintf(out, "   %-16s %10.3f ms  (%.3f ms compile, %.3f ms "
+                   "execute)\n", "jit setup", report->jit_setup_ms,
+                   report->jit_compile_ms, report->jit_execute_ms);
+   if (report->profile_sites_compiled > 0)
+      fprintf(out, "   %-16s %10" PRIu64 "   (%" PRIu64 " found in the "
+                   "profile)\n", "profile sites",
+                   report->profile_sites_compiled,
+                   report->profile_sites_matched);
+   if (report->profile_sites_written > 0)
+      fprintf(out, "   %-16s %10" PRIu64 "\n", "profile written",
+                   report->profile_sites_written);
+   fprintf(out, "   %-16s %10ld KB\n", "peak rss", peak_rss());
+}
+
+void
+time_report_print(struct time_report *report, const char *input_name,
+                  int format, FILE *out)
+{
+   double total = 0;
+   int i;
+
+   for (i = 0; i < NUMBER_OF_PHASES; i++)
+      total += report->phase_ms[i];
+
+   /* one report at a time when several inputs compile in parallel */
+   flockfile(out);
+   if (format == REPORT_JSON)
+      print_json(report, input_name, total, out);
+   else
+      print_text(report, input_name, total, out);
+   funlockfile(out);
+}
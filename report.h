@@ -0,0 +1,82 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <llvm-c/Core.h>
+
+struct ast;
+
+/* output formats of -ftime-report */
+#define REPORT_TEXT        1
+#define REPORT_JSON        2
+
+#define PHASE_LEX          0
+#define PHASE_PARSE        1     /* less lexing, and lowering if streaming */
+#define PHASE_TYPECHECK    2
+#define PHASE_SIMPLIFY     3
+#define PHASE_CODEGEN      4
+#define PHASE_VERIFY       5
+#define PHASE_OPTIMIZE     6
+#define PHASE_OUTPUT       7     /* dump, emit or JIT-compile and run */
+#define NUMBER_OF_PHASES   8
+
+/*
+ * Where the time of one compile went, and how much work each phase had.
+ * The phases are timed with a few clock reads per compile (per
+ * statement while streaming) and the counters are plain increments, so
+ * they are always kept. Only timing the lexer token by token and walking
+ * the module for its size wait for -ftime-report.
+ */
+struct time_report {
+   double phase_ms[NUMBER_OF_PHASES];
+
+   uint64_t tokens;
+   uint64_t declarations;
+   uint64_t expressions;
+   uint64_t compound_statements;
+   uint64_t selection_statements;
+   uint64_t while_statements;
+   uint64_t for_statements;
+   uint64_t function_definitions;
+   uint64_t ast_bytes;
+   uint64_t ast_reserved_bytes;  /* at the peak */
+   uint64_t conversions;         /* inserted by the type checker */
+   uint64_t folded_expressions;  /* by the simplifier */
+   uint64_t pruned_statements;
+
+   uint64_t values;              /* vm_value allocations */
+   uint64_t symbol_lookups;
+   uint64_t symbol_inserts;
+
+   uint64_t functions;
+   uint64_t basic_blocks;
+   uint64_t instructions;
+
+   uint64_t inputs;              /* of --repl */
+
+   uint64_t loops;               /* of --tiered */
+   uint64_t tiered_runs;         /* of loops, moved to native code */
+   double tier_compile_ms;       /* in the background, beside the phases */
+
+   double jit_setup_ms;          /* of --run and --repl, within output */
+   double jit_compile_ms;
+   double jit_execute_ms;
+
+   uint64_t profile_sites_compiled;    /* of --profile-use */
+   uint64_t profile_sites_matched;     /* of those, found in the profile */
+   uint64_t profile_sites_written;     /* by --profile-generate */
+};
+
+/* adds the nodes of 'ast', before it is released */
+void time_report_count_ast(struct time_report *report, struct ast *ast);
+
+void time_report_count_module(struct time_report *report,
+                              LLVMModuleRef module);
+
+/* writes the report, with the peak RSS of the process so far */
+void time_report_print(struct time_report *report, const char *input_name,
+                       int format, FILE *out);
+
+#endif /* REPORT_H */
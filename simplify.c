@@ -0,0 +1,500 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ast.h"
+#include "report.h"
+#include "simplify.h"
+
+/* nothing is appended to the tree, so node pointers stay valid */
+struct simplifier {
+   int folded_expressions;
+   int pruned_statements;
+
+   struct ast *ast;
+};
+
+static void
+simplify_statement_list(struct simplifier *, struct ast_statement_list *);
+
+static int
+is_int_constant(struct ast_expression *expression, int value)
+{
+   return expression->operator == AST_INT_CONSTANT &&
+          expression->primary_expr.int_constant == value;
+}
+
+/*
+ * Whether evaluating 'index' can do more than yield a value: an index
+ * can trap, an assignment writes, a call may do either. An identity
+ * such as x * 0 may only drop an operand that cannot.
+ */
+static int
+has_side_effects(struct ast *ast, ast_index index)
+{
+   struct ast_expression *expression;
+
+   if (index == AST_NONE)
+      return 0;
+
+   expression = ast_expression(ast, index);
+   switch (expression->operator) {
+      case AST_INT_CONSTANT:
+      case AST_FLOAT_CONSTANT:
+      case AST_IDENTIFIER:
+         return 0;
+
+      case AST_ASSIGN:
+      case AST_INDEX:
+      case AST_ASSIGN_INDEX:
+      case AST_CALL:
+         return 1;
+   }
+
+   return has_side_effects(ast, expression->subexpr[0]) ||
+          has_side_effects(ast, expression->subexpr[1]);
+}
+
+/* returns 1 if 'expression' was turned into a constant */
+static int
+fold_int(struct ast *ast, struct ast_expression *expression)
+{
+   int lhs, rhs, value;
+
+   lhs = ast_expression(ast, expression->subexpr[0])->primary_expr.int_constant;
+   rhs = ast_expression(ast, expression->subexpr[1])->primary_expr.int_constant;
+
+   /* wrap around like the i32 arithmetic codegen would emit */
+   switch (expression->operator) {
+      case AST_ADD:
+         value = (int) ((unsigned) lhs + (unsigned) rhs);
+         break;
+      case AST_SUB:
+         value = (int) ((unsigned) lhs - (unsigned) rhs);
+         break;
+      case AST_MUL:
+         value = (int) ((unsigned) lhs * (unsigned) rhs);
+         break;
+      case AST_DIV:
+         /* leave undefined divisions for the program to trip over */
+         if (rhs == 0 || (lhs == INT_MIN && rhs == -1))
+            return 0;
+         value = lhs / rhs;
+         break;
+      default:
+         return 0;
+   }
+
+   expression->operator = AST_INT_CONSTANT;
+   expression->subexpr[0] = expression->subexpr[1] = AST_NONE;
+   expression->primary_expr.int_constant = value;
+   return 1;
+}
+
+static int
+fold_float(struct ast *ast, struct ast_expression *expression)
+{
+   float lhs, rhs, value;
+
+   lhs = ast_expression(ast, expression->subexpr[0])->
+         primary_expr.float_constant;
+   rhs = ast_expression(ast, expression->subexpr[1])->
+         primary_expr.float_constant;
+
+   switch (expression->operator) {
+      case AST_ADD:
+         value = lhs + rhs;
+         break;
+      case AST_SUB:
+         value = lhs - rhs;
+         break;
+      case AST_MUL:
+         value = lhs * rhs;
+         break;
+      case AST_DIV:
+         value = lhs / rhs;
+         break;
+      default:
+         return 0;
+   }
+
+   expression->operator = AST_FLOAT_CONSTANT;
+   expression->subexpr[0] = expression->subexpr[1] = AST_NONE;
+   expression->primary_expr.float_constant = value;
+   return 1;
+}
+
+/* returns 1 if the conversion of a constant was folded into the node */
+static int
+fold_conversion(struct ast *ast, struct ast_expression *expression)
+{
+   struct ast_expression *operand = ast_expression(ast,
+                                                   expression->subexpr[0]);
+   float value;
+
+   if (operand->operator == AST_INT_CONSTANT &&
+       expression->type == TYPE_FLOAT) {
+      expression->primary_expr.float_constant =
+         (float) operand->primary_expr.int_constant;
+      expression->operator = AST_FLOAT_CONSTANT;
+   } else if (operand->operator == AST_FLOAT_CONSTANT &&
+              expression->type == TYPE_INT) {
+      /* out of range, fptosi gives poison: leave that to run time */
+      value = operand->primary_expr.float_constant;
+      if (!(value > -2147483904.0f && value < 2147483648.0f))
+         return 0;
+      expression->primary_expr.int_constant = (int) value;
+      expression->operator = AST_INT_CONSTANT;
+   } else {
+      return 0;
+   }
+
+   expression->subexpr[0] = AST_NONE;
+   return 1;
+}
+
+/*
+ * Returns the index of the simplified expression: constants are folded
+ * into the node itself, identities return the surviving operand, which
+ * has the type of the node.
+ */
+static ast_index
+simplify_expression(struct simplifier *simplifier, ast_index index)
+{
+   struct ast *ast = simplifier->ast;
+   struct ast_expression *expression = ast_expression(ast, index);
+   struct ast_expression *lhs, *rhs, *argument;
+   ast_index result, next;
+
+   switch (expression->operator) {
+      case AST_ASSIGN:
+      case AST_INDEX:
+         expression->subexpr[0] = simplify_expression(simplifier,
+                                                      expression->subexpr[0]);
+         return index;
+
+      case AST_ASSIGN_INDEX:
+         expression->subexpr[0] = simplify_expression(simplifier,
+                                                      expression->subexpr[0]);
+         expression->subexpr[1] = simplify_expression(simplifier,
+                                                      expression->subexpr[1]);
+         return index;
+
+      /* an array argument is left as it is, a plain identifier */
+      case AST_CALL:
+         for (next = expression->subexpr[0]; next != AST_NONE;
+              next = argument->subexpr[1]) {
+            argument = ast_expression(ast, next);
+            argument->subexpr[0] = simplify_expression(simplifier,
+                                                       argument->subexpr[0]);
+         }
+         return index;
+
+      case AST_CONVERT:
+         expression->subexpr[0] = simplify_expression(simplifier,
+                                                      expression->subexpr[0]);
+         if (fold_conversion(ast, expression))
+            simplifier->folded_expressions++;
+         return index;
+
+      case AST_ADD: case AST_SUB:
+      case AST_MUL: case AST_DIV:
+      case AST_GT: case AST_LT:
+      case AST_EQ: case AST_NE:
+      case AST_LE: case AST_GE:
+         break;
+
+      default:
+         return index;
+   }
+
+   expression->subexpr[0] = simplify_expression(simplifier,
+                                                expression->subexpr[0]);
+   expression->subexpr[1] = simplify_expression(simplifier,
+                                                expression->subexpr[1]);
+   lhs = ast_expression(ast, expression->subexpr[0]);
+   rhs = ast_expression(ast, expression->subexpr[1]);
+
+   /* comparisons yield i1 and are only folded as conditions */
+   if (lhs->operator == AST_INT_CONSTANT &&
+       rhs->operator == AST_INT_CONSTANT) {
+      if (fold_int(ast, expression))
+         simplifier->folded_expressions++;
+      return index;
+   }
+
+   if (lhs->operator == AST_FLOAT_CONSTANT &&
+       rhs->operator == AST_FLOAT_CONSTANT) {
+      if (fold_float(ast, expression))
+         simplifier->folded_expressions++;
+      return index;
+   }
+
+   result = index;
+   if (expression->type == TYPE_INT) {
+      switch (expression->operator) {
+         case AST_ADD:
+            if (is_int_constant(rhs, 0))
+               result = expression->subexpr[0];
+            else if (is_int_constant(lhs, 0))
+               result = expression->subexpr[1];
+            break;
+         case AST_SUB:
+            if (is_int_constant(rhs, 0))
+               result = expression->subexpr[0];
+            break;
+         case AST_MUL:
+            if (is_int_constant(rhs, 1))
+               result = expression->subexpr[0];
+            else if (is_int_constant(lhs, 1))
+               result = expression->subexpr[1];
+            else if (is_int_constant(rhs, 0) &&
+                     !has_side_effects(ast, expression->subexpr[0]))
+               result = expression->subexpr[1];
+            else if (is_int_constant(lhs, 0) &&
+                     !has_side_effects(ast, expression->subexpr[1]))
+               result = expression->subexpr[0];
+            break;
+         case AST_DIV:
+            if (is_int_constant(rhs, 1))
+               result = expression->subexpr[0];
+            break;
+      }
+   }
+
+   if (result != index)
+      simplifier->folded_expressions++;
+
+   return result;
+}
+
+static int
+compare_int(int operator, int lhs, int rhs)
+{
+   switch (operator) {
+      case AST_GT: return lhs > rhs;
+      case AST_LT: return lhs < rhs;
+      case AST_EQ: return lhs == rhs;
+      case AST_NE: return lhs != rhs;
+      case AST_LE: return lhs <= rhs;
+      default:     return lhs >= rhs;
+   }
+}
+
+/* ordered comparisons, as emitted by vm_value_build_cmp_op */
+static int
+compare_float(int operator, float lhs, float rhs)
+{
+   switch (operator) {
+      case AST_GT: return lhs > rhs;
+      case AST_LT: return lhs < rhs;
+      case AST_EQ: return lhs == rhs;
+      case AST_NE: return lhs < rhs || lhs > rhs;
+      case AST_LE: return lhs <= rhs;
+      default:     return lhs >= rhs;
+   }
+}
+
+/* returns 1 if the value of 'condition' is known, storing it in 'value' */
+static int
+evaluate_condition(struct ast *ast, ast_index index, int *value)
+{
+   struct ast_expression *condition = ast_expression(ast, index);
+   struct ast_expression *lhs, *rhs;
+
+   switch (condition->operator) {
+      case AST_GT: case AST_LT:
+      case AST_EQ: case AST_NE:
+      case AST_LE: case AST_GE:
+         break;
+      default:
+         return 0;
+   }
+
+   lhs = ast_expression(ast, condition->subexpr[0]);
+   rhs = ast_expression(ast, condition->subexpr[1]);
+
+   if (lhs->operator == AST_INT_CONSTANT &&
+       rhs->operator == AST_INT_CONSTANT) {
+      *value = compare_int(condition->operator,
+                           lhs->primary_expr.int_constant,
+                           rhs->primary_expr.int_constant);
+      return 1;
+   }
+
+   if (lhs->operator == AST_FLOAT_CONSTANT &&
+       rhs->operator == AST_FLOAT_CONSTANT) {
+      *value = compare_float(condition->operator,
+                             lhs->primary_expr.float_constant,
+                             rhs->primary_expr.float_constant);
+      return 1;
+   }
+
+   return 0;
+}
+
+static void
+simplify_compound_statement(struct simplifier *simplifier, ast_index index)
+{
+   simplify_statement_list(simplifier,
+                           &simplifier->ast->compound_statements[index].
+                           statement_list);
+}
+
+/* returns the simplified statement, or AST_NONE if it can be dropped */
+static ast_ref
+simplify_statement(struct simplifier *simplifier, ast_ref statement)
+{
+   struct ast *ast = simplifier->ast;
+   ast_index index = AST_REF_INDEX(statement), body;
+   struct ast_declaration *declaration;
+   struct ast_selection_statement *selection_statement;
+   struct ast_while_statement *while_statement;
+   struct ast_for_statement *for_statement;
+   struct ast_expression *lower, *upper;
+   int value;
+
+   switch (AST_REF_TAG(statement)) {
+      case AST_DECLARATION:
+         declaration = &ast->declarations[index];
+         if (declaration->size != AST_NONE)
+            declaration->size = simplify_expression(simplifier,
+                                                    declaration->size);
+         return statement;
+
+      case AST_EXPRESSION:
+         return AST_REF(AST_EXPRESSION,
+                        simplify_expression(simplifier, index));
+
+      case AST_COMPOUND_STATEMENT:
+         simplify_compound_statement(simplifier, index);
+         return statement;
+
+      case AST_SELECTION_STATEMENT:
+         selection_statement = &ast->selection_statements[index];
+         selection_statement->condition =
+            simplify_expression(simplifier, selection_statement->condition);
+
+         /* the surviving arm keeps its own scope */
+         if (evaluate_condition(ast, selection_statement->condition, &value)) {
+            simplifier->pruned_statements++;
+            body = value ? selection_statement->then_body
+                         : selection_statement->else_body;
+            if (body == AST_NONE)
+               return AST_NONE;
+
+            simplify_compound_statement(simplifier, body);
+            return AST_REF(AST_COMPOUND_STATEMENT, body);
+         }
+
+         simplify_compound_statement(simplifier,
+                                     selection_statement->then_body);
+         if (selection_statement->else_body != AST_NONE)
+            simplify_compound_statement(simplifier,
+                                        selection_statement->else_body);
+         return statement;
+
+      case AST_WHILE_STATEMENT:
+         while_statement = &ast->while_statements[index];
+         while_statement->condition =
+            simplify_expression(simplifier, while_statement->condition);
+
+         if (evaluate_condition(ast, while_statement->condition, &value) &&
+             !value) {
+            simplifier->pruned_statements++;
+            return AST_NONE;
+         }
+
+         simplify_compound_statement(simplifier, while_statement->body);
+         return statement;
+
+      /* a loop that runs no times goes, index and all */
+      case AST_FOR_STATEMENT:
+         for_statement = &ast->for_statements[index];
+         for_statement->lower = simplify_expression(simplifier,
+                                                    for_statement->lower);
+         for_statement->upper = simplify_expression(simplifier,
+                                                    for_statement->upper);
+
+         lower = ast_expression(ast, for_statement->lower);
+         upper = ast_expression(ast, for_statement->upper);
+         if (lower->operator == AST_INT_CONSTANT &&
+             upper->operator == AST_INT_CONSTANT &&
+             lower->primary_expr.int_constant >=
+             upper->primary_expr.int_constant) {
+            simplifier->pruned_statements++;
+            return AST_NONE;
+         }
+
+         simplify_compound_statement(simplifier, for_statement->body);
+         return statement;
+
+      case AST_FUNCTION_DEFINITION:
+         simplify_compound_statement(simplifier,
+                                     ast->function_definitions[index].body);
+         return statement;
+
+      case AST_RETURN_STATEMENT:
+         return AST_REF(AST_RETURN_STATEMENT,
+                        simplify_expression(simplifier, index));
+
+      default:
+         return statement;
+   }
+}
+
+/* dropped statements are squeezed out, shrinking the list's range */
+static void
+simplify_statement_list(struct simplifier *simplifier,
+                        struct ast_statement_list *statement_list)
+{
+   ast_ref *statements, statement;
+   uint32_t i, n;
+
+   statements = &simplifier->ast->statements[statement_list->first];
+   for (i = n = 0; i < statement_list->number_of_statements; i++) {
+      statement = simplify_statement(simplifier, statements[i]);
+      if (statement != AST_NONE)
+         statements[n++] = statement;
+   }
+
+   statement_list->number_of_statements = n;
+}
+
+struct simplifier *
+simplifier_create(struct ast *ast)
+{
+   struct simplifier *simplifier;
+
+   simplifier = calloc(1, sizeof(struct simplifier));
+   if (simplifier == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   simplifier->ast = ast;
+   return simplifier;
+}
+
+void
+simplifier_destroy(struct simplifier *simplifier, struct time_report *report)
+{
+   report->folded_expressions += simplifier->folded_expressions;
+   report->pruned_statements += simplifier->pruned_statements;
+
+   free(simplifier);
+}
+
+ast_ref
+simplify_top_level_statement(struct simplifier *simplifier,
+                             ast_ref statement)
+{
+   return simplify_statement(simplifier, statement);
+}
+
+void
+simplify_translation_unit(struct simplifier *simplifier)
+{
+   simplify_statement_list(simplifier,
+                           &simplifier->ast->translation_unit.statement_list);
+}
@@ -0,0 +1,31 @@
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include "ast.h"
+
+/*
+ * Simplifies the tree in place before codegen: folds constant arithmetic,
+ * applies integer identities (x*1, x+0, x*0, ...) and drops if/while
+ * arms whose condition is statically known.
+ *
+ * It runs on a type checked tree, see typecheck.h, and takes the type of
+ * every expression from its node, so a program can be simplified either
+ * as a whole or one top-level statement at a time, releasing the tree in
+ * between. Conversions of constants are folded too.
+ */
+struct simplifier;
+struct time_report;
+
+struct simplifier *simplifier_create(struct ast *ast);
+
+/* adds the statistics to 'report' and frees the simplifier */
+void simplifier_destroy(struct simplifier *simplifier,
+                        struct time_report *report);
+
+/* returns the simplified statement, or AST_NONE if it was dropped */
+ast_ref simplify_top_level_statement(struct simplifier *simplifier,
+                                     ast_ref statement);
+
+void simplify_translation_unit(struct simplifier *simplifier);
+
+#endif /* SIMPLIFY_H */
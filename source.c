@@ -0,0 +1,131 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "source.h"
+
+int
+source_open(struct source *source, const char *filename)
+{
+   size_t page_size, length;
+   struct stat st;
+   FILE *input;
+   char *data;
+   int fd, saved_errno;
+
+   memset(source, 0, sizeof(struct source));
+
+   fd = open(filename, O_RDONLY);
+   if (fd < 0)
+      return -1;
+   if (fstat(fd, &st) != 0) {
+      saved_errno = errno;
+      close(fd);
+      errno = saved_errno;
+      return -1;
+   }
+
+   /* /dev/stdin, a named pipe and the like cannot be mapped */
+   if (!S_ISREG(st.st_mode)) {
+      input = fdopen(fd, "r");
+      if (input == NULL) {
+         saved_errno = errno;
+         close(fd);
+         errno = saved_errno;
+         return -1;
+      }
+      source_read(source, input);
+      fclose(input);
+      return 0;
+   }
+
+   page_size = sysconf(_SC_PAGESIZE);
+   length = ((size_t) st.st_size + SOURCE_PADDING + page_size - 1) &
+            ~(page_size - 1);
+
+   /* the file goes over the start of it; the rest reads as zeros */
+   data = mmap(NULL, length, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (data == MAP_FAILED ||
+       (st.st_size > 0 &&
+        mmap(data, st.st_size, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)) {
+      saved_errno = errno;
+      if (data != MAP_FAILED)
+         munmap(data, length);
+      close(fd);
+      errno = saved_errno;
+      return -1;
+   }
+   close(fd);
+
+   if (st.st_size > 0)
+      madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+   source->data = data;
+   source->size = st.st_size;
+   source->mapped_size = length;
+
+   return 0;
+}
+
+void
+source_read(struct source *source, FILE *input)
+{
+   size_t capacity = 64 * 1024, n;
+
+   memset(source, 0, sizeof(struct source));
+
+   source->data = malloc(capacity);
+   for (;;) {
+      if (source->data == NULL) {
+         fprintf(stderr, "Memory allocation request failed.\n");
+         exit(EXIT_FAILURE);
+      }
+
+      n = fread(source->data + source->size, 1,
+                capacity - SOURCE_PADDING - source->size, input);
+      source->size += n;
+      if (source->size < capacity - SOURCE_PADDING)
+         break;
+
+      capacity *= 2;
+      source->data = realloc(source->data, capacity);
+   }
+
+   memset(source->data + source->size, 0, SOURCE_PADDING);
+}
+
+void
+source_release(struct source *source, const char *position)
+{
+   size_t end;
+
+   if (source->mapped_size == 0)
+      return;
+
+   end = (position - source->data) & ~((size_t) sysconf(_SC_PAGESIZE) - 1);
+   if (end < source->released + SOURCE_RELEASE_STEP)
+      return;
+
+   madvise(source->data + source->released, end - source->released,
+           MADV_DONTNEED);
+   source->released = end;
+}
+
+void
+source_close(struct source *source)
+{
+   if (source->mapped_size != 0)
+      munmap(source->data, source->mapped_size);
+   else
+      free(source->data);
+
+   source->data = NULL;
+}
@@ -0,0 +1,41 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/* the scanner wants its buffer to end in two NUL bytes */
+#define SOURCE_PADDING        2
+
+/* scanned pages are given back in steps of this, see source_release() */
+#define SOURCE_RELEASE_STEP   (8 << 20)
+
+/*
+ * The text of one input, scanned in place. A regular file is mapped
+ * privately, on top of a zeroed anonymous mapping one page longer, so the
+ * padding is there without copying the file; the scanner's writes (it
+ * NUL-terminates each token for a moment) only touch private pages.
+ * Anything else, a pipe or a terminal, is read into memory.
+ */
+struct source {
+   char *data;             /* 'size' bytes, then SOURCE_PADDING NULs */
+   size_t size;
+   size_t mapped_size;     /* 0 when read rather than mapped */
+   size_t released;        /* bytes of the mapping already given back */
+};
+
+/* returns 0, or -1 with errno set if 'filename' cannot be opened */
+int source_open(struct source *source, const char *filename);
+
+/* reads what is left of 'input', for when there is no file to map */
+void source_read(struct source *source, FILE *input);
+
+/*
+ * Drops the pages before 'position', which the scanner is done with;
+ * otherwise a large input would end up copied page by page anyway.
+ */
+void source_release(struct source *source, const char *position);
+
+void source_close(struct source *source);
+
+#endif /* SOURCE_H */
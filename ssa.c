@@ -0,0 +1,371 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash_map.h"
+#include "ssa.h"
+
+struct ssa_phi {
+   int variable;
+   LLVMValueRef phi;
+};
+
+struct ssa_block {
+   LLVMBasicBlockRef block;
+   int sealed;
+
+   LLVMBasicBlockRef *predecessors;
+   int number_of_predecessors;
+   int predecessors_capacity;
+
+   struct ssa_phi *incomplete_phis;
+   int number_of_incomplete_phis;
+   int incomplete_phis_capacity;
+};
+
+static void *
+xrealloc(void *ptr, size_t size)
+{
+   ptr = realloc(ptr, size);
+   if (ptr == NULL) {
+      fprintf(stderr, "Memory reallocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   return ptr;
+}
+
+static void *
+grow_array(void *array, int *capacity, size_t element_size)
+{
+   *capacity = *capacity ? 2 * *capacity : 8;
+   return xrealloc(array, *capacity * element_size);
+}
+
+static uint64_t
+definition_key(int block, int variable)
+{
+   return ((uint64_t) (block + 1) << 32) | (uint32_t) variable;
+}
+
+struct ssa_builder *
+ssa_builder_create(LLVMContextRef context, LLVMBasicBlockRef entry_block)
+{
+   struct ssa_builder *ssa;
+
+   ssa = calloc(1, sizeof(struct ssa_builder));
+   if (ssa == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   ssa->phi_builder = LLVMCreateBuilderInContext(context);
+   ssa->block_index = hash_map_create();
+   ssa->definitions = hash_map_create();
+   ssa->replacements = hash_map_create();
+
+   /* the entry block has no predecessors, ever */
+   ssa_seal_block(ssa, entry_block);
+
+   return ssa;
+}
+
+void
+ssa_builder_destroy(struct ssa_builder *ssa)
+{
+   int i;
+
+   for (i = 0; i < ssa->number_of_blocks; i++) {
+      free(ssa->blocks[i].predecessors);
+      free(ssa->blocks[i].incomplete_phis);
+   }
+
+   LLVMDisposeBuilder(ssa->phi_builder);
+   hash_map_destroy(ssa->block_index);
+   hash_map_destroy(ssa->definitions);
+   hash_map_destroy(ssa->replacements);
+   free(ssa->blocks);
+   free(ssa->variable_types);
+   free(ssa->removed_phis);
+   free(ssa->pending_phis);
+   free(ssa);
+}
+
+/* block records are created on first use; indices are stable */
+static int
+ssa_get_block(struct ssa_builder *ssa, LLVMBasicBlockRef block)
+{
+   uintptr_t index;
+
+   index = (uintptr_t) hash_map_get(ssa->block_index, (uintptr_t) block);
+   if (index != 0)
+      return index - 1;
+
+   if (ssa->number_of_blocks == ssa->blocks_capacity) {
+      ssa->blocks = grow_array(ssa->blocks, &ssa->blocks_capacity,
+                               sizeof(struct ssa_block));
+   }
+
+   index = ssa->number_of_blocks++;
+   memset(&ssa->blocks[index], 0, sizeof(struct ssa_block));
+   ssa->blocks[index].block = block;
+   hash_map_put(ssa->block_index, (uintptr_t) block, (void *) (index + 1));
+
+   return index;
+}
+
+int
+ssa_declare_variable(struct ssa_builder *ssa, LLVMTypeRef type)
+{
+   if (ssa->number_of_variables == ssa->variables_capacity) {
+      ssa->variable_types = grow_array(ssa->variable_types,
+                                       &ssa->variables_capacity,
+                                       sizeof(LLVMTypeRef));
+   }
+
+   ssa->variable_types[ssa->number_of_variables] = type;
+   return ssa->number_of_variables++;
+}
+
+/* follows the chain of replacements of phis found to be trivial */
+static LLVMValueRef
+ssa_resolve(struct ssa_builder *ssa, LLVMValueRef value)
+{
+   LLVMValueRef replacement;
+
+   while ((replacement = hash_map_get(ssa->replacements,
+                                     (uintptr_t) value)) != NULL)
+      value = replacement;
+
+   return value;
+}
+
+static void
+ssa_write(struct ssa_builder *ssa, int variable, int block,
+          LLVMValueRef value)
+{
+   hash_map_put(ssa->definitions, definition_key(block, variable), value);
+}
+
+void
+ssa_write_variable(struct ssa_builder *ssa, int variable,
+                   LLVMBasicBlockRef block, LLVMValueRef value)
+{
+   ssa_write(ssa, variable, ssa_get_block(ssa, block), value);
+}
+
+static LLVMValueRef
+ssa_new_phi(struct ssa_builder *ssa, int variable, int block)
+{
+   LLVMBasicBlockRef basic_block = ssa->blocks[block].block;
+   LLVMValueRef first;
+
+   /* phis have to stay in front of every other instruction */
+   first = LLVMGetFirstInstruction(basic_block);
+   if (first != NULL)
+      LLVMPositionBuilderBefore(ssa->phi_builder, first);
+   else
+      LLVMPositionBuilderAtEnd(ssa->phi_builder, basic_block);
+
+   return LLVMBuildPhi(ssa->phi_builder, ssa->variable_types[variable], "");
+}
+
+static LLVMValueRef ssa_read(struct ssa_builder *, int variable, int block);
+
+static int
+ssa_is_pending_phi(struct ssa_builder *ssa, LLVMValueRef phi)
+{
+   int i;
+
+   for (i = ssa->number_of_pending_phis - 1; i >= 0; i--)
+      if (ssa->pending_phis[i] == phi)
+         return 1;
+
+   return 0;
+}
+
+static LLVMValueRef
+ssa_try_remove_trivial_phi(struct ssa_builder *ssa, LLVMValueRef phi)
+{
+   LLVMValueRef same, operand, user, *users;
+   LLVMUseRef use;
+   unsigned i, n;
+   int number_of_users, users_capacity;
+
+   same = NULL;
+   n = LLVMCountIncoming(phi);
+   for (i = 0; i < n; i++) {
+      operand = LLVMGetIncomingValue(phi, i);
+      if (operand == same || operand == phi)
+         continue;
+      if (same != NULL)
+         return phi;    /* merges at least two values: not trivial */
+      same = operand;
+   }
+
+   if (same == NULL)
+      same = LLVMGetUndef(LLVMTypeOf(phi));
+
+   /* remember the phis using this one, they may become trivial too */
+   users = NULL;
+   number_of_users = users_capacity = 0;
+   for (use = LLVMGetFirstUse(phi); use != NULL; use = LLVMGetNextUse(use)) {
+      user = LLVMGetUser(use);
+      if (user == phi || LLVMIsAPHINode(user) == NULL)
+         continue;
+      if (number_of_users == users_capacity)
+         users = grow_array(users, &users_capacity, sizeof(LLVMValueRef));
+      users[number_of_users++] = user;
+   }
+
+   /*
+    * The phi is erased only in ssa_builder_finalize(), so definitions
+    * still referring to it can be forwarded without ever seeing a
+    * dangling (or recycled) pointer.
+    */
+   LLVMReplaceAllUsesWith(phi, same);
+   hash_map_put(ssa->replacements, (uintptr_t) phi, same);
+
+   if (ssa->number_of_removed_phis == ssa->removed_phis_capacity) {
+      ssa->removed_phis = grow_array(ssa->removed_phis,
+                                     &ssa->removed_phis_capacity,
+                                     sizeof(LLVMValueRef));
+   }
+   ssa->removed_phis[ssa->number_of_removed_phis++] = phi;
+
+   /* phis still being filled are checked once they are complete */
+   for (i = 0; i < (unsigned) number_of_users; i++) {
+      if (hash_map_get(ssa->replacements, (uintptr_t) users[i]) == NULL &&
+          !ssa_is_pending_phi(ssa, users[i]))
+         ssa_try_remove_trivial_phi(ssa, users[i]);
+   }
+
+   free(users);
+   return ssa_resolve(ssa, same);
+}
+
+static LLVMValueRef
+ssa_add_phi_operands(struct ssa_builder *ssa, int variable, int block,
+                     LLVMValueRef phi)
+{
+   LLVMBasicBlockRef predecessor;
+   LLVMValueRef value;
+   int i;
+
+   if (ssa->number_of_pending_phis == ssa->pending_phis_capacity) {
+      ssa->pending_phis = grow_array(ssa->pending_phis,
+                                     &ssa->pending_phis_capacity,
+                                     sizeof(LLVMValueRef));
+   }
+   ssa->pending_phis[ssa->number_of_pending_phis++] = phi;
+
+   for (i = 0; i < ssa->blocks[block].number_of_predecessors; i++) {
+      predecessor = ssa->blocks[block].predecessors[i];
+      value = ssa_read(ssa, variable, ssa_get_block(ssa, predecessor));
+      LLVMAddIncoming(phi, &value, &predecessor, 1);
+   }
+
+   ssa->number_of_pending_phis--;
+
+   return ssa_try_remove_trivial_phi(ssa, phi);
+}
+
+static LLVMValueRef
+ssa_read_recursive(struct ssa_builder *ssa, int variable, int block)
+{
+   struct ssa_block *b = &ssa->blocks[block];
+   LLVMValueRef value;
+
+   if (!b->sealed) {
+      /* operands are added once all predecessors are known */
+      value = ssa_new_phi(ssa, variable, block);
+
+      if (b->number_of_incomplete_phis == b->incomplete_phis_capacity) {
+         b->incomplete_phis = grow_array(b->incomplete_phis,
+                                         &b->incomplete_phis_capacity,
+                                         sizeof(struct ssa_phi));
+      }
+      b->incomplete_phis[b->number_of_incomplete_phis].variable = variable;
+      b->incomplete_phis[b->number_of_incomplete_phis].phi = value;
+      b->number_of_incomplete_phis++;
+   } else if (b->number_of_predecessors == 0) {
+      value = LLVMGetUndef(ssa->variable_types[variable]);
+   } else if (b->number_of_predecessors == 1) {
+      value = ssa_read(ssa, variable,
+                       ssa_get_block(ssa, b->predecessors[0]));
+   } else {
+      /* break cycles through loops with an operandless phi first */
+      value = ssa_new_phi(ssa, variable, block);
+      ssa_write(ssa, variable, block, value);
+      value = ssa_add_phi_operands(ssa, variable, block, value);
+   }
+
+   ssa_write(ssa, variable, block, value);
+   return value;
+}
+
+static LLVMValueRef
+ssa_read(struct ssa_builder *ssa, int variable, int block)
+{
+   LLVMValueRef value;
+
+   value = hash_map_get(ssa->definitions, definition_key(block, variable));
+   if (value != NULL)
+      return ssa_resolve(ssa, value);
+
+   return ssa_read_recursive(ssa, variable, block);
+}
+
+LLVMValueRef
+ssa_read_variable(struct ssa_builder *ssa, int variable,
+                  LLVMBasicBlockRef block)
+{
+   return ssa_read(ssa, variable, ssa_get_block(ssa, block));
+}
+
+void
+ssa_add_predecessor(struct ssa_builder *ssa, LLVMBasicBlockRef block,
+                    LLVMBasicBlockRef predecessor)
+{
+   int index = ssa_get_block(ssa, block);
+   struct ssa_block *b = &ssa->blocks[index];
+
+   if (b->number_of_predecessors == b->predecessors_capacity) {
+      b->predecessors = grow_array(b->predecessors,
+                                   &b->predecessors_capacity,
+                                   sizeof(LLVMBasicBlockRef));
+   }
+
+   b->predecessors[b->number_of_predecessors++] = predecessor;
+}
+
+void
+ssa_seal_block(struct ssa_builder *ssa, LLVMBasicBlockRef block)
+{
+   struct ssa_phi *incomplete;
+   int index, i;
+
+   index = ssa_get_block(ssa, block);
+
+   /* the blocks array may move while operands are added */
+   for (i = 0; i < ssa->blocks[index].number_of_incomplete_phis; i++) {
+      incomplete = &ssa->blocks[index].incomplete_phis[i];
+      ssa_add_phi_operands(ssa, incomplete->variable, index,
+                           incomplete->phi);
+   }
+
+   ssa->blocks[index].number_of_incomplete_phis = 0;
+   ssa->blocks[index].sealed = 1;
+}
+
+void
+ssa_builder_finalize(struct ssa_builder *ssa)
+{
+   int i;
+
+   for (i = 0; i < ssa->number_of_removed_phis; i++)
+      LLVMInstructionEraseFromParent(ssa->removed_phis[i]);
+
+   ssa->number_of_removed_phis = 0;
+}
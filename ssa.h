@@ -0,0 +1,64 @@
+#ifndef SSA_H
+#define SSA_H
+
+#include <llvm-c/Core.h>
+
+struct hash_map;
+
+/*
+ * On-the-fly SSA construction (Braun et al., "Simple and Efficient
+ * Construction of Static Single Assignment Form", CC 2013).
+ *
+ * Variables live in SSA values instead of allocas: writes record the
+ * current definition per basic block, reads look it up and insert phi
+ * nodes at join points as needed. A block must be sealed once all of its
+ * predecessors are known; reads in unsealed blocks produce incomplete
+ * phis that are filled in when the block is sealed. Trivial phis are
+ * removed as soon as they are detected.
+ */
+struct ssa_builder {
+   LLVMBuilderRef phi_builder;
+
+   struct ssa_block *blocks;
+   int number_of_blocks;
+   int blocks_capacity;
+
+   LLVMTypeRef *variable_types;
+   int number_of_variables;
+   int variables_capacity;
+
+   struct hash_map *block_index;     /* LLVMBasicBlockRef -> block */
+   struct hash_map *definitions;     /* (block, variable) -> value */
+   struct hash_map *replacements;    /* removed phi -> replacement */
+
+   LLVMValueRef *removed_phis;
+   int number_of_removed_phis;
+   int removed_phis_capacity;
+
+   /* phis whose operands are being added right now */
+   LLVMValueRef *pending_phis;
+   int number_of_pending_phis;
+   int pending_phis_capacity;
+};
+
+struct ssa_builder *ssa_builder_create(LLVMContextRef context,
+                                       LLVMBasicBlockRef entry_block);
+void ssa_builder_destroy(struct ssa_builder *ssa);
+
+int ssa_declare_variable(struct ssa_builder *ssa, LLVMTypeRef type);
+
+void ssa_write_variable(struct ssa_builder *ssa, int variable,
+                        LLVMBasicBlockRef block, LLVMValueRef value);
+
+LLVMValueRef ssa_read_variable(struct ssa_builder *ssa, int variable,
+                               LLVMBasicBlockRef block);
+
+void ssa_add_predecessor(struct ssa_builder *ssa, LLVMBasicBlockRef block,
+                         LLVMBasicBlockRef predecessor);
+
+void ssa_seal_block(struct ssa_builder *ssa, LLVMBasicBlockRef block);
+
+/* deletes the phis found to be trivial; call once codegen is done */
+void ssa_builder_finalize(struct ssa_builder *ssa);
+
+#endif /* SSA_H */
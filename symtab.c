@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "vm_value.h"
 #include "symtab.h"
 
@@ -8,37 +9,116 @@ symbol_table_create(void)
 {
    struct symbol_table *symtab;
 
-   symtab = calloc(1, sizeof(struct symbol_table *));
+   symtab = calloc(1, sizeof(struct symbol_table));
    if (symtab == NULL) {
       fprintf(stderr, "Memory allocation request failed.\n");
       exit(EXIT_FAILURE);
    }
 
-   symtab->ht_symbols = g_hash_table_new(g_str_hash, g_str_equal);
    return symtab;
 }
 
 void
 symbol_table_destroy(struct symbol_table *symtab)
 {
-   g_hash_table_destroy(symtab->ht_symbols);
+   free(symtab->values);
+   free(symtab->undo_log);
+   free(symtab->scopes);
+   free(symtab);
+}
+
+static void *
+grow_array(void *array, int *capacity, size_t element_size)
+{
+   *capacity = *capacity ? 2 * *capacity : 64;
+
+   array = realloc(array, *capacity * element_size);
+   if (array == NULL) {
+      fprintf(stderr, "Memory reallocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   return array;
+}
+
+static void
+symbol_table_grow(struct symbol_table *symtab, int symbol)
+{
+   int capacity;
+
+   capacity = symtab->capacity ? symtab->capacity : 256;
+   while (capacity <= symbol)
+      capacity *= 2;
+
+   symtab->values = realloc(symtab->values,
+                            capacity * sizeof(struct vm_value *));
+   if (symtab->values == NULL) {
+      fprintf(stderr, "Memory reallocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   memset(symtab->values + symtab->capacity, 0,
+          (capacity - symtab->capacity) * sizeof(struct vm_value *));
+   symtab->capacity = capacity;
 }
 
 void
 symbol_table_put_value(struct symbol_table *symtab,
                        struct vm_value *vmval)
 {
-   const char *identifier;
+   struct symbol_table_undo *undo;
+
+   symtab->inserts++;
+   if (vmval->symbol >= symtab->capacity)
+      symbol_table_grow(symtab, vmval->symbol);
 
-   identifier = vmval->identifier;
-   g_hash_table_insert(symtab->ht_symbols, (gpointer) identifier, vmval);
+   /* declarations at global scope are never undone */
+   if (symtab->number_of_scopes > 0) {
+      if (symtab->undo_log_size == symtab->undo_log_capacity) {
+         symtab->undo_log = grow_array(symtab->undo_log,
+                                       &symtab->undo_log_capacity,
+                                       sizeof(struct symbol_table_undo));
+      }
+
+      undo = &symtab->undo_log[symtab->undo_log_size++];
+      undo->symbol = vmval->symbol;
+      undo->shadowed = symtab->values[vmval->symbol];
+   }
+
+   symtab->values[vmval->symbol] = vmval;
 }
 
 struct vm_value *
-symbol_table_get_value(struct symbol_table *symtab,
-                       const char *identifier)
+symbol_table_get_value(struct symbol_table *symtab, int symbol)
 {
-   return g_hash_table_lookup(symtab->ht_symbols, identifier);
+   symtab->lookups++;
+   if (symbol >= symtab->capacity)
+      return NULL;
+
+   return symtab->values[symbol];
 }
 
+void
+symbol_table_enter_scope(struct symbol_table *symtab)
+{
+   if (symtab->number_of_scopes == symtab->scopes_capacity) {
+      symtab->scopes = grow_array(symtab->scopes, &symtab->scopes_capacity,
+                                  sizeof(int));
+   }
 
+   symtab->scopes[symtab->number_of_scopes++] = symtab->undo_log_size;
+}
+
+void
+symbol_table_exit_scope(struct symbol_table *symtab)
+{
+   struct symbol_table_undo *undo;
+   int mark;
+
+   mark = symtab->scopes[--symtab->number_of_scopes];
+
+   while (symtab->undo_log_size > mark) {
+      undo = &symtab->undo_log[--symtab->undo_log_size];
+      symtab->values[undo->symbol] = undo->shadowed;
+   }
+}
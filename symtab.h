@@ -1,12 +1,40 @@
 #ifndef SYMTAB_H
 #define SYMTAB_H
 
-#include <glib.h>
+#include <stdint.h>
 
 struct vm_value;
 
+struct symbol_table_undo {
+   int symbol;
+   struct vm_value *shadowed;
+};
+
+/*
+ * Symbols are interned (see intern.h), so their ids are dense and the
+ * table is a flat array indexed directly by symbol id, holding the
+ * innermost visible binding.
+ *
+ * Block scoping uses an undo log: every declaration records the binding
+ * it shadows, and a scope is just the log height at the time it was
+ * entered. Entering a scope is O(1); leaving it replays only the undo
+ * entries of that scope. Neither allocates nor rehashes anything.
+ */
 struct symbol_table {
-   GHashTable *ht_symbols;
+   struct vm_value **values;
+   int capacity;
+
+   struct symbol_table_undo *undo_log;
+   int undo_log_size;
+   int undo_log_capacity;
+
+   int *scopes;
+   int number_of_scopes;
+   int scopes_capacity;
+
+   /* for -ftime-report */
+   uint64_t lookups;
+   uint64_t inserts;
 };
 
 struct symbol_table *symbol_table_create(void);
@@ -17,7 +45,9 @@ symbol_table_put_value(struct symbol_table *symtab,
                        struct vm_value *vmval);
 
 struct vm_value *
-symbol_table_get_value(struct symbol_table *symtab,
-                       const char *identifier);
+symbol_table_get_value(struct symbol_table *symtab, int symbol);
+
+void symbol_table_enter_scope(struct symbol_table *symtab);
+void symbol_table_exit_scope(struct symbol_table *symtab);
 
 #endif /* SYMTAB_H */
@@ -0,0 +1,85 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <llvm-c/Core.h>
+#include <llvm-c/Target.h>
+
+#include "target.h"
+
+static LLVMCodeGenOptLevel
+get_codegen_opt_level(int opt_level)
+{
+   switch (opt_level) {
+      case 0:
+         return LLVMCodeGenLevelNone;
+      case 1:
+         return LLVMCodeGenLevelLess;
+      case 2:
+         return LLVMCodeGenLevelDefault;
+      default:
+         return LLVMCodeGenLevelAggressive;
+   }
+}
+
+static pthread_once_t target_once = PTHREAD_ONCE_INIT;
+
+static void
+target_register_native(void)
+{
+   LLVMInitializeNativeTarget();
+   LLVMInitializeNativeAsmPrinter();
+}
+
+void
+target_initialize(void)
+{
+   pthread_once(&target_once, target_register_native);
+}
+
+LLVMTargetMachineRef
+target_machine_create_host(int opt_level)
+{
+   LLVMTargetMachineRef machine;
+   LLVMTargetRef target;
+   char *triple, *cpu, *features, *error;
+
+   target_initialize();
+
+   triple = LLVMGetDefaultTargetTriple();
+   if (LLVMGetTargetFromTriple(triple, &target, &error)) {
+      fprintf(stderr, "Unable to find target for %s: %s\n", triple, error);
+      exit(EXIT_FAILURE);
+   }
+
+   cpu = LLVMGetHostCPUName();
+   features = LLVMGetHostCPUFeatures();
+
+   machine = LLVMCreateTargetMachine(target, triple, cpu, features,
+                                     get_codegen_opt_level(opt_level),
+                                     LLVMRelocPIC, LLVMCodeModelDefault);
+
+   LLVMDisposeMessage(triple);
+   LLVMDisposeMessage(cpu);
+   LLVMDisposeMessage(features);
+
+   return machine;
+}
+
+void
+target_machine_configure_module(LLVMTargetMachineRef machine,
+                                LLVMModuleRef module)
+{
+   LLVMTargetDataRef data_layout;
+   char *triple, *data_layout_str;
+
+   triple = LLVMGetTargetMachineTriple(machine);
+   LLVMSetTarget(module, triple);
+   LLVMDisposeMessage(triple);
+
+   data_layout = LLVMCreateTargetDataLayout(machine);
+   data_layout_str = LLVMCopyStringRepOfTargetData(data_layout);
+   LLVMSetDataLayout(module, data_layout_str);
+   LLVMDisposeMessage(data_layout_str);
+   LLVMDisposeTargetData(data_layout);
+}
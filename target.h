@@ -0,0 +1,16 @@
+#ifndef TARGET_H
+#define TARGET_H
+
+#include <llvm-c/TargetMachine.h>
+
+/* registers the native target; safe to call from any thread */
+void target_initialize(void);
+
+/* target machine for the host, tuned for its CPU */
+LLVMTargetMachineRef target_machine_create_host(int opt_level);
+
+/* stamps the target triple and data layout of 'machine' on 'module' */
+void target_machine_configure_module(LLVMTargetMachineRef machine,
+                                     LLVMModuleRef module);
+
+#endif /* TARGET_H */
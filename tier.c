@@ -0,0 +1,283 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "driver.h"
+#include "intern.h"
+#include "jit.h"
+#include "optimizer.h"
+#include "tier.h"
+#include "timer.h"
+
+static void
+add_symbol(struct tier_symbols *symbols, int symbol)
+{
+   int number_of_stamps;
+
+   if (symbol >= symbols->number_of_stamps) {
+      number_of_stamps = intern_number_of_symbols();
+      symbols->stamps = realloc(symbols->stamps,
+                                number_of_stamps * sizeof(uint32_t));
+      if (symbols->stamps == NULL) {
+         fprintf(stderr, "Memory reallocation request failed.\n");
+         exit(EXIT_FAILURE);
+      }
+      memset(symbols->stamps + symbols->number_of_stamps, 0,
+             (number_of_stamps - symbols->number_of_stamps) *
+             sizeof(uint32_t));
+      symbols->number_of_stamps = number_of_stamps;
+   }
+
+   if (symbols->stamps[symbol] == symbols->stamp)
+      return;
+   symbols->stamps[symbol] = symbols->stamp;
+
+   if (symbols->number_of_symbols == symbols->capacity) {
+      symbols->capacity = symbols->capacity ? 2 * symbols->capacity : 16;
+      symbols->symbols = realloc(symbols->symbols,
+                                 symbols->capacity * sizeof(int));
+      if (symbols->symbols == NULL) {
+         fprintf(stderr, "Memory reallocation request failed.\n");
+         exit(EXIT_FAILURE);
+      }
+   }
+   symbols->symbols[symbols->number_of_symbols++] = symbol;
+}
+
+static void
+add_expression_symbols(struct tier_symbols *symbols, struct ast *ast,
+                       ast_index index)
+{
+   struct ast_expression *expression = ast_expression(ast, index);
+
+   switch (expression->operator) {
+      case AST_INT_CONSTANT:
+      case AST_FLOAT_CONSTANT:
+         return;
+
+      case AST_IDENTIFIER:
+         add_symbol(symbols, expression->primary_expr.symbol);
+         return;
+
+      case AST_INDEX:
+      case AST_ASSIGN:
+      case AST_ASSIGN_INDEX:
+         add_symbol(symbols, expression->primary_expr.symbol);
+         break;
+   }
+
+   /* a call's symbol is a function, which every loop can call anyway */
+   if (expression->subexpr[0] != AST_NONE)
+      add_expression_symbols(symbols, ast, expression->subexpr[0]);
+   if (expression->subexpr[1] != AST_NONE)
+      add_expression_symbols(symbols, ast, expression->subexpr[1]);
+}
+
+static int add_compound_symbols(struct tier_symbols *, struct ast *,
+                                ast_index);
+
+static int
+add_statement_symbols(struct tier_symbols *symbols, struct ast *ast,
+                      ast_ref statement)
+{
+   ast_index index = AST_REF_INDEX(statement);
+   struct ast_selection_statement *selection_statement;
+   struct ast_while_statement *while_statement;
+   struct ast_for_statement *for_statement;
+
+   switch (AST_REF_TAG(statement)) {
+      case AST_DECLARATION:
+         if (ast->declarations[index].size != AST_NONE)
+            add_expression_symbols(symbols, ast,
+                                   ast->declarations[index].size);
+         return 1;
+
+      case AST_EXPRESSION:
+         add_expression_symbols(symbols, ast, index);
+         return 1;
+
+      case AST_COMPOUND_STATEMENT:
+         return add_compound_symbols(symbols, ast, index);
+
+      case AST_SELECTION_STATEMENT:
+         selection_statement = &ast->selection_statements[index];
+         add_expression_symbols(symbols, ast, selection_statement->condition);
+         return add_compound_symbols(symbols, ast,
+                                     selection_statement->then_body) &&
+                (selection_statement->else_body == AST_NONE ||
+                 add_compound_symbols(symbols, ast,
+                                      selection_statement->else_body));
+
+      case AST_WHILE_STATEMENT:
+         while_statement = &ast->while_statements[index];
+         add_expression_symbols(symbols, ast, while_statement->condition);
+         return add_compound_symbols(symbols, ast, while_statement->body);
+
+      /* the index is the body's own */
+      case AST_FOR_STATEMENT:
+         for_statement = &ast->for_statements[index];
+         add_expression_symbols(symbols, ast, for_statement->lower);
+         add_expression_symbols(symbols, ast, for_statement->upper);
+         return add_compound_symbols(symbols, ast, for_statement->body);
+
+      /* leaving the function is not something a loop can do on its own */
+      default:
+         return 0;
+   }
+}
+
+static int
+add_compound_symbols(struct tier_symbols *symbols, struct ast *ast,
+                     ast_index index)
+{
+   struct ast_statement_list *statement_list;
+   uint32_t i;
+
+   statement_list = &ast->compound_statements[index].statement_list;
+   for (i = 0; i < statement_list->number_of_statements; i++)
+      if (!add_statement_symbols(symbols, ast,
+                                 ast->statements[statement_list->first + i]))
+         return 0;
+
+   return 1;
+}
+
+int
+tier_loop_symbols(struct tier_symbols *symbols, struct ast *ast,
+                  struct ast_while_statement *loop)
+{
+   symbols->number_of_symbols = 0;
+   symbols->stamp++;
+
+   add_expression_symbols(symbols, ast, loop->condition);
+   return add_compound_symbols(symbols, ast, loop->body);
+}
+
+void
+tier_symbols_destroy(struct tier_symbols *symbols)
+{
+   free(symbols->symbols);
+   free(symbols->stamps);
+}
+
+/*
+ * The background thread. Lowering takes the driver's tree and vm_state,
+ * which the interpreter no longer needs, so nothing is shared but the
+ * state word.
+ */
+static void *
+tier_compile(void *arg)
+{
+   struct tier *tier = arg;
+   LLVMModuleRef module;
+   char name[32];
+   double start;
+   uint32_t i;
+   int state = TIER_COMPILING;
+
+   start = timer_now();
+   intern_borrow(tier->names);
+   module = driver_lower_loops(tier->driver);
+   if (atomic_load(&tier->state) == TIER_CANCELLED) {
+      LLVMDisposeModule(module);
+      return NULL;
+   }
+
+   optimize_module(module, TIER_OPT_LEVEL);
+   if (atomic_load(&tier->state) == TIER_CANCELLED) {
+      LLVMDisposeModule(module);
+      return NULL;
+   }
+
+   tier->jit = jit_create(NULL);
+   jit_add_module(tier->jit, module);
+
+   tier->loops = malloc(tier->number_of_loops *
+                        sizeof(tier_loop_function *));
+   if (tier->loops == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   /* the first lookup compiles the whole module */
+   for (i = 0; i < tier->number_of_loops; i++) {
+      snprintf(name, sizeof(name), "loop.%u", i);
+      tier->loops[i] = (tier_loop_function *) jit_lookup(tier->jit, name);
+   }
+   tier->compile_ms = timer_elapsed_ms(start);
+
+   atomic_compare_exchange_strong(&tier->state, &state, TIER_READY);
+
+   return NULL;
+}
+
+struct tier *
+tier_create(struct driver *driver, uint32_t number_of_loops)
+{
+   struct tier *tier;
+
+   tier = calloc(1, sizeof(struct tier));
+   if (tier == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   tier->driver = driver;
+   tier->names = intern_lend();
+   tier->number_of_loops = number_of_loops;
+   atomic_init(&tier->state, TIER_IDLE);
+
+   return tier;
+}
+
+void
+tier_destroy(struct tier *tier, struct time_report *report)
+{
+   int state = TIER_COMPILING;
+
+   /* a compile the program outran is cut short where it can be */
+   if (atomic_load(&tier->state) != TIER_IDLE) {
+      atomic_compare_exchange_strong(&tier->state, &state, TIER_CANCELLED);
+      pthread_join(tier->thread, NULL);
+   }
+
+   report->loops += tier->number_of_loops;
+   if (atomic_load(&tier->state) == TIER_READY) {
+      report->tiered_runs += tier->switches;
+      report->tier_compile_ms += tier->compile_ms;
+   }
+
+   if (tier->jit != NULL)
+      jit_destroy(tier->jit);
+   free(tier->loops);
+   free(tier);
+}
+
+tier_loop_function *
+tier_loop(struct tier *tier, uint32_t loop)
+{
+   int state = atomic_load(&tier->state);
+
+   if (state == TIER_IDLE) {
+      /*
+       * The thread lowers into, and the JIT compiles in, the vm_state's
+       * context (see jit_add_module()). The interpreter never touches
+       * LLVM, and tier_destroy() joins before the context goes away.
+       */
+      atomic_store(&tier->state, TIER_COMPILING);
+      if (pthread_create(&tier->thread, NULL, tier_compile, tier) != 0) {
+         fprintf(stderr, "tier: unable to start the compile thread\n");
+         exit(EXIT_FAILURE);
+      }
+      return NULL;
+   }
+
+   if (state != TIER_READY)
+      return NULL;
+
+   tier->switches++;
+   return tier->loops[loop];
+}
@@ -0,0 +1,98 @@
+#ifndef TIER_H
+#define TIER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "ast.h"
+
+struct driver;
+struct intern_pool;
+struct jit;
+struct time_report;
+
+/*
+ * Tiered execution, --tiered. A program starts on the bytecode
+ * interpreter right away, which counts the back edges of its while
+ * loops. Once a loop turns out hot, a background thread lowers the
+ * program with LLVM, optimizes it at -O2 and jit-compiles it, while the
+ * interpreter carries on. At its next back edge the loop moves over to
+ * native code: the interpreter hands the loop's variables to the native
+ * function built from it, and resumes after the loop once it returns.
+ *
+ * A loop is built into a function of its own, "loop.<k>", taking the
+ * variables it refers to in a state of slots: the value of a scalar, or
+ * an array as a pointer to its first element and then its length. The
+ * interpreter and codegen number the loops, and list their variables,
+ * the same way, walking the same tree in the same order.
+ */
+#define TIER_HOT_BACK_EDGES   (1 << 16)   /* before a loop asks for -O2 */
+#define TIER_OPT_LEVEL        2
+
+/* only loops this shallow in their function get a function of their own */
+#define TIER_MAX_LOOP_DEPTH   2
+
+#define TIER_IDLE       0
+#define TIER_COMPILING  1
+#define TIER_READY      2
+#define TIER_CANCELLED  3
+
+union tier_slot {
+   int32_t value;       /* the bits of an int or float */
+   void *pointer;
+   int64_t bits;
+};
+
+typedef void tier_loop_function(union tier_slot *state);
+
+/* what a loop refers to, reused from loop to loop */
+struct tier_symbols {
+   int *symbols;
+   uint32_t number_of_symbols;
+   uint32_t capacity;
+
+   /* indexed by symbol: the walk that last listed it */
+   uint32_t *stamps;
+   int number_of_stamps;
+   uint32_t stamp;
+};
+
+void tier_symbols_destroy(struct tier_symbols *symbols);
+
+/*
+ * Lists the symbols 'loop' refers to, in order of first use. Returns 0
+ * if the loop cannot run on its own, as when it returns from within.
+ */
+int tier_loop_symbols(struct tier_symbols *symbols, struct ast *ast,
+                      struct ast_while_statement *loop);
+
+struct tier {
+   struct driver *driver;     /* lowered on the background thread */
+   struct intern_pool *names; /* of the driver's tree, see intern.h */
+   uint32_t number_of_loops;
+
+   pthread_t thread;
+   atomic_int state;          /* TIER_* */
+
+   /* set by the background thread before the state is TIER_READY */
+   tier_loop_function **loops;
+   struct jit *jit;
+   double compile_ms;
+
+   uint32_t switches;         /* runs of loops moved to native code */
+};
+
+/* on the thread that compiled the program */
+struct tier *tier_create(struct driver *driver, uint32_t number_of_loops);
+
+/* waits for the background thread and adds the statistics to 'report' */
+void tier_destroy(struct tier *tier, struct time_report *report);
+
+/*
+ * The native code of hot loop 'loop', or NULL while there is none yet;
+ * the first call starts compiling. For the interpreter's thread only.
+ */
+tier_loop_function *tier_loop(struct tier *tier, uint32_t loop);
+
+#endif /* TIER_H */
@@ -0,0 +1,17 @@
+#include <time.h>
+#include "timer.h"
+
+double
+timer_now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+double
+timer_elapsed_ms(double start)
+{
+   return (timer_now() - start) * 1e3;
+}
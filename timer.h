@@ -0,0 +1,10 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+/* seconds elapsed on a monotonic clock */
+double timer_now(void);
+
+/* milliseconds elapsed since 'start' (as returned by timer_now) */
+double timer_elapsed_ms(double start);
+
+#endif /* TIMER_H */
@@ -0,0 +1,934 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "intern.h"
+#include "report.h"
+#include "typecheck.h"
+
+#define SYMBOL_NONE        0
+#define SYMBOL_SCALAR      1
+#define SYMBOL_ARRAY       2
+#define SYMBOL_FUNCTION    3
+
+/* what a symbol stands for, with the same block scoping as codegen */
+struct symbol_type {
+   int kind;
+   int type;         /* of the variable, its elements or the value returned */
+   int owner;        /* function of a variable, 0 for main's */
+   int parallel;     /* parallel for declaring a variable, 0 for none */
+   uint32_t first_parameter;     /* range of 'parameters', for a function */
+   uint32_t number_of_parameters;
+};
+
+struct typechecker {
+   struct symbol_type *symbols;     /* indexed by symbol */
+   int symbols_capacity;
+
+   /* of every function seen; a kind and type each */
+   struct symbol_type *parameters;
+   uint32_t number_of_parameters;
+   uint32_t parameters_capacity;
+
+   /*
+    * Every declaration is logged, even at the top level, so that an
+    * ill-typed statement can be forgotten as a whole.
+    */
+   struct {
+      int symbol;
+      struct symbol_type shadowed;
+   } *undo_log;
+   int undo_log_size;
+   int undo_log_capacity;
+
+   int function;           /* being checked, numbered from 1; 0 in main */
+   int number_of_functions;
+   int return_type;
+
+   /*
+    * The innermost parallel for being checked, numbered from 1 as well,
+    * and the outer variables the bodies of those being checked refer
+    * to, its own from 'first_capture' on; see check_for_statement().
+    */
+   int parallel;
+   int number_of_parallel_loops;
+   struct {
+      int symbol;
+      int operator;        /* AST_CAPTURE or AST_REDUCE_* */
+      int type;
+   } *captures;
+   int number_of_captures;
+   int captures_capacity;
+   int first_capture;
+   ast_index reduced;      /* the 's' read by 's = s + e' being checked */
+
+   int conversions;
+
+   /* nodes are appended for conversions: refetch pointers after a check */
+   struct ast *ast;
+};
+
+static ast_ref check_statement(struct typechecker *, ast_ref);
+
+static void *
+xrealloc(void *ptr, size_t size)
+{
+   ptr = realloc(ptr, size);
+   if (ptr == NULL) {
+      fprintf(stderr, "Memory reallocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   return ptr;
+}
+
+static void
+declare_symbol(struct typechecker *typechecker, int symbol,
+               struct symbol_type *symbol_type)
+{
+   int capacity;
+
+   if (symbol >= typechecker->symbols_capacity) {
+      capacity = typechecker->symbols_capacity ?
+                 typechecker->symbols_capacity : 256;
+      while (capacity <= symbol)
+         capacity *= 2;
+
+      typechecker->symbols = xrealloc(typechecker->symbols,
+                                      capacity * sizeof(struct symbol_type));
+      memset(typechecker->symbols + typechecker->symbols_capacity, 0,
+             (capacity - typechecker->symbols_capacity) *
+             sizeof(struct symbol_type));
+      typechecker->symbols_capacity = capacity;
+   }
+
+   if (typechecker->undo_log_size == typechecker->undo_log_capacity) {
+      typechecker->undo_log_capacity = typechecker->undo_log_capacity ?
+                                       2 * typechecker->undo_log_capacity :
+                                       64;
+      typechecker->undo_log = xrealloc(typechecker->undo_log,
+                                       typechecker->undo_log_capacity *
+                                       sizeof(*typechecker->undo_log));
+   }
+
+   typechecker->undo_log[typechecker->undo_log_size].symbol = symbol;
+   typechecker->undo_log[typechecker->undo_log_size].shadowed =
+      typechecker->symbols[symbol];
+   typechecker->undo_log_size++;
+
+   typechecker->symbols[symbol] = *symbol_type;
+}
+
+static void
+declare_variable(struct typechecker *typechecker, int symbol, int kind,
+                 int type)
+{
+   struct symbol_type variable = { 0 };
+
+   variable.kind = kind;
+   variable.type = type;
+   variable.owner = typechecker->function;
+   variable.parallel = typechecker->parallel;
+   declare_symbol(typechecker, symbol, &variable);
+}
+
+/* undoes the declarations made since the undo log was 'mark' long */
+static void
+exit_scope(struct typechecker *typechecker, int mark)
+{
+   while (typechecker->undo_log_size > mark) {
+      int i = --typechecker->undo_log_size;
+
+      typechecker->symbols[typechecker->undo_log[i].symbol] =
+         typechecker->undo_log[i].shadowed;
+   }
+}
+
+static struct symbol_type *
+lookup_symbol(struct typechecker *typechecker, int symbol)
+{
+   if (symbol < 0 || symbol >= typechecker->symbols_capacity)
+      return NULL;
+
+   return &typechecker->symbols[symbol];
+}
+
+/*
+ * A variable of the function being checked. Arrays are only ever used
+ * through an index, and scalars never are.
+ */
+static struct symbol_type *
+get_variable(struct typechecker *typechecker, int symbol, int kind)
+{
+   struct symbol_type *variable = lookup_symbol(typechecker, symbol);
+
+   if (variable == NULL || variable->kind == SYMBOL_NONE ||
+       variable->kind == SYMBOL_FUNCTION ||
+       variable->owner != typechecker->function) {
+      fprintf(stderr, "%s: undeclared variable\n", intern_get_name(symbol));
+      return NULL;
+   }
+   if (kind == SYMBOL_ARRAY && variable->kind != SYMBOL_ARRAY) {
+      fprintf(stderr, "%s: indexing something that is not an array\n",
+                      intern_get_name(symbol));
+      return NULL;
+   }
+   if (kind == SYMBOL_SCALAR && variable->kind != SYMBOL_SCALAR) {
+      fprintf(stderr, "%s: array used without an index\n",
+                      intern_get_name(symbol));
+      return NULL;
+   }
+
+   return variable;
+}
+
+/* whether 'variable' is declared outside the parallel for being checked */
+static int
+is_outer(struct typechecker *typechecker, struct symbol_type *variable)
+{
+   return typechecker->parallel != 0 &&
+          variable->parallel != typechecker->parallel;
+}
+
+/*
+ * Notes that the body of the parallel for being checked uses outer
+ * variable 'symbol' as 'operator' has it, see AST_CAPTURE. A variable
+ * the body reduces into it may not otherwise read, nor reduce into by
+ * both operators: no run could then do without the others' values.
+ */
+static int
+capture(struct typechecker *typechecker, int symbol, int operator, int type)
+{
+   const char *name = intern_get_name(symbol);
+   int i;
+
+   for (i = typechecker->first_capture; i < typechecker->number_of_captures;
+        i++) {
+      if (typechecker->captures[i].symbol != symbol)
+         continue;
+      if (typechecker->captures[i].operator == operator)
+         return 1;
+
+      if (typechecker->captures[i].operator == AST_CAPTURE ||
+          operator == AST_CAPTURE)
+         fprintf(stderr, "%s: read in a parallel for that reduces into "
+                         "it\n", name);
+      else
+         fprintf(stderr, "%s: reduced into by both + and * in a parallel "
+                         "for\n", name);
+      return 0;
+   }
+
+   if (typechecker->number_of_captures == typechecker->captures_capacity) {
+      typechecker->captures_capacity = typechecker->captures_capacity ?
+                                       2 * typechecker->captures_capacity :
+                                       16;
+      typechecker->captures = xrealloc(typechecker->captures,
+                                       typechecker->captures_capacity *
+                                       sizeof(*typechecker->captures));
+   }
+
+   typechecker->captures[i].symbol = symbol;
+   typechecker->captures[i].operator = operator;
+   typechecker->captures[i].type = type;
+   typechecker->number_of_captures++;
+
+   return 1;
+}
+
+/*
+ * The reduction an assignment to an outer variable of a parallel for
+ * has to be: 's = s + e' or 's = s * e', as parsed. Returns 0 for
+ * anything else.
+ */
+static int
+reduction_operator(struct typechecker *typechecker,
+                   struct ast_expression *assignment)
+{
+   struct ast_expression *value, *operand;
+
+   value = ast_expression(typechecker->ast, assignment->subexpr[0]);
+   if (value->operator != AST_ADD && value->operator != AST_MUL)
+      return 0;
+
+   operand = ast_expression(typechecker->ast, value->subexpr[0]);
+   if (operand->operator != AST_IDENTIFIER ||
+       operand->primary_expr.symbol != assignment->primary_expr.symbol)
+      return 0;
+
+   return value->operator == AST_ADD ? AST_REDUCE_ADD : AST_REDUCE_MUL;
+}
+
+static int
+type_of(struct typechecker *typechecker, ast_index index)
+{
+   return ast_expression(typechecker->ast, index)->type;
+}
+
+/*
+ * Returns an expression of 'type' for the checked expression 'index':
+ * the expression itself, a conversion of it, or, for a condition, its
+ * comparison with zero.
+ */
+static ast_index
+convert(struct typechecker *typechecker, ast_index index, int type)
+{
+   struct ast *ast = typechecker->ast;
+   int from = type_of(typechecker, index);
+   ast_index zero, result;
+
+   if (from == type)
+      return index;
+
+   if (type == TYPE_BOOL) {
+      if (from == TYPE_INT)
+         zero = create_expression(ast, AST_INT_CONSTANT, AST_NONE, AST_NONE);
+      else
+         zero = create_expression(ast, AST_FLOAT_CONSTANT, AST_NONE,
+                                  AST_NONE);
+      /* the bits of 0 are those of 0.0f as well */
+      ast_expression(ast, zero)->primary_expr.int_constant = 0;
+      ast_expression(ast, zero)->type = from;
+      result = create_expression(ast, AST_NE, index, zero);
+   } else {
+      result = create_expression(ast, AST_CONVERT, index, AST_NONE);
+   }
+
+   ast_expression(ast, result)->type = type;
+   typechecker->conversions++;
+   return result;
+}
+
+/* a comparison is an int, as in C, when it is used as a number */
+static int
+arithmetic_type(int lhs_type, int rhs_type)
+{
+   if (lhs_type == TYPE_FLOAT || rhs_type == TYPE_FLOAT)
+      return TYPE_FLOAT;
+
+   return TYPE_INT;
+}
+
+static ast_index check_expression(struct typechecker *, ast_index);
+
+/* an index or array size, which may not be a float */
+static ast_index
+check_int_expression(struct typechecker *typechecker, ast_index index,
+                     const char *what, int array)
+{
+   index = check_expression(typechecker, index);
+   if (index == AST_NONE)
+      return AST_NONE;
+
+   if (type_of(typechecker, index) == TYPE_FLOAT) {
+      fprintf(stderr, "%s: %s is not an int\n", intern_get_name(array),
+                      what);
+      return AST_NONE;
+   }
+
+   return convert(typechecker, index, TYPE_INT);
+}
+
+/* whether an argument before 'argument' passes 'symbol' as an array */
+static int
+passes_array(struct typechecker *typechecker, ast_index first_argument,
+             ast_index argument, struct symbol_type *parameters, int symbol)
+{
+   struct ast_expression *node, *value;
+   uint32_t i = 0;
+
+   for (; first_argument != argument; first_argument = node->subexpr[1]) {
+      node = ast_expression(typechecker->ast, first_argument);
+      value = ast_expression(typechecker->ast, node->subexpr[0]);
+      if (parameters[i++].kind == SYMBOL_ARRAY &&
+          value->primary_expr.symbol == symbol)
+         return 1;
+   }
+
+   return 0;
+}
+
+/*
+ * Each argument is converted to the type of its parameter. An array
+ * argument must name an array of the same element type, and the callee
+ * takes it as noalias, so no array may be passed twice.
+ */
+static int
+check_call(struct typechecker *typechecker, struct ast_expression *call)
+{
+   struct ast *ast = typechecker->ast;
+   struct symbol_type *function, *parameter, *array;
+   struct ast_expression *node, *value;
+   const char *name = intern_get_name(call->primary_expr.symbol);
+   ast_index first_argument = call->subexpr[0], next, checked;
+   uint32_t i;
+
+   function = lookup_symbol(typechecker, call->primary_expr.symbol);
+   if (function == NULL || function->kind != SYMBOL_FUNCTION) {
+      fprintf(stderr, "%s: undefined function\n", name);
+      return 0;
+   }
+
+   next = first_argument;
+   for (i = 0; i < function->number_of_parameters && next != AST_NONE; i++) {
+      parameter = &typechecker->parameters[function->first_parameter + i];
+      node = ast_expression(ast, next);
+      value = ast_expression(ast, node->subexpr[0]);
+
+      if (parameter->kind == SYMBOL_ARRAY) {
+         /* only an identifier has a symbol to look up */
+         array = NULL;
+         if (value->operator == AST_IDENTIFIER)
+            array = lookup_symbol(typechecker, value->primary_expr.symbol);
+         if (array == NULL || array->kind != SYMBOL_ARRAY ||
+             array->owner != typechecker->function) {
+            fprintf(stderr, "%s: array argument that is not an array\n",
+                            name);
+            return 0;
+         }
+         if (array->type != parameter->type) {
+            fprintf(stderr, "%s: array argument of the wrong type\n", name);
+            return 0;
+         }
+         if (passes_array(typechecker, first_argument, next,
+                          &typechecker->parameters[function->first_parameter],
+                          value->primary_expr.symbol)) {
+            fprintf(stderr, "%s: %s passed twice\n", name,
+                            intern_get_name(value->primary_expr.symbol));
+            return 0;
+         }
+         if (is_outer(typechecker, array) &&
+             !capture(typechecker, value->primary_expr.symbol, AST_CAPTURE,
+                      array->type))
+            return 0;
+         value->type = array->type;
+         node->type = array->type;
+         next = node->subexpr[1];
+         continue;
+      }
+
+      checked = check_expression(typechecker, node->subexpr[0]);
+      if (checked == AST_NONE)
+         return 0;
+      checked = convert(typechecker, checked, parameter->type);
+
+      node = ast_expression(ast, next);
+      node->subexpr[0] = checked;
+      node->type = parameter->type;
+      next = node->subexpr[1];
+   }
+
+   if (next != AST_NONE || i != function->number_of_parameters) {
+      fprintf(stderr, "%s: wrong number of arguments\n", name);
+      return 0;
+   }
+
+   return 1;
+}
+
+/* returns the checked expression, or AST_NONE if it is ill-typed */
+static ast_index
+check_expression(struct typechecker *typechecker, ast_index index)
+{
+   struct ast *ast = typechecker->ast;
+   struct ast_expression *expression = ast_expression(ast, index);
+   int symbol = expression->primary_expr.symbol, type, reduction;
+   struct symbol_type *variable;
+   ast_index lhs, rhs;
+
+   switch (expression->operator) {
+      case AST_INT_CONSTANT:
+         type = TYPE_INT;
+         break;
+      case AST_FLOAT_CONSTANT:
+         type = TYPE_FLOAT;
+         break;
+
+      case AST_IDENTIFIER:
+         variable = get_variable(typechecker, symbol, SYMBOL_SCALAR);
+         if (variable == NULL)
+            return AST_NONE;
+         type = variable->type;
+
+         if (is_outer(typechecker, variable) &&
+             index != typechecker->reduced &&
+             !capture(typechecker, symbol, AST_CAPTURE, type))
+            return AST_NONE;
+         break;
+
+      /* an element has the declared type of its array */
+      case AST_INDEX:
+         variable = get_variable(typechecker, symbol, SYMBOL_ARRAY);
+         if (variable == NULL)
+            return AST_NONE;
+         type = variable->type;
+
+         /* an array is shared by every run of a parallel for */
+         if (is_outer(typechecker, variable) &&
+             !capture(typechecker, symbol, AST_CAPTURE, type))
+            return AST_NONE;
+
+         lhs = check_int_expression(typechecker, expression->subexpr[0],
+                                    "index", symbol);
+         if (lhs == AST_NONE)
+            return AST_NONE;
+         ast_expression(ast, index)->subexpr[0] = lhs;
+         break;
+
+      /* the value of an assignment is the value assigned */
+      case AST_ASSIGN:
+         variable = get_variable(typechecker, symbol, SYMBOL_SCALAR);
+         if (variable == NULL)
+            return AST_NONE;
+         type = variable->type;
+
+         if (!is_outer(typechecker, variable)) {
+            lhs = check_expression(typechecker, expression->subexpr[0]);
+            if (lhs == AST_NONE)
+               return AST_NONE;
+            ast_expression(ast, index)->subexpr[0] =
+               convert(typechecker, lhs, type);
+            break;
+         }
+
+         /* a reduction is done in the type of its variable, unconverted */
+         reduction = reduction_operator(typechecker, expression);
+         if (reduction == 0) {
+            fprintf(stderr, "%s: assigned in a parallel for other than as "
+                            "%s = %s + e or %s * e\n",
+                            intern_get_name(symbol), intern_get_name(symbol),
+                            intern_get_name(symbol), intern_get_name(symbol));
+            return AST_NONE;
+         }
+
+         typechecker->reduced =
+            ast_expression(ast, expression->subexpr[0])->subexpr[0];
+         lhs = check_expression(typechecker, expression->subexpr[0]);
+         typechecker->reduced = AST_NONE;
+         if (lhs == AST_NONE)
+            return AST_NONE;
+         if (type_of(typechecker, lhs) != type) {
+            fprintf(stderr, "%s: reduced into with a float in a parallel "
+                            "for\n", intern_get_name(symbol));
+            return AST_NONE;
+         }
+         if (!capture(typechecker, symbol, reduction, type))
+            return AST_NONE;
+         break;
+
+      /* the index goes first, like the address in C */
+      case AST_ASSIGN_INDEX:
+         variable = get_variable(typechecker, symbol, SYMBOL_ARRAY);
+         if (variable == NULL)
+            return AST_NONE;
+         type = variable->type;
+
+         if (is_outer(typechecker, variable) &&
+             !capture(typechecker, symbol, AST_CAPTURE, type))
+            return AST_NONE;
+
+         rhs = check_int_expression(typechecker, expression->subexpr[1],
+                                    "index", symbol);
+         if (rhs == AST_NONE)
+            return AST_NONE;
+         lhs = check_expression(typechecker,
+                                ast_expression(ast, index)->subexpr[0]);
+         if (lhs == AST_NONE)
+            return AST_NONE;
+
+         lhs = convert(typechecker, lhs, type);
+
+         expression = ast_expression(ast, index);
+         expression->subexpr[0] = lhs;
+         expression->subexpr[1] = rhs;
+         break;
+
+      case AST_CALL:
+         if (!check_call(typechecker, expression))
+            return AST_NONE;
+         type = lookup_symbol(typechecker, symbol)->type;
+         break;
+
+      /* both operands are brought to the type of the operation */
+      case AST_ADD: case AST_SUB:
+      case AST_MUL: case AST_DIV:
+      case AST_GT: case AST_LT:
+      case AST_EQ: case AST_NE:
+      case AST_LE: case AST_GE:
+         lhs = check_expression(typechecker, expression->subexpr[0]);
+         if (lhs == AST_NONE)
+            return AST_NONE;
+         rhs = check_expression(typechecker,
+                                ast_expression(ast, index)->subexpr[1]);
+         if (rhs == AST_NONE)
+            return AST_NONE;
+
+         type = arithmetic_type(type_of(typechecker, lhs),
+                                type_of(typechecker, rhs));
+         lhs = convert(typechecker, lhs, type);
+         rhs = convert(typechecker, rhs, type);
+
+         expression = ast_expression(ast, index);
+         expression->subexpr[0] = lhs;
+         expression->subexpr[1] = rhs;
+         if (expression->operator >= AST_GT)
+            type = TYPE_BOOL;
+         break;
+
+      default:
+         fprintf(stderr,
+                 "Request to check unknown expression operator: %d\n",
+                 expression->operator);
+         exit(EXIT_FAILURE);
+   }
+
+   ast_expression(ast, index)->type = type;
+   return index;
+}
+
+static ast_index
+check_condition(struct typechecker *typechecker, ast_index index)
+{
+   index = check_expression(typechecker, index);
+   if (index == AST_NONE)
+      return AST_NONE;
+
+   return convert(typechecker, index, TYPE_BOOL);
+}
+
+static int
+check_compound_statement(struct typechecker *typechecker, ast_index index)
+{
+   struct ast *ast = typechecker->ast;
+   struct ast_statement_list *statement_list;
+   int mark = typechecker->undo_log_size;
+   ast_ref statement;
+   uint32_t i;
+
+   statement_list = &ast->compound_statements[index].statement_list;
+   for (i = 0; i < statement_list->number_of_statements; i++) {
+      statement = check_statement(typechecker,
+                                  ast->statements[statement_list->first + i]);
+      if (statement == AST_NONE)
+         return 0;
+      ast->statements[statement_list->first + i] = statement;
+   }
+
+   exit_scope(typechecker, mark);
+   return 1;
+}
+
+/*
+ * Lists what the body of parallel for 'index' refers to from outside,
+ * for codegen, and passes it on to the enclosing parallel for, if any,
+ * whose body uses it as well where it too is outer.
+ */
+static int
+list_captures(struct typechecker *typechecker, ast_index index,
+              int first_capture)
+{
+   struct ast *ast = typechecker->ast;
+   struct ast_expression *node;
+   ast_index captures = AST_NONE, next;
+   int i;
+
+   for (i = typechecker->number_of_captures - 1; i >= first_capture; i--) {
+      next = create_expression(ast, typechecker->captures[i].operator,
+                               captures, AST_NONE);
+      node = ast_expression(ast, next);
+      node->type = typechecker->captures[i].type;
+      node->primary_expr.symbol = typechecker->captures[i].symbol;
+      captures = next;
+   }
+   typechecker->number_of_captures = first_capture;
+   ast->for_statements[index].captures = captures;
+
+   for (; captures != AST_NONE; captures = node->subexpr[0]) {
+      node = ast_expression(ast, captures);
+      if (is_outer(typechecker,
+                   lookup_symbol(typechecker, node->primary_expr.symbol)) &&
+          !capture(typechecker, node->primary_expr.symbol, node->operator,
+                   node->type))
+         return 0;
+   }
+
+   return 1;
+}
+
+/*
+ * The bounds are checked before the index is in scope, which is the
+ * body's. The body of a parallel for gets a number of its own, and
+ * with it the outer variables it refers to, which are those declared
+ * under another number.
+ */
+static int
+check_for_statement(struct typechecker *typechecker, ast_index index)
+{
+   struct ast *ast = typechecker->ast;
+   struct ast_for_statement *for_statement = &ast->for_statements[index];
+   int symbol = ast->declarations[for_statement->index].symbol;
+   int parallel = typechecker->parallel, first_capture, own_captures;
+   int mark, checked;
+   ast_index lower, upper;
+
+   lower = check_int_expression(typechecker, for_statement->lower,
+                                "lower bound", symbol);
+   if (lower == AST_NONE)
+      return 0;
+   upper = check_int_expression(typechecker,
+                                ast->for_statements[index].upper,
+                                "upper bound", symbol);
+   if (upper == AST_NONE)
+      return 0;
+
+   for_statement = &ast->for_statements[index];
+   for_statement->lower = lower;
+   for_statement->upper = upper;
+
+   first_capture = typechecker->first_capture;
+   if (for_statement->parallel) {
+      typechecker->parallel = ++typechecker->number_of_parallel_loops;
+      typechecker->first_capture = typechecker->number_of_captures;
+   }
+
+   mark = typechecker->undo_log_size;
+   declare_variable(typechecker, symbol, SYMBOL_SCALAR, TYPE_INT);
+   checked = check_compound_statement(typechecker, for_statement->body);
+   exit_scope(typechecker, mark);
+
+   if (!ast->for_statements[index].parallel)
+      return checked;
+
+   own_captures = typechecker->first_capture;
+   typechecker->parallel = parallel;
+   typechecker->first_capture = first_capture;
+   return checked && list_captures(typechecker, index, own_captures);
+}
+
+/*
+ * The function is declared before its body, which may call it. Its
+ * parameters are kept apart from the tree, which may be released long
+ * before the last call is checked.
+ */
+static int
+check_function_definition(struct typechecker *typechecker,
+                          struct ast_function_definition *definition)
+{
+   struct ast_declaration *parameters;
+   struct symbol_type function = { 0 }, *parameter;
+   int mark, checked;
+   uint32_t i, n;
+
+   n = definition->number_of_parameters;
+   if (typechecker->number_of_parameters + n >
+       typechecker->parameters_capacity) {
+      typechecker->parameters_capacity = typechecker->parameters_capacity ?
+                                         typechecker->parameters_capacity :
+                                         64;
+      while (typechecker->parameters_capacity <
+             typechecker->number_of_parameters + n)
+         typechecker->parameters_capacity *= 2;
+      typechecker->parameters = xrealloc(typechecker->parameters,
+                                         typechecker->parameters_capacity *
+                                         sizeof(struct symbol_type));
+   }
+
+   parameters = &typechecker->ast->declarations[definition->first_parameter];
+   function.kind = SYMBOL_FUNCTION;
+   function.type = definition->type_specifier;
+   function.first_parameter = typechecker->number_of_parameters;
+   function.number_of_parameters = n;
+   for (i = 0; i < n; i++) {
+      parameter = &typechecker->parameters[function.first_parameter + i];
+      memset(parameter, 0, sizeof(struct symbol_type));
+      parameter->kind = parameters[i].size == AST_UNSIZED ? SYMBOL_ARRAY
+                                                          : SYMBOL_SCALAR;
+      parameter->type = parameters[i].type_specifier;
+   }
+   typechecker->number_of_parameters += n;
+   declare_symbol(typechecker, definition->symbol, &function);
+
+   mark = typechecker->undo_log_size;
+   typechecker->function = ++typechecker->number_of_functions;
+   typechecker->return_type = definition->type_specifier;
+   for (i = 0; i < n; i++)
+      declare_variable(typechecker, parameters[i].symbol,
+                       parameters[i].size == AST_UNSIZED ? SYMBOL_ARRAY
+                                                         : SYMBOL_SCALAR,
+                       parameters[i].type_specifier);
+   checked = check_compound_statement(typechecker, definition->body);
+   typechecker->function = 0;
+
+   exit_scope(typechecker, mark);
+   return checked;
+}
+
+/* returns the checked statement, or AST_NONE if it is ill-typed */
+static ast_ref
+check_statement(struct typechecker *typechecker, ast_ref statement)
+{
+   struct ast *ast = typechecker->ast;
+   ast_index index = AST_REF_INDEX(statement), size;
+   struct ast_declaration *declaration;
+   struct ast_selection_statement *selection_statement;
+   struct ast_while_statement *while_statement;
+   ast_index condition;
+
+   switch (AST_REF_TAG(statement)) {
+      case AST_DECLARATION:
+         declaration = &ast->declarations[index];
+         size = declaration->size;
+         /* the size is evaluated before the array is in scope */
+         if (size != AST_NONE) {
+            size = check_int_expression(typechecker, size, "array size",
+                                        declaration->symbol);
+            if (size == AST_NONE)
+               return AST_NONE;
+            declaration = &ast->declarations[index];
+            declaration->size = size;
+         }
+         declare_variable(typechecker, declaration->symbol,
+                          size != AST_NONE ? SYMBOL_ARRAY : SYMBOL_SCALAR,
+                          declaration->type_specifier);
+         return statement;
+
+      case AST_EXPRESSION:
+         index = check_expression(typechecker, index);
+         if (index == AST_NONE)
+            return AST_NONE;
+         return AST_REF(AST_EXPRESSION, index);
+
+      case AST_COMPOUND_STATEMENT:
+         return check_compound_statement(typechecker, index) ? statement
+                                                             : AST_NONE;
+
+      case AST_SELECTION_STATEMENT:
+         condition = check_condition(typechecker,
+                                     ast->selection_statements[index].
+                                     condition);
+         if (condition == AST_NONE)
+            return AST_NONE;
+
+         selection_statement = &ast->selection_statements[index];
+         selection_statement->condition = condition;
+         if (!check_compound_statement(typechecker,
+                                       selection_statement->then_body) ||
+             (selection_statement->else_body != AST_NONE &&
+              !check_compound_statement(typechecker,
+                                        selection_statement->else_body)))
+            return AST_NONE;
+         return statement;
+
+      case AST_WHILE_STATEMENT:
+         condition = check_condition(typechecker,
+                                     ast->while_statements[index].condition);
+         if (condition == AST_NONE)
+            return AST_NONE;
+
+         while_statement = &ast->while_statements[index];
+         while_statement->condition = condition;
+         if (!check_compound_statement(typechecker, while_statement->body))
+            return AST_NONE;
+         return statement;
+
+      case AST_FOR_STATEMENT:
+         return check_for_statement(typechecker, index) ? statement
+                                                        : AST_NONE;
+
+      case AST_FUNCTION_DEFINITION:
+         return check_function_definition(typechecker,
+                                          &ast->function_definitions[index])
+                ? statement : AST_NONE;
+
+      /* the value is converted to the type the function returns */
+      case AST_RETURN_STATEMENT:
+         if (typechecker->function == 0) {
+            fprintf(stderr, "return outside of a function\n");
+            return AST_NONE;
+         }
+         /* every run of the body would have to agree on the value */
+         if (typechecker->parallel != 0) {
+            fprintf(stderr, "return in a parallel for\n");
+            return AST_NONE;
+         }
+         index = check_expression(typechecker, index);
+         if (index == AST_NONE)
+            return AST_NONE;
+         return AST_REF(AST_RETURN_STATEMENT,
+                        convert(typechecker, index,
+                                typechecker->return_type));
+
+      default:
+         return statement;
+   }
+}
+
+struct typechecker *
+typechecker_create(struct ast *ast)
+{
+   struct typechecker *typechecker;
+
+   typechecker = calloc(1, sizeof(struct typechecker));
+   if (typechecker == NULL) {
+      fprintf(stderr, "Memory allocation request failed.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   typechecker->ast = ast;
+   typechecker->reduced = AST_NONE;
+   return typechecker;
+}
+
+void
+typechecker_destroy(struct typechecker *typechecker,
+                    struct time_report *report)
+{
+   report->conversions += typechecker->conversions;
+
+   free(typechecker->symbols);
+   free(typechecker->parameters);
+   free(typechecker->undo_log);
+   free(typechecker->captures);
+   free(typechecker);
+}
+
+ast_ref
+typecheck_top_level_statement(struct typechecker *typechecker,
+                              ast_ref statement)
+{
+   statement = check_statement(typechecker, statement);
+
+   /* what is left in the log is the top level's, and here to stay */
+   if (statement == AST_NONE)
+      exit_scope(typechecker, 0);
+   typechecker->undo_log_size = 0;
+   typechecker->function = 0;
+   typechecker->parallel = 0;
+   typechecker->number_of_captures = 0;
+   typechecker->first_capture = 0;
+
+   return statement;
+}
+
+int
+typecheck_translation_unit(struct typechecker *typechecker)
+{
+   struct ast *ast = typechecker->ast;
+   struct ast_statement_list *statement_list;
+   ast_ref statement;
+   uint32_t i;
+
+   statement_list = &ast->translation_unit.statement_list;
+   for (i = 0; i < statement_list->number_of_statements; i++) {
+      statement = typecheck_top_level_statement(typechecker,
+                                                ast->statements[
+                                                   statement_list->first + i]);
+      if (statement == AST_NONE)
+         return 0;
+      ast->statements[statement_list->first + i] = statement;
+   }
+
+   return 1;
+}
@@ -0,0 +1,38 @@
+#ifndef TYPECHECK_H
+#define TYPECHECK_H
+
+#include "ast.h"
+
+/*
+ * Semantic analysis, run on the tree before the simplifier and codegen.
+ * Every name is resolved against its declaration, every expression gets
+ * its type, and every mixing of int and float becomes an AST_CONVERT
+ * node, as C converts: the int operand of a float operation, the value
+ * assigned, passed or returned. A condition that is not a comparison is
+ * compared with zero. Lowering then never has to look at the type of an
+ * operand, and an ill-typed program is rejected before any IR is built.
+ *
+ * Like the simplifier, the type checker remembers the declarations it
+ * has seen, so a program can be checked either as a whole or one
+ * top-level statement at a time.
+ */
+struct time_report;
+struct typechecker;
+
+struct typechecker *typechecker_create(struct ast *ast);
+
+/* adds the statistics to 'report' and frees the type checker */
+void typechecker_destroy(struct typechecker *typechecker,
+                         struct time_report *report);
+
+/*
+ * Returns the checked statement, or AST_NONE if it is ill-typed, after
+ * reporting why; the declarations it made are then forgotten.
+ */
+ast_ref typecheck_top_level_statement(struct typechecker *typechecker,
+                                      ast_ref statement);
+
+/* returns 0 if the program is ill-typed, after reporting why */
+int typecheck_translation_unit(struct typechecker *typechecker);
+
+#endif /* TYPECHECK_H */
@@ -1,5 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include "hash_map.h"
+#include "ssa.h"
 #include "symtab.h"
 #include "vm_state.h"
 
@@ -7,10 +9,7 @@ struct vm_state *
 vm_state_create(const char *module_name)
 {
    struct vm_state *vm;
-
    LLVMTypeRef function_type;
-   LLVMValueRef function_value;
-   LLVMBasicBlockRef entry_block;
 
    vm = calloc(1, sizeof(struct vm_state));
    if (vm == NULL) {
@@ -18,27 +17,52 @@ vm_state_create(const char *module_name)
       exit(EXIT_FAILURE);
    }
 
-   vm->module = LLVMModuleCreateWithName(module_name);
-   vm->builder = LLVMCreateBuilder();
+   vm->context = LLVMContextCreate();
+   vm->builder = LLVMCreateBuilderInContext(vm->context);
+   vm->alloca_builder = LLVMCreateBuilderInContext(vm->context);
 
-   function_type = LLVMFunctionType(LLVMVoidType(), NULL, 0, 0);
-   function_value = LLVMAddFunction(vm->module, "main", function_type);
+   vm->int_type = LLVMInt32TypeInContext(vm->context);
+   vm->float_type = LLVMFloatTypeInContext(vm->context);
+   vm->bool_type = LLVMInt1TypeInContext(vm->context);
 
-   entry_block = LLVMAppendBasicBlock(function_value, "entry");
-   LLVMPositionBuilderAtEnd(vm->builder, entry_block);
+   arena_init(&vm->values_arena, 64 * 1024);
+   vm->constants = hash_map_create();
+
+   function_type = LLVMFunctionType(LLVMVoidTypeInContext(vm->context),
+                                    NULL, 0, 0);
+   vm_state_begin_module(vm, module_name, "main", function_type);
 
    vm->symtab = symbol_table_create();
    return vm;
 }
 
+LLVMValueRef
+vm_state_begin_module(struct vm_state *vm, const char *module_name,
+                      const char *function_name, LLVMTypeRef function_type)
+{
+   LLVMValueRef function_value;
+
+   vm->module = LLVMModuleCreateWithNameInContext(module_name, vm->context);
+   function_value = LLVMAddFunction(vm->module, function_name,
+                                    function_type);
+
+   vm->entry_block = LLVMAppendBasicBlockInContext(vm->context,
+                                                   function_value, "entry");
+   vm->last_alloca = NULL;
+   vm->trap_block = NULL;
+   LLVMPositionBuilderAtEnd(vm->builder, vm->entry_block);
+
+   return function_value;
+}
+
 void
-vm_state_destroy(struct vm_state *vm)
+vm_state_finalize(struct vm_state *vm)
 {
    LLVMBasicBlockRef current_block, return_block;
-   char *error;
 
    current_block = LLVMGetInsertBlock(vm->builder);
-   return_block = LLVMInsertBasicBlock(current_block, "ret");
+   return_block = LLVMInsertBasicBlockInContext(vm->context, current_block,
+                                                "ret");
 
    LLVMPositionBuilderAtEnd(vm->builder, current_block);
    LLVMBuildBr(vm->builder, return_block);
@@ -48,15 +72,34 @@ vm_state_destroy(struct vm_state *vm)
 
    LLVMMoveBasicBlockAfter(return_block, current_block);
 
-   LLVMDumpModule(vm->module);
+   if (vm->ssa != NULL)
+      ssa_builder_finalize(vm->ssa);
+}
+
+void
+vm_state_verify(struct vm_state *vm)
+{
+   char *error;
 
    error = NULL;
    LLVMVerifyModule(vm->module, LLVMAbortProcessAction, &error);
    LLVMDisposeMessage(error);
+}
 
+void
+vm_state_destroy(struct vm_state *vm)
+{
    LLVMDisposeBuilder(vm->builder);
-   LLVMDisposeModule(vm->module);
+   LLVMDisposeBuilder(vm->alloca_builder);
+   if (vm->ssa != NULL)
+      ssa_builder_destroy(vm->ssa);
+   if (vm->module != NULL)
+      LLVMDisposeModule(vm->module);
    symbol_table_destroy(vm->symtab);
+   arena_destroy(&vm->values_arena);
+   hash_map_destroy(vm->constants);
+   LLVMContextDispose(vm->context);
+   free(vm);
 }
 
 void
@@ -66,7 +109,19 @@ vm_state_put_value(struct vm_state *vm, struct vm_value *vmval)
 }
 
 struct vm_value *
-vm_state_get_value(struct vm_state *vm, const char *identifier)
+vm_state_get_value(struct vm_state *vm, int symbol)
+{
+   return symbol_table_get_value(vm->symtab, symbol);
+}
+
+void
+vm_state_enter_scope(struct vm_state *vm)
+{
+   symbol_table_enter_scope(vm->symtab);
+}
+
+void
+vm_state_exit_scope(struct vm_state *vm)
 {
-   return symbol_table_get_value(vm->symtab, identifier);
+   symbol_table_exit_scope(vm->symtab);
 }
@@ -4,22 +4,98 @@
 #include <llvm-c/Core.h>
 #include <llvm-c/Analysis.h>
 
+#include "arena.h"
+
+struct ast;
 struct vm_value;
 struct symbol_table;
+struct ssa_builder;
+struct hash_map;
+struct profile;
+struct tier_symbols;
 
 struct vm_state {
+   /* owned, so that several modules can be built on different threads */
+   LLVMContextRef context;
    LLVMModuleRef module;
    LLVMBuilderRef builder;
    struct symbol_table *symtab;
+
+   /* tree being lowered */
+   struct ast *ast;
+
+   LLVMTypeRef int_type;
+   LLVMTypeRef float_type;
+   LLVMTypeRef bool_type;
+
+   /* declared variables; temporaries are never heap allocated */
+   struct arena values_arena;
+   uint64_t number_of_values;
+
+   /* uniqued int/float constants, see vm_value_from_*_constant() */
+   struct hash_map *constants;
+
+   /*
+    * Function being lowered, NULL while in main. A function only sees
+    * its own variables, and other functions.
+    */
+   struct vm_value *function;
+
+   /* allocas are all placed at the top of the function's entry block */
+   LLVMBasicBlockRef entry_block;
+   LLVMBuilderRef alloca_builder;
+   LLVMValueRef last_alloca;
+
+   /* when set, variables are SSA values instead of allocas */
+   struct ssa_builder *ssa;
+
+   /* array indexes are checked unless -fno-bounds-check */
+   int bounds_checks;
+   /* where failed checks branch to, built once per function */
+   LLVMBasicBlockRef trap_block;
+
+   /* NULL unless instrumenting or optimizing with a profile */
+   struct profile *profile;
+   /* the counters of --profile-generate, sized by driver_finish() */
+   LLVMValueRef profile_counters;
+
+   /*
+    * Set by driver_lower_loops(): a loop the interpreter may move to
+    * native code is also built into a function of its own, see tier.h.
+    */
+   int tiering;
+   uint32_t number_of_loops;
+   uint32_t loop_depth;             /* in the function being lowered */
+   struct tier_symbols *loop_symbols;
 };
 
 struct vm_state *vm_state_create(const char *module_name);
 void vm_state_destroy(struct vm_state *vm);
 
+/*
+ * Starts a new module holding just an empty 'function_name', with the
+ * builder at its entry. The context, types, constants and symbol table
+ * carry over, which is what lets the REPL lower each input on its own.
+ * The previous module must have been handed off or disposed.
+ */
+LLVMValueRef vm_state_begin_module(struct vm_state *vm,
+                                   const char *module_name,
+                                   const char *function_name,
+                                   LLVMTypeRef function_type);
+
+/* terminates main */
+void vm_state_finalize(struct vm_state *vm);
+
+/* aborts if the module is broken */
+void vm_state_verify(struct vm_state *vm);
+
 void
 vm_state_put_value(struct vm_state *vm, struct vm_value *vmval);
 
 struct vm_value *
-vm_state_get_value(struct vm_state *vm, const char *identifier);
+vm_state_get_value(struct vm_state *vm, int symbol);
+
+void vm_state_enter_scope(struct vm_state *vm);
+void vm_state_exit_scope(struct vm_state *vm);
 
-#endif /* VM_VALUE_H */
+#endif /* VM_STATE_H */
@@ -1,20 +1,24 @@
 #include <assert.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "arena.h"
 #include "ast.h"
+#include "hash_map.h"
+#include "intern.h"
 #include "vm_state.h"
 #include "vm_value.h"
 
-static LLVMTypeRef
-get_llvm_type(int type_specifier)
+LLVMTypeRef
+vm_value_llvm_type(struct vm_state *vm, int type_specifier)
 {
    switch (type_specifier) {
       case TYPE_INT:
-         return LLVMInt32Type();
+         return vm->int_type;
       case TYPE_FLOAT:
-         return LLVMFloatType();
+         return vm->float_type;
       default:
          fprintf(stderr, "Unknown type specifier: %d\n", type_specifier);
          exit(EXIT_FAILURE);
@@ -24,67 +28,89 @@ get_llvm_type(int type_specifier)
 }
 
 struct vm_value *
-vm_value_new(int type_specifier, const char *identifier)
+vm_value_new_variable(struct vm_state *vm, int type_specifier, int symbol)
 {
    struct vm_value *vmval;
 
-   vmval = calloc(1, sizeof(struct vm_value));
-   if (!vmval) {
-      fprintf(stderr, "Memory allocation request failed.\n");
-      exit(EXIT_FAILURE);
-   }
-
+   vmval = arena_alloc(&vm->values_arena, sizeof(struct vm_value));
+   vm->number_of_values++;
    vmval->type_specifier = type_specifier;
-   vmval->identifier = identifier;
-   vmval->llvm_type = get_llvm_type(type_specifier);
+   vmval->identifier = intern_get_name(symbol);
+   vmval->symbol = symbol;
+   vmval->llvm_type = vm_value_llvm_type(vm, type_specifier);
+   vmval->owner = vm->function;
 
    return vmval;
 }
 
-struct vm_value *
-vm_value_new_from_int_constant(int int_constant)
+/* constants are uniqued per compile, keyed by type and bit pattern */
+static uint64_t
+constant_key(int type_specifier, uint32_t bits)
 {
-   struct vm_value *vmval;
+   return ((uint64_t) type_specifier << 32) | bits;
+}
 
-   vmval = calloc(1, sizeof(struct vm_value));
-   if (!vmval) {
-      fprintf(stderr, "Memory allocation request failed.\n");
-      exit(EXIT_FAILURE);
+struct vm_value
+vm_value_from_int_constant(struct vm_state *vm, int int_constant)
+{
+   struct vm_value vmval = { 0 };
+   uint64_t key;
+
+   vmval.type_specifier = TYPE_INT;
+   vmval.symbol = -1;
+   vmval.llvm_type = vm->int_type;
+
+   key = constant_key(TYPE_INT, (uint32_t) int_constant);
+   vmval.llvm_value = hash_map_get(vm->constants, key);
+   if (vmval.llvm_value == NULL) {
+      vmval.llvm_value = LLVMConstInt(vmval.llvm_type, int_constant, 0);
+      hash_map_put(vm->constants, key, vmval.llvm_value);
    }
 
-   vmval->type_specifier = TYPE_INT;
-   vmval->llvm_type = get_llvm_type(TYPE_INT);
-   vmval->llvm_value = LLVMConstInt(vmval->llvm_type, int_constant, 0);
-
    return vmval;
 }
 
-struct vm_value *
-vm_value_new_from_float_constant(float float_constant)
+struct vm_value
+vm_value_from_float_constant(struct vm_state *vm, float float_constant)
 {
-   struct vm_value *vmval;
-
-   vmval = calloc(1, sizeof(struct vm_value));
-   if (!vmval) {
-      fprintf(stderr, "Memory allocation request failed.\n");
-      exit(EXIT_FAILURE);
+   struct vm_value vmval = { 0 };
+   uint32_t bits;
+   uint64_t key;
+
+   vmval.type_specifier = TYPE_FLOAT;
+   vmval.symbol = -1;
+   vmval.llvm_type = vm->float_type;
+
+   memcpy(&bits, &float_constant, sizeof(bits));
+   key = constant_key(TYPE_FLOAT, bits);
+   vmval.llvm_value = hash_map_get(vm->constants, key);
+   if (vmval.llvm_value == NULL) {
+      vmval.llvm_value = LLVMConstReal(vmval.llvm_type, float_constant);
+      hash_map_put(vm->constants, key, vmval.llvm_value);
    }
 
-   vmval->type_specifier = TYPE_FLOAT;
-   vmval->llvm_type = get_llvm_type(TYPE_FLOAT);
-   vmval->llvm_value = LLVMConstReal(vmval->llvm_type, float_constant);
-
    return vmval;
 }
 
-struct vm_value *
-vm_value_dup(struct vm_value *vmval)
+/*
+ * Keep every alloca in the entry block, in declaration order, so it runs
+ * once per call rather than once per loop iteration and mem2reg can
+ * promote it.
+ */
+static void
+position_alloca_builder(struct vm_state *vm)
 {
-   struct vm_value *ret;
+   LLVMValueRef next;
+
+   if (vm->last_alloca != NULL)
+      next = LLVMGetNextInstruction(vm->last_alloca);
+   else
+      next = LLVMGetFirstInstruction(vm->entry_block);
 
-   ret = vm_value_new(vmval->type_specifier, vmval->identifier);
-   ret = memcpy(ret, vmval, sizeof(struct vm_value));
-   return ret;
+   if (next != NULL)
+      LLVMPositionBuilderBefore(vm->alloca_builder, next);
+   else
+      LLVMPositionBuilderAtEnd(vm->alloca_builder, vm->entry_block);
 }
 
 LLVMValueRef
@@ -95,109 +121,131 @@ vm_value_alloca(struct vm_state *vm, struct vm_value *vmval)
    if (identifier == NULL)
       identifier = "";
 
-   vmval->llvm_value = LLVMBuildAlloca(vm->builder, vmval->llvm_type,
-                                                    identifier);
+   position_alloca_builder(vm);
+   vmval->llvm_value = LLVMBuildAlloca(vm->alloca_builder, vmval->llvm_type,
+                                                           identifier);
+   vm->last_alloca = vmval->llvm_value;
+
    return vmval->llvm_value;
 }
 
-struct vm_value *
-vm_value_build_math_op(struct vm_state *vm, int operation,
-                                            struct vm_value *lhs,
-                                            struct vm_value *rhs)
+LLVMValueRef
+vm_value_alloca_array(struct vm_state *vm, struct vm_value *vmval,
+                      LLVMValueRef length)
 {
-   struct vm_value *res;
-   LLVMOpcode opcode;
-
-   res = vm_value_new(lhs->type_specifier, "");
-
-   switch (operation) {
-      case AST_ADD:
-         opcode = (res->type_specifier == TYPE_INT) ? LLVMAdd : LLVMFAdd;
-         break;
-      case AST_SUB:
-         opcode = (res->type_specifier == TYPE_INT) ? LLVMSub : LLVMFSub;
-         break;
-      case AST_MUL:
-         opcode = (res->type_specifier == TYPE_INT) ? LLVMMul: LLVMFMul;
-         break;
-      case AST_DIV:
-         opcode = (res->type_specifier == TYPE_INT) ? LLVMSDiv: LLVMFDiv;
-         break;
-      default:
-         fprintf(stderr, "Unknown math operation: %d\n", operation);
-         exit(EXIT_FAILURE);
+   LLVMTypeRef size_type = LLVMInt64TypeInContext(vm->context);
+   LLVMValueRef array, size, zero;
+
+   if (LLVMIsAConstantInt(length)) {
+      position_alloca_builder(vm);
+      array = LLVMBuildArrayAlloca(vm->alloca_builder, vmval->llvm_type,
+                                   length, vmval->identifier);
+      vm->last_alloca = array;
+   } else {
+      array = LLVMBuildArrayAlloca(vm->builder, vmval->llvm_type,
+                                   length, vmval->identifier);
    }
+   LLVMSetAlignment(array, VM_ARRAY_ALIGNMENT);
 
-   res->llvm_value = LLVMBuildBinOp(vm->builder, opcode, lhs->llvm_value,
-                                                         rhs->llvm_value, "");
+   /* the elements start out zero every time the declaration runs */
+   size = LLVMBuildMul(vm->builder,
+                       LLVMBuildZExt(vm->builder, length, size_type, ""),
+                       LLVMSizeOf(vmval->llvm_type), "");
+   zero = LLVMConstNull(LLVMInt8TypeInContext(vm->context));
+   LLVMBuildMemSet(vm->builder, array, zero, size, VM_ARRAY_ALIGNMENT);
+
+   vmval->llvm_value = array;
+   vmval->length = length;
+
+   return array;
+}
+
+/*
+ * The type checker has brought both operands of an operation to the
+ * same type, so the instruction is looked up rather than decided.
+ */
+static const LLVMOpcode math_opcodes[AST_DIV + 1][TYPE_FLOAT + 1] = {
+   [AST_ADD] = { [TYPE_INT] = LLVMAdd,  [TYPE_FLOAT] = LLVMFAdd },
+   [AST_SUB] = { [TYPE_INT] = LLVMSub,  [TYPE_FLOAT] = LLVMFSub },
+   [AST_MUL] = { [TYPE_INT] = LLVMMul,  [TYPE_FLOAT] = LLVMFMul },
+   [AST_DIV] = { [TYPE_INT] = LLVMSDiv, [TYPE_FLOAT] = LLVMFDiv },
+};
+
+static const LLVMIntPredicate int_predicates[AST_GE + 1] = {
+   [AST_GT] = LLVMIntSGT, [AST_LT] = LLVMIntSLT,
+   [AST_EQ] = LLVMIntEQ,  [AST_NE] = LLVMIntNE,
+   [AST_LE] = LLVMIntSLE, [AST_GE] = LLVMIntSGE,
+};
+
+/* ordered: a comparison with a NaN is false, != included */
+static const LLVMRealPredicate float_predicates[AST_GE + 1] = {
+   [AST_GT] = LLVMRealOGT, [AST_LT] = LLVMRealOLT,
+   [AST_EQ] = LLVMRealOEQ, [AST_NE] = LLVMRealONE,
+   [AST_LE] = LLVMRealOLE, [AST_GE] = LLVMRealOGE,
+};
+
+/* indexed by the type converted from, then the type converted to */
+static const LLVMOpcode conversion_opcodes[TYPE_BOOL + 1][TYPE_FLOAT + 1] = {
+   [TYPE_INT]   = { [TYPE_FLOAT] = LLVMSIToFP },
+   [TYPE_FLOAT] = { [TYPE_INT] = LLVMFPToSI },
+   [TYPE_BOOL]  = { [TYPE_INT] = LLVMZExt, [TYPE_FLOAT] = LLVMUIToFP },
+};
+
+struct vm_value
+vm_value_build_math_op(struct vm_state *vm, int operation,
+                                            const struct vm_value *lhs,
+                                            const struct vm_value *rhs)
+{
+   struct vm_value res = { 0 };
+
+   assert(operation >= AST_ADD && operation <= AST_DIV);
+
+   res.type_specifier = lhs->type_specifier;
+   res.llvm_type = lhs->llvm_type;
+   res.symbol = -1;
+   res.llvm_value = LLVMBuildBinOp(vm->builder,
+                                   math_opcodes[operation]
+                                               [lhs->type_specifier],
+                                   lhs->llvm_value, rhs->llvm_value, "");
    return res;
 }
 
-struct vm_value *
+struct vm_value
 vm_value_build_cmp_op(struct vm_state *vm, int operation,
-                                           struct vm_value *lhs,
-                                           struct vm_value *rhs)
+                                           const struct vm_value *lhs,
+                                           const struct vm_value *rhs)
 {
-   struct vm_value *res;
-   LLVMOpcode opcode;
-   LLVMIntPredicate int_predicate;
-   LLVMRealPredicate float_predicate;
-
-   res = vm_value_new(lhs->type_specifier, "");
-
-   opcode = (res->type_specifier == TYPE_INT) ? LLVMICmp : LLVMFCmp;
-
-   switch (operation) {
-      case AST_GT:
-         if (res->type_specifier == TYPE_INT)
-            int_predicate = LLVMIntSGT;
-         else
-            float_predicate = LLVMRealOGT;
-         break;
-      case AST_LT:
-         if (res->type_specifier == TYPE_INT)
-            int_predicate = LLVMIntSLT;
-         else
-            float_predicate = LLVMRealOLT;
-         break;
-      case AST_EQ:
-         if (res->type_specifier == TYPE_INT)
-            int_predicate = LLVMIntEQ;
-         else
-            float_predicate = LLVMRealOEQ;
-         break;
-      case AST_NE:
-         if (res->type_specifier == TYPE_INT)
-            int_predicate = LLVMIntNE;
-         else
-            float_predicate = LLVMRealONE;
-         break;
-      case AST_LE:
-         if (res->type_specifier == TYPE_INT)
-            int_predicate = LLVMIntSLE;
-         else
-            float_predicate = LLVMRealOLE;
-         break;
-      case AST_GE:
-         if (res->type_specifier == TYPE_INT)
-            int_predicate = LLVMIntSGE;
-         else
-            float_predicate = LLVMRealOGE;
-         break;
-      default:
-         fprintf(stderr, "Unknown comparison operation: %d\n", operation);
-         exit(EXIT_FAILURE);
-   }
+   struct vm_value res = { 0 };
 
-   if (opcode == LLVMICmp) {
-      res->llvm_value = LLVMBuildICmp(vm->builder, int_predicate,
-                                                   lhs->llvm_value,
-                                                   rhs->llvm_value, "");
-   } else {
-      res->llvm_value = LLVMBuildFCmp(vm->builder, float_predicate,
-                                                   lhs->llvm_value,
-                                                   rhs->llvm_value, "");
-   }
+   assert(operation >= AST_GT && operation <= AST_GE);
+
+   res.type_specifier = TYPE_BOOL;
+   res.llvm_type = vm->bool_type;
+   res.symbol = -1;
 
+   if (lhs->type_specifier == TYPE_INT)
+      res.llvm_value = LLVMBuildICmp(vm->builder, int_predicates[operation],
+                                     lhs->llvm_value, rhs->llvm_value, "");
+   else
+      res.llvm_value = LLVMBuildFCmp(vm->builder,
+                                     float_predicates[operation],
+                                     lhs->llvm_value, rhs->llvm_value, "");
+
+   return res;
+}
+
+struct vm_value
+vm_value_build_conversion(struct vm_state *vm, int type_specifier,
+                          const struct vm_value *value)
+{
+   struct vm_value res = { 0 };
+
+   res.type_specifier = type_specifier;
+   res.llvm_type = vm_value_llvm_type(vm, type_specifier);
+   res.symbol = -1;
+   res.llvm_value = LLVMBuildCast(vm->builder,
+                                  conversion_opcodes[value->type_specifier]
+                                                    [type_specifier],
+                                  value->llvm_value, res.llvm_type, "");
    return res;
 }
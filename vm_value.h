@@ -6,27 +6,80 @@
 
 #include "vm_state.h"
 
+/* arrays are allocated to this, for the vectorizer's aligned accesses */
+#define VM_ARRAY_ALIGNMENT    32
+
+/*
+ * Small value type: temporaries are passed around and returned by value.
+ * Only declared variables get a stable address, allocated from the
+ * vm_state's per-compile arena, since the symbol table refers to them.
+ */
 struct vm_value {
    LLVMTypeRef llvm_type;
    LLVMValueRef llvm_value;
 
    int type_specifier;
    const char *identifier;
+   int symbol;    /* interned identifier of a variable, -1 otherwise */
+   int ssa_variable;    /* variable index in SSA mode, see ssa.h */
+
+   /*
+    * Element count of an array, an i32; NULL for anything else. An
+    * array always lives in memory, whatever the mode: its llvm_value is
+    * a pointer to the first element and llvm_type the element type.
+    */
+   LLVMValueRef length;
+
+   /*
+    * A function is a value too, its llvm_value the LLVM function and
+    * llvm_type the type returned; NULL for anything else.
+    */
+   LLVMTypeRef function_type;
+
+   /* function a variable belongs to, NULL for main's; see vm_state */
+   struct vm_value *owner;
 };
 
-struct vm_value *vm_value_new(int type_specifier, const char *identifier);
-struct vm_value *vm_value_new_from_int_constant(int int_constant);
-struct vm_value *vm_value_new_from_float_constant(float float_constant);
-struct vm_value *vm_value_dup(struct vm_value *vmval);
+/* i32 or float, for TYPE_INT or TYPE_FLOAT */
+LLVMTypeRef vm_value_llvm_type(struct vm_state *vm, int type_specifier);
+
+struct vm_value *vm_value_new_variable(struct vm_state *vm,
+                                       int type_specifier, int symbol);
+
+struct vm_value vm_value_from_int_constant(struct vm_state *vm,
+                                           int int_constant);
+struct vm_value vm_value_from_float_constant(struct vm_state *vm,
+                                             float float_constant);
 
 LLVMValueRef vm_value_alloca(struct vm_state *vm, struct vm_value *vmval);
 
-struct vm_value *vm_value_build_math_op(struct vm_state *vm,
-                                        int operation, struct vm_value *lhs,
-                                                       struct vm_value *rhs);
+/*
+ * Allocates the 'length' elements of an array, zeroed at the builder's
+ * position. A constant length gets its space in the entry block like
+ * any variable; any other is allocated on the spot, for the enclosing
+ * block to give back.
+ */
+LLVMValueRef vm_value_alloca_array(struct vm_state *vm,
+                                   struct vm_value *vmval,
+                                   LLVMValueRef length);
+
+/*
+ * Both operands have the same type, see typecheck.h; a comparison yields
+ * a TYPE_BOOL, an i1.
+ */
+struct vm_value vm_value_build_math_op(struct vm_state *vm,
+                                       int operation,
+                                       const struct vm_value *lhs,
+                                       const struct vm_value *rhs);
+
+struct vm_value vm_value_build_cmp_op(struct vm_state *vm,
+                                      int operation,
+                                      const struct vm_value *lhs,
+                                      const struct vm_value *rhs);
 
-struct vm_value *vm_value_build_cmp_op(struct vm_state *vm,
-                                       int operation, struct vm_value *lhs,
-                                                      struct vm_value *rhs);
+/* 'value' as a TYPE_INT or TYPE_FLOAT, for an AST_CONVERT */
+struct vm_value vm_value_build_conversion(struct vm_state *vm,
+                                          int type_specifier,
+                                          const struct vm_value *value);
 
 #endif /* VM_VALUE_H */